@@ -0,0 +1,118 @@
+// 可用表达式分析
+#ifndef LLVM_EXERCISE_AVAILEXPR_H
+#define LLVM_EXERCISE_AVAILEXPR_H
+
+#include "cscd70/framework.h"
+
+class Expression {
+private:
+  unsigned _opcode;
+  const llvm::Value *_lhs, *_rhs;
+
+public:
+  Expression(const llvm::Instruction &inst) {
+    _opcode = inst.getOpcode();
+    _lhs = inst.getOperand(0);
+    _rhs = inst.getOperand(1);
+  }
+
+  bool operator==(const Expression &Expr) const {
+    switch (_opcode) {
+    // 满足交换律
+    case llvm::Instruction::Add:
+    case llvm::Instruction::FAdd: // 浮点数加法
+    case llvm::Instruction::Mul:
+    case llvm::Instruction::FMul:
+      return ((Expr.getLHSOperand() == _lhs && Expr.getRHSOperand() == _rhs) ||
+              (Expr.getLHSOperand() == _rhs && Expr.getRHSOperand() == _lhs)) &&
+             Expr.getOpcode() == _opcode;
+    default:
+      return Expr.getLHSOperand() == _lhs && Expr.getRHSOperand() == _rhs &&
+             Expr.getOpcode() == _opcode;
+    }
+  }
+
+  unsigned getOpcode() const { return _opcode; }
+  const llvm::Value *getLHSOperand() const { return _lhs; }
+  const llvm::Value *getRHSOperand() const { return _rhs; }
+
+  friend llvm::raw_ostream &operator<<(llvm::raw_ostream &outs,
+                                       const Expression &expr);
+};
+
+namespace std {
+// 构造"Expression"的哈希Code
+template <> struct hash<Expression> {
+  std::size_t operator()(const Expression &expr) const {
+    std::hash<unsigned> unsigned_hasher;
+    std::hash<const llvm::Value *> pvalue_hasher;
+
+    std::size_t opcode_hash = unsigned_hasher(expr.getOpcode());
+    std::size_t lhs_operand_hash = pvalue_hasher(expr.getLHSOperand());
+    std::size_t rhs_operand_hash = pvalue_hasher(expr.getRHSOperand());
+
+    return opcode_hash ^ (lhs_operand_hash << 1) ^ (rhs_operand_hash << 1);
+  }
+};
+} // namespace std
+
+// 可用表达式分析（前向）：所有前驱的 OUT 集合的交集就是当前基本块的 IN 集，
+// 初始条件 OUT[B] 为全集，边界条件 OUT[ENTRY] 为空集
+class AvailExpr final
+    : public dfa::StaticFramework<AvailExpr, Expression,
+                                  dfa::Direction::Forward, dfa::IntersectMeet,
+                                  dfa::FullSetCond, dfa::EmptySetCond> {
+  friend static_framework_t;
+
+public:
+  virtual llvm::StringRef getCacheName() const override { return "avail_expr"; }
+
+protected:
+  virtual void GenKill(const solver_t &solver, const llvm::Instruction &inst,
+                       llvm::SmallVectorImpl<unsigned> &gen,
+                       llvm::SmallVectorImpl<unsigned> &kill) const override;
+  virtual void
+  InitializeDomainFromInstruction(solver_t &solver,
+                                  const llvm::Instruction &inst) const override;
+};
+
+// New PM interface
+// 结果由 FunctionAnalysisManager 缓存，其他 pass 通过
+// FAM.getResult<AvailExprAnalysis>(F) 查询，不需要重新求解
+struct AvailExprAnalysis : public llvm::AnalysisInfoMixin<AvailExprAnalysis> {
+  using Result = dfa::AnalysisResult<AvailExpr>;
+
+  Result run(llvm::Function &F, llvm::FunctionAnalysisManager &);
+
+  static bool isRequired() { return true; }
+
+private:
+  static llvm::AnalysisKey Key;
+  friend struct llvm::AnalysisInfoMixin<AvailExprAnalysis>;
+};
+
+// New PM interface for the printer pass: print<avail-expr>
+class AvailExprPrinter : public llvm::PassInfoMixin<AvailExprPrinter> {
+public:
+  explicit AvailExprPrinter(llvm::raw_ostream &OutS) : OS(OutS) {}
+  llvm::PreservedAnalyses run(llvm::Function &F,
+                              llvm::FunctionAnalysisManager &FAM);
+  static bool isRequired() { return true; }
+
+private:
+  llvm::raw_ostream &OS;
+};
+
+// New PM interface: -passes=dfa-gcse
+// 全局公共子表达式消除：在其之前可用的二元运算是冗余的，用等价的计算替换。
+// 同一基本块中有更早的计算时直接使用基本块中的第一个；否则由 SSAUpdater
+// 从各基本块中最后一个计算构造到达该处的值：只有一个支配它的计算时即为该
+// 计算，多条路径分别计算时在汇合处插入 phi。同一表达式的计算此后共用
+// 所有计算的 nsw/nuw/exact 与快速数学标志的交集。
+// 消除的指令数计入 STATISTIC。实现在 lib/GCSE.cpp，只编入 DataFlow 插件
+struct GCSEPass : public llvm::PassInfoMixin<GCSEPass> {
+  llvm::PreservedAnalyses run(llvm::Function &F,
+                              llvm::FunctionAnalysisManager &FAM);
+};
+
+#endif
@@ -0,0 +1,88 @@
+// 稀疏条件常量传播（SCCP）
+#ifndef LLVM_EXERCISE_CONSTPROP_H
+#define LLVM_EXERCISE_CONSTPROP_H
+
+#include <llvm/Analysis/TargetLibraryInfo.h>
+#include <llvm/IR/Constants.h>
+#include <llvm/IR/DataLayout.h>
+
+#include "cscd70/lattice.h"
+
+namespace dfa {
+template <typename TSummary> class ModuleSummaries;
+} // namespace dfa
+struct FunctionSummary;
+
+// 常量格：Bottom（尚未求得）< 常量 < Overdefined（不是常量），高度为 2
+struct ConstantLattice {
+  enum Kind { Bottom, Const, Overdefined };
+
+  struct value_t {
+    Kind kind = Bottom;
+    llvm::Constant *constant = nullptr;
+  };
+
+  static value_t bottom() { return value_t(); }
+  static value_t overdefined() { return {Overdefined, nullptr}; }
+  static value_t constant(llvm::Constant *c) { return {Const, c}; }
+
+  static bool join(value_t &dst, const value_t &src) {
+    if (src.kind == Bottom || dst.kind == Overdefined ||
+        (dst.kind == Const && src.kind == Const &&
+         dst.constant == src.constant)) {
+      return false;
+    }
+    dst = dst.kind == Bottom ? src : overdefined();
+    return true;
+  }
+};
+
+// 常量传播分析：形参为 Overdefined，常量为自身；操作数都是常量的指令由
+// ConstantFolding 求值；条件分支与 switch 的条件为常量时只有一个可行的后继。
+// 给出函数摘要（见 FunctionSummary.h）时，直接调用的值取被调用者返回的常量，
+// 或者被调用者原样返回的实参的值
+class ConstantPropagation final
+    : public dfa::LatticeFramework<ConstantLattice> {
+public:
+  explicit ConstantPropagation(
+      const llvm::DataLayout &DL, const llvm::TargetLibraryInfo *TLI = nullptr,
+      const dfa::ModuleSummaries<FunctionSummary> *summaries = nullptr)
+      : _dl(DL), _tli(TLI), _summaries(summaries) {}
+
+protected:
+  virtual value_t ExternalValue(const solver_t &solver,
+                                const llvm::Value &val) const override;
+  virtual value_t Transfer(const solver_t &solver,
+                           const llvm::Instruction &inst) const override;
+  virtual void FeasibleSuccessors(
+      const solver_t &solver, const llvm::Instruction &term,
+      llvm::SmallVectorImpl<const llvm::BasicBlock *> &succs) const override;
+
+private:
+  const llvm::DataLayout &_dl;
+  const llvm::TargetLibraryInfo *_tli;
+  const dfa::ModuleSummaries<FunctionSummary> *_summaries;
+};
+
+// New PM interface: -passes=dfa-sccp
+// 用常量替换求得常量的指令，把条件为常量的分支改为无条件跳转，
+// 删除不可执行的基本块
+struct ConstPropPass : public llvm::PassInfoMixin<ConstPropPass> {
+  llvm::PreservedAnalyses run(llvm::Function &F,
+                              llvm::FunctionAnalysisManager &FAM);
+
+  // 以给定的分析变换 F，两个 pass 共用
+  static llvm::PreservedAnalyses
+  transform(llvm::Function &F, const ConstantPropagation &analysis,
+            const llvm::TargetLibraryInfo &TLI);
+};
+
+// New PM interface: -passes=dfa-ipsccp
+// 过程间模式：先在调用图上自底向上计算函数摘要（FunctionSummaryAnalysis），
+// 再对每个函数做 ConstPropPass 的变换，调用点使用被调用者的摘要
+struct ModuleConstPropPass : public llvm::PassInfoMixin<ModuleConstPropPass> {
+  llvm::PreservedAnalyses run(llvm::Module &M,
+                              llvm::ModuleAnalysisManager &MAM);
+};
+
+#endif
@@ -0,0 +1,98 @@
+// 过程间的函数摘要
+#ifndef LLVM_EXERCISE_FUNCTIONSUMMARY_H
+#define LLVM_EXERCISE_FUNCTIONSUMMARY_H
+
+#include <llvm/ADT/BitVector.h>
+#include <llvm/ADT/DenseSet.h>
+#include <llvm/IR/GlobalVariable.h>
+#include <llvm/IR/InstrTypes.h>
+
+#include "ConstProp.h"
+#include "cscd70/interproc.h"
+
+// 一个函数对调用者可见的行为，按调用图自底向上计算（见 dfa::ModuleSummaries），
+// 调用点通过被调用者的摘要得到比“不透明的调用”更精确的结果
+struct FunctionSummary {
+  // 函数体实际使用的形参。只被原样传给被调用者不使用的形参的不算
+  llvm::BitVector used_args;
+  // 可能被原样返回的形参（包括经由 phi、select 与被调用者返回）
+  llvm::BitVector returned_args;
+  // 其余返回值的 join：Bottom 表示只返回形参或从不返回，
+  // Const 表示总是返回这个常量
+  ConstantLattice::value_t returned;
+  // 直接或经由被调用者读写的全局变量
+  llvm::DenseSet<const llvm::GlobalVariable *> read_globals;
+  llvm::DenseSet<const llvm::GlobalVariable *> written_globals;
+  // 通过无法确定对象的指针（例如形参）或未知的调用读写内存，
+  // 这时任何地址被取过的全局变量都可能被读写
+  bool reads_unknown = false;
+  bool writes_unknown = false;
+
+  bool operator==(const FunctionSummary &other) const {
+    return used_args == other.used_args &&
+           returned_args == other.returned_args &&
+           returned.kind == other.returned.kind &&
+           returned.constant == other.returned.constant &&
+           read_globals == other.read_globals &&
+           written_globals == other.written_globals &&
+           reads_unknown == other.reads_unknown &&
+           writes_unknown == other.writes_unknown;
+  }
+
+  // SCC 内迭代的初值 FunctionSummary() 中 used_args 为空，即都不使用
+  bool isArgUsed(unsigned arg) const {
+    return arg < used_args.size() && used_args.test(arg);
+  }
+  // 总是返回同一个常量时返回它，否则返回 nullptr
+  llvm::Constant *getReturnedConstant() const {
+    return returned_args.none() && returned.kind == ConstantLattice::Const
+               ? returned.constant
+               : nullptr;
+  }
+  bool mayRead(const llvm::GlobalVariable *global) const {
+    return reads_unknown || read_globals.count(global);
+  }
+  bool mayWrite(const llvm::GlobalVariable *global) const {
+    return writes_unknown || written_globals.count(global);
+  }
+
+  void print(llvm::raw_ostream &OS, const llvm::Function &F) const;
+};
+
+typedef dfa::ModuleSummaries<FunctionSummary> FunctionSummaries;
+
+// 计算 F 的摘要，被调用者的摘要从 summaries 中读取
+FunctionSummary summarizeFunction(const llvm::Function &F,
+                                  const FunctionSummaries &summaries);
+
+// 直接调用的被调用者的摘要；间接调用、被调用者没有摘要或调用的函数类型与
+// 被调用者不符时返回 nullptr
+const FunctionSummary *lookupCallee(const llvm::CallBase &call,
+                                    const FunctionSummaries &summaries);
+
+// New PM interface: 模块上的分析，结果为所有函数的摘要
+struct FunctionSummaryAnalysis
+    : public llvm::AnalysisInfoMixin<FunctionSummaryAnalysis> {
+  using Result = FunctionSummaries;
+
+  Result run(llvm::Module &M, llvm::ModuleAnalysisManager &);
+
+private:
+  static llvm::AnalysisKey Key;
+  friend struct llvm::AnalysisInfoMixin<FunctionSummaryAnalysis>;
+};
+
+// New PM interface for the printer pass: print<dfa-summaries>
+class FunctionSummaryPrinter
+    : public llvm::PassInfoMixin<FunctionSummaryPrinter> {
+public:
+  explicit FunctionSummaryPrinter(llvm::raw_ostream &OutS) : OS(OutS) {}
+  llvm::PreservedAnalyses run(llvm::Module &M,
+                              llvm::ModuleAnalysisManager &MAM);
+  static bool isRequired() { return true; }
+
+private:
+  llvm::raw_ostream &OS;
+};
+
+#endif
@@ -0,0 +1,90 @@
+//Liveness
+#ifndef LLVM_EXERCISE_LIVENESS_H
+#define LLVM_EXERCISE_LIVENESS_H
+
+#include "cscd70/framework.h"
+
+//定义一个表示变量的类 Variable
+class Variable {
+private:
+  const llvm::Value *_val; // LLVM值的指针，表示变量
+
+public:
+  Variable(const llvm::Value *val) : _val(val) {} // 构造函数
+
+  // 比较操作符，用于判断两个变量是否相同
+  bool operator==(const Variable &val) const { return _val == val.getValue(); }
+
+  // 获取变量值的函数
+  const llvm::Value *getValue() const { return _val; }
+
+  // 友元函数，用于输出变量
+  friend llvm::raw_ostream &operator<<(llvm::raw_ostream &outs,
+                                       const Variable &val);
+};
+
+//为 Variable 类定义哈希函数
+namespace std {
+template <> struct hash<Variable> {
+  std::size_t operator()(const Variable &var) const {
+    std::hash<const llvm::Value *> value_ptr_hasher; // 值指针的哈希器
+
+    std::size_t value_hash = value_ptr_hasher((var.getValue()));
+    return value_hash; // 返回变量值的哈希
+  }
+};
+} // namespace std
+
+// 活跃变量分析（后向）：所有后继的 IN 集合的并集就是当前基本块的 OUT 集，
+// 初始条件 IN[B] 与边界条件 OUT[EXIT] 都是空集
+class Liveness final
+    : public dfa::StaticFramework<Liveness, Variable, dfa::Direction::Backward,
+                                  dfa::UnionMeet, dfa::EmptySetCond,
+                                  dfa::EmptySetCond> {
+  friend static_framework_t;
+
+public:
+  virtual llvm::StringRef getCacheName() const override { return "liveness"; }
+
+protected:
+  virtual void EdgeGenKill(const solver_t &solver,
+                           const llvm::BasicBlock &block,
+                           const llvm::BasicBlock &bb,
+                           llvm::SmallVectorImpl<unsigned> &gen,
+                           llvm::SmallVectorImpl<unsigned> &kill) const override;
+  virtual void GenKill(const solver_t &solver, const llvm::Instruction &inst,
+                       llvm::SmallVectorImpl<unsigned> &gen,
+                       llvm::SmallVectorImpl<unsigned> &kill) const override;
+  virtual void
+  InitializeDomainFromInstruction(solver_t &solver,
+                                  const llvm::Instruction &inst) const override;
+};
+
+// New PM interface
+// 结果由 FunctionAnalysisManager 缓存，其他 pass 通过
+// FAM.getResult<LivenessAnalysis>(F) 查询，不需要重新求解
+struct LivenessAnalysis : public llvm::AnalysisInfoMixin<LivenessAnalysis> {
+  using Result = dfa::AnalysisResult<Liveness>;
+
+  Result run(llvm::Function &F, llvm::FunctionAnalysisManager &);
+
+  static bool isRequired() { return true; }
+
+private:
+  static llvm::AnalysisKey Key;
+  friend struct llvm::AnalysisInfoMixin<LivenessAnalysis>;
+};
+
+// New PM interface for the printer pass: print<liveness>
+class LivenessPrinter : public llvm::PassInfoMixin<LivenessPrinter> {
+public:
+  explicit LivenessPrinter(llvm::raw_ostream &OutS) : OS(OutS) {}
+  llvm::PreservedAnalyses run(llvm::Function &F,
+                              llvm::FunctionAnalysisManager &FAM);
+  static bool isRequired() { return true; }
+
+private:
+  llvm::raw_ostream &OS;
+};
+
+#endif
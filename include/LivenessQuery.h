@@ -0,0 +1,111 @@
+// 基于循环嵌套森林的活跃性查询
+#ifndef LLVM_EXERCISE_LIVENESSQUERY_H
+#define LLVM_EXERCISE_LIVENESSQUERY_H
+
+#include <vector>
+
+#include <llvm/ADT/BitVector.h>
+#include <llvm/ADT/DenseMap.h>
+#include <llvm/Analysis/LoopInfo.h>
+#include <llvm/IR/Dominators.h>
+#include <llvm/IR/Function.h>
+#include <llvm/IR/PassManager.h>
+
+// 回答单个变量在单个基本块入口/出口处是否活跃，不计算任何变量的活跃集合
+// （Boissinot 等人的 SSA 活跃性检查）。构造时只预计算与控制流图有关的数据：
+//  - 深度优先编号，由此得到回边（指向 DFS 树上祖先的边）；
+//  - 简化图（去掉回边之后的无环图）上每个基本块可以到达的基本块集合 R；
+//  - 支配树与循环嵌套森林，即每个基本块所在的各层循环的头（回边的目标）。
+// 查询时沿变量的 def-use 链收集使用所在的基本块：q 处活跃当且仅当定值严格
+// 支配 q，并且从包含 q、头被定值严格支配的最外层循环的头（没有这样的循环时
+// 为 q 自身）在简化图上可以到达某个使用。
+//
+// 因为不保存任何与变量有关的数据，只要控制流图不变，增删指令、替换使用之后
+// 查询结果仍然正确；结果只在 PreservedAnalyses 没有保留 CFGAnalyses 时失效。
+//
+// 结果与 Liveness（lib/Liveness.cpp）完全相同，phi 的处理见 SparseLiveness.h。
+// 以下情况改为从 q 出发沿后继逐块搜索，仍然只用 def-use 链：
+//  - q 不可达（支配关系与 R 只覆盖可达的基本块）；
+//  - 控制流图不可归约（循环有多个入口时上述判定不成立）；
+//  - 变量是某个被其定值严格支配的基本块中 phi 的取值，而该基本块还有其他
+//    前驱：Liveness 在这些入边上删掉该变量，经过该基本块的路径被截断，
+//    快速判定为真时需要确认。
+class LivenessQuery {
+public:
+  explicit LivenessQuery(const llvm::Function &F);
+
+  // val 在 bb 入口/出口处是否活跃。val 不是 F 中的指令或形参时返回 false
+  bool isLiveIn(const llvm::Value *val, const llvm::BasicBlock &bb) const;
+  bool isLiveOut(const llvm::Value *val, const llvm::BasicBlock &bb) const;
+
+  unsigned getNumBlocks() const { return _blocks.size(); }
+  const llvm::BasicBlock &getBlock(unsigned block) const {
+    return *_blocks[block];
+  }
+  unsigned getBlockIndex(const llvm::BasicBlock &bb) const;
+  // 可达部分的控制流图是否可归约；不可归约时所有查询都逐块搜索
+  bool isReducible() const { return _reducible; }
+
+  // 对函数中每个用作操作数的指令与形参查询每个基本块，输出格式与
+  // SparseLiveness::print 相同
+  void print(llvm::raw_ostream &OS) const;
+
+  // New PM：控制流图不变时保持有效
+  bool invalidate(llvm::Function &F, const llvm::PreservedAnalyses &PA,
+                  llvm::FunctionAnalysisManager::Invalidator &);
+
+private:
+  struct UseInfo;
+
+  // 沿 def-use 链收集一次查询需要的信息；val 不属于本函数时返回 false
+  bool collectUses(const llvm::Value *val, UseInfo &uses) const;
+  bool isLiveInAt(const UseInfo &uses, unsigned block) const;
+  bool isLiveOutAt(const UseInfo &uses, unsigned block) const;
+  bool searchLiveIn(const UseInfo &uses, unsigned block) const;
+  bool isKilledOnEdge(const UseInfo &uses, unsigned pred,
+                      unsigned block) const;
+
+  const llvm::Function *_func;
+  std::vector<const llvm::BasicBlock *> _blocks;
+  llvm::DenseMap<const llvm::BasicBlock *, unsigned> _block_index;
+  // 后继（CSR 格式）
+  std::vector<unsigned> _succ_begin, _succs;
+  // 深度优先的先序编号，不可达的基本块为 kUnreached
+  std::vector<unsigned> _preorder;
+  // 简化图上的可达集合，按基本块号索引；不可达的基本块为空
+  std::vector<llvm::BitVector> _reach;
+  llvm::DominatorTree _dt;
+  llvm::LoopInfo _loops;
+  bool _reducible = true;
+};
+
+// New PM interface
+// 结果由 FunctionAnalysisManager 缓存，其他 pass 通过
+// FAM.getResult<LivenessQueryAnalysis>(F) 查询
+struct LivenessQueryAnalysis
+    : public llvm::AnalysisInfoMixin<LivenessQueryAnalysis> {
+  using Result = LivenessQuery;
+
+  Result run(llvm::Function &F, llvm::FunctionAnalysisManager &);
+
+  static bool isRequired() { return true; }
+
+private:
+  static llvm::AnalysisKey Key;
+  friend struct llvm::AnalysisInfoMixin<LivenessQueryAnalysis>;
+};
+
+// New PM interface for the printer pass: print<liveness-query>
+class LivenessQueryPrinter
+    : public llvm::PassInfoMixin<LivenessQueryPrinter> {
+public:
+  explicit LivenessQueryPrinter(llvm::raw_ostream &OutS) : OS(OutS) {}
+  llvm::PreservedAnalyses run(llvm::Function &F,
+                              llvm::FunctionAnalysisManager &FAM);
+  static bool isRequired() { return true; }
+
+private:
+  llvm::raw_ostream &OS;
+};
+
+#endif
@@ -0,0 +1,115 @@
+// 基于活跃变量分析的寄存器压力估计
+#ifndef LLVM_EXERCISE_REGPRESSURE_H
+#define LLVM_EXERCISE_REGPRESSURE_H
+
+#include <string>
+#include <vector>
+
+#include <llvm/ADT/ArrayRef.h>
+#include <llvm/ADT/DenseMap.h>
+#include <llvm/Analysis/LoopInfo.h>
+#include <llvm/Analysis/TargetTransformInfo.h>
+#include <llvm/IR/PassManager.h>
+
+#include "Liveness.h"
+
+// 用 Liveness 的结果估计每个基本块、每个循环中同时活跃的值最多需要多少个
+// 寄存器。在基本块内从 OUT[B] 逆序重放传递函数，每条指令处的压力取
+//  - 指令之后活跃的值加上指令定值（定值没有使用时也占一个寄存器），
+//  - 指令之前活跃的值
+// 中较大者。phi 的操作数在 Liveness 中属于前驱的 OUT，不在 phi 处计入。
+//
+// 每个值按 TargetTransformInfo 归入寄存器类（getRegisterClassForType），
+// 占用 getRegUsageForType 个寄存器，与该类的 getNumberOfRegisters 比较；
+// 同时按 IR 类型分为整数（含指针）、浮点、向量三种，便于看出压力的来源。
+// 寄存器类的划分以目标为准：例如没有目标信息时，标量浮点与整数同属一类。
+// 入口块中的静态 alloca 是栈帧地址，可以重新计算，不计入压力。
+class RegisterPressure {
+public:
+  enum ValueKind { Int, FP, Vector, NumValueKinds };
+
+  struct RegClass {
+    unsigned id;
+    std::string name;
+    unsigned num_regs;
+  };
+
+  // 一组压力最大值：按值的种类与按寄存器类（与 getRegClasses 对应）
+  struct Pressure {
+    unsigned kinds[NumValueKinds] = {};
+    std::vector<unsigned> classes;
+  };
+
+  struct LoopPressure {
+    const llvm::BasicBlock *header;
+    unsigned depth;
+    unsigned num_blocks;
+    Pressure max;
+    // 各寄存器类超出寄存器数的最大值，0 表示没有超出
+    unsigned excess;
+  };
+
+  RegisterPressure(const llvm::Function &F,
+                   const LivenessAnalysis::Result &liveness,
+                   const llvm::TargetTransformInfo &TTI,
+                   const llvm::LoopInfo &LI);
+
+  llvm::ArrayRef<RegClass> getRegClasses() const { return _classes; }
+  const Pressure &getBlockPressure(const llvm::BasicBlock &bb) const;
+  // 按超出量、再按压力总和从大到小排序
+  llvm::ArrayRef<LoopPressure> getLoops() const { return _loops; }
+
+  static const char *getKindName(ValueKind kind);
+
+  void print(llvm::raw_ostream &OS) const;
+
+private:
+  void printPressure(llvm::raw_ostream &OS, const Pressure &pressure) const;
+
+  const llvm::Function *_func;
+  std::vector<RegClass> _classes;
+  std::vector<Pressure> _blocks;
+  llvm::DenseMap<const llvm::BasicBlock *, unsigned> _block_index;
+  std::vector<LoopPressure> _loops;
+};
+
+// New PM interface
+// 依赖 LivenessAnalysis、TargetIRAnalysis 与 LoopAnalysis 的结果
+struct RegisterPressureAnalysis
+    : public llvm::AnalysisInfoMixin<RegisterPressureAnalysis> {
+  using Result = RegisterPressure;
+
+  Result run(llvm::Function &F, llvm::FunctionAnalysisManager &FAM);
+
+  static bool isRequired() { return true; }
+
+private:
+  static llvm::AnalysisKey Key;
+  friend struct llvm::AnalysisInfoMixin<RegisterPressureAnalysis>;
+};
+
+// New PM interface for the printer pass: print<reg-pressure>
+// 输出每个基本块的压力与按超出量排序的循环列表
+class RegisterPressurePrinter
+    : public llvm::PassInfoMixin<RegisterPressurePrinter> {
+public:
+  explicit RegisterPressurePrinter(llvm::raw_ostream &OutS) : OS(OutS) {}
+  llvm::PreservedAnalyses run(llvm::Function &F,
+                              llvm::FunctionAnalysisManager &FAM);
+  static bool isRequired() { return true; }
+
+private:
+  llvm::raw_ostream &OS;
+};
+
+// New PM interface: -passes=dfa-reg-pressure
+// 对压力超过寄存器数的循环输出分析备注
+// （-pass-remarks-analysis=dfa-reg-pressure），不修改 IR
+struct RegisterPressureRemarks
+    : public llvm::PassInfoMixin<RegisterPressureRemarks> {
+  llvm::PreservedAnalyses run(llvm::Function &F,
+                              llvm::FunctionAnalysisManager &FAM);
+  static bool isRequired() { return true; }
+};
+
+#endif
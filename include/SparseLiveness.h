@@ -0,0 +1,123 @@
+// 基于 SSA 的稀疏活跃变量分析
+#ifndef LLVM_EXERCISE_SPARSELIVENESS_H
+#define LLVM_EXERCISE_SPARSELIVENESS_H
+
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+#include <llvm/ADT/ArrayRef.h>
+#include <llvm/ADT/BitVector.h>
+#include <llvm/ADT/DenseMap.h>
+#include <llvm/IR/Function.h>
+#include <llvm/IR/PassManager.h>
+
+// 逐个变量计算活跃性：从变量的每个向上暴露的使用所在的基本块出发，沿前驱
+// 回溯到定值所在的基本块为止。每个变量只访问它活跃的基本块，总代价与所有
+// 活跃区间的大小之和成正比，不需要 dfa::Framework 那样对每个基本块维护
+// 整个域的集合并迭代到不动点，在变量多、活跃区间短的大函数上快得多。
+//
+// 结果与 Liveness（lib/Liveness.cpp）完全相同，包括 phi 的处理：
+//  - phi 的操作数在 phi 所在的基本块中算作使用，即属于该块的 live-in；
+//  - 沿边 B -> S 回溯时，S 中 phi 来自 B 以外的前驱的取值不活跃
+//    （对应 Liveness::EdgeGenKill）。同一个值作为 S 中 phi 来自多个前驱的
+//    取值时，Liveness 在所有入边上都把它删掉，这里也一样；
+//  - 指令对自身的引用不算作使用。
+// 变量的编号也与 Liveness 的域相同（指令与形参按作为操作数首次出现的顺序），
+// 因此 getLiveInBV/getLiveOutBV 可以与 Liveness 的集合直接比较。
+// 注意 Liveness 是后向分析，它的 getInputBV 为 live-out，getOutputBV 为 live-in。
+class SparseLiveness {
+public:
+  explicit SparseLiveness(const llvm::Function &F);
+
+  // 变量：在函数中被用作操作数的指令与形参
+  unsigned getNumValues() const { return _values.size(); }
+  const llvm::Value *getValue(unsigned idx) const { return _values[idx]; }
+  // 不是变量时返回 -1
+  int getValueIndex(const llvm::Value *val) const {
+    auto iter = _value_index.find(val);
+    return iter == _value_index.end() ? -1 : static_cast<int>(iter->second);
+  }
+
+  unsigned getNumBlocks() const { return _blocks.size(); }
+  const llvm::BasicBlock &getBlock(unsigned block) const {
+    return *_blocks[block];
+  }
+  unsigned getBlockIndex(const llvm::BasicBlock &bb) const;
+
+  // 基本块入口与出口处活跃的变量，升序的变量编号
+  llvm::ArrayRef<unsigned> getLiveIn(const llvm::BasicBlock &bb) const {
+    return getList(_live_in, getBlockIndex(bb));
+  }
+  llvm::ArrayRef<unsigned> getLiveOut(const llvm::BasicBlock &bb) const {
+    return getList(_live_out, getBlockIndex(bb));
+  }
+  // 同上，转换为以变量编号为下标的比特向量
+  llvm::BitVector getLiveInBV(const llvm::BasicBlock &bb) const;
+  llvm::BitVector getLiveOutBV(const llvm::BasicBlock &bb) const;
+  // 单个变量的查询，二分查找。val 不是变量时返回 false
+  bool isLiveIn(const llvm::Value *val, const llvm::BasicBlock &bb) const;
+  bool isLiveOut(const llvm::Value *val, const llvm::BasicBlock &bb) const;
+
+  // 回溯时处理基本块的总次数，即所有变量的 live-in 集合大小之和
+  uint64_t getNumVisits() const { return _num_visits; }
+
+  // 每个基本块的 live-in 与 live-out
+  void print(llvm::raw_ostream &OS) const;
+
+private:
+  // 按基本块号排列的变量列表（CSR 格式）
+  struct BlockLists {
+    std::vector<unsigned> begin;
+    std::vector<unsigned> values;
+  };
+
+  static llvm::ArrayRef<unsigned> getList(const BlockLists &lists,
+                                          unsigned block) {
+    return llvm::ArrayRef<unsigned>(lists.values)
+        .slice(lists.begin[block], lists.begin[block + 1] - lists.begin[block]);
+  }
+  // (基本块号, 变量编号) 对按基本块号稳定排序，得到 CSR 格式的列表
+  static BlockLists
+  buildLists(unsigned num_blocks,
+             const std::vector<std::pair<unsigned, unsigned>> &pairs);
+  llvm::BitVector toBitVector(llvm::ArrayRef<unsigned> list) const;
+
+  std::vector<const llvm::BasicBlock *> _blocks;
+  llvm::DenseMap<const llvm::BasicBlock *, unsigned> _block_index;
+  std::vector<const llvm::Value *> _values;
+  llvm::DenseMap<const llvm::Value *, unsigned> _value_index;
+  BlockLists _live_in, _live_out;
+  uint64_t _num_visits = 0;
+};
+
+// New PM interface
+// 结果由 FunctionAnalysisManager 缓存，其他 pass 通过
+// FAM.getResult<SparseLivenessAnalysis>(F) 查询
+struct SparseLivenessAnalysis
+    : public llvm::AnalysisInfoMixin<SparseLivenessAnalysis> {
+  using Result = SparseLiveness;
+
+  Result run(llvm::Function &F, llvm::FunctionAnalysisManager &);
+
+  static bool isRequired() { return true; }
+
+private:
+  static llvm::AnalysisKey Key;
+  friend struct llvm::AnalysisInfoMixin<SparseLivenessAnalysis>;
+};
+
+// New PM interface for the printer pass: print<sparse-liveness>
+class SparseLivenessPrinter
+    : public llvm::PassInfoMixin<SparseLivenessPrinter> {
+public:
+  explicit SparseLivenessPrinter(llvm::raw_ostream &OutS) : OS(OutS) {}
+  llvm::PreservedAnalyses run(llvm::Function &F,
+                              llvm::FunctionAnalysisManager &FAM);
+  static bool isRequired() { return true; }
+
+private:
+  llvm::raw_ostream &OS;
+};
+
+#endif
@@ -0,0 +1,160 @@
+// 基于活跃性的栈槽着色
+#ifndef LLVM_EXERCISE_STACKCOLORING_H
+#define LLVM_EXERCISE_STACKCOLORING_H
+
+#include <cstdint>
+#include <vector>
+
+#include <llvm/ADT/ArrayRef.h>
+#include <llvm/ADT/DenseMap.h>
+#include <llvm/ADT/SmallVector.h>
+#include <llvm/IR/DataLayout.h>
+#include <llvm/IR/Instructions.h>
+#include <llvm/IR/IntrinsicInst.h>
+
+#include "cscd70/framework.h"
+
+// 栈槽：入口块中的静态 alloca
+class StackSlot {
+private:
+  const llvm::AllocaInst *_alloca;
+
+public:
+  StackSlot(const llvm::AllocaInst *alloca) : _alloca(alloca) {}
+
+  bool operator==(const StackSlot &slot) const {
+    return _alloca == slot.getAlloca();
+  }
+
+  const llvm::AllocaInst *getAlloca() const { return _alloca; }
+
+  friend llvm::raw_ostream &operator<<(llvm::raw_ostream &outs,
+                                       const StackSlot &slot);
+};
+
+namespace std {
+template <> struct hash<StackSlot> {
+  std::size_t operator()(const StackSlot &slot) const {
+    return std::hash<const llvm::AllocaInst *>()(slot.getAlloca());
+  }
+};
+} // namespace std
+
+// 指令对栈槽内存的一次访问
+struct SlotAccess {
+  enum Kind {
+    Read,
+    Write,
+    // 从偏移 0 开始覆盖整个栈槽的写，之前的内容不再活跃
+    Overwrite,
+    LifetimeStart,
+    LifetimeEnd,
+  };
+  unsigned slot;
+  Kind kind;
+};
+
+// 函数中可以参与合并的栈槽，以及每条指令对它们的访问。栈槽分为两类：
+//  - 不逃逸（tracked）：alloca 的地址（经过 bitcast、GEP）只用于
+//    load/store 的地址、memset/memcpy/memmove 的源或目的以及生命期标记，
+//    所有读写都可见，按内容的活跃性决定占用的范围；
+//  - 逃逸但有生命期标记：地址传给了调用等，读写不可见，按 LangRef，
+//    lifetime.start 之前与 lifetime.end 之后的访问是未定义行为，
+//    因此只在标记之间占用。
+// 其他栈槽（逃逸而没有标记、动态大小等）保持不变。
+// 栈槽按 alloca 在入口块中的顺序编号，与两个数据流分析的域相同
+class StackSlotInfo {
+public:
+  struct Slot {
+    llvm::AllocaInst *alloca;
+    uint64_t size;
+    llvm::Align align;
+    bool tracked;
+    // 该栈槽的 lifetime.start/end，合并之后删去
+    llvm::SmallVector<llvm::IntrinsicInst *, 2> markers;
+  };
+
+  StackSlotInfo(llvm::Function &F, const llvm::DataLayout &DL);
+
+  llvm::ArrayRef<Slot> getSlots() const { return _slots; }
+  // 不是栈槽时返回 -1
+  int getSlotIndex(const llvm::AllocaInst *alloca) const {
+    auto iter = _slot_index.find(alloca);
+    return iter == _slot_index.end() ? -1 : static_cast<int>(iter->second);
+  }
+  llvm::ArrayRef<SlotAccess> getAccesses(const llvm::Instruction &inst) const {
+    auto iter = _accesses.find(&inst);
+    return iter == _accesses.end() ? llvm::ArrayRef<SlotAccess>()
+                                   : llvm::ArrayRef<SlotAccess>(iter->second);
+  }
+
+private:
+  std::vector<Slot> _slots;
+  llvm::DenseMap<const llvm::AllocaInst *, unsigned> _slot_index;
+  llvm::DenseMap<const llvm::Instruction *, llvm::SmallVector<SlotAccess, 2>>
+      _accesses;
+};
+
+// 不逃逸的栈槽内容的活跃性（后向）：读取时活跃，被整体覆盖或遇到生命期
+// 标记时不再活跃
+class StackSlotLiveness final
+    : public dfa::StaticFramework<StackSlotLiveness, StackSlot,
+                                  dfa::Direction::Backward, dfa::UnionMeet,
+                                  dfa::EmptySetCond, dfa::EmptySetCond> {
+  friend static_framework_t;
+
+public:
+  explicit StackSlotLiveness(const StackSlotInfo &info) : _info(info) {}
+  virtual llvm::StringRef getName() const override {
+    return "stack-slot-liveness";
+  }
+
+protected:
+  virtual void GenKill(const solver_t &solver, const llvm::Instruction &inst,
+                       llvm::SmallVectorImpl<unsigned> &gen,
+                       llvm::SmallVectorImpl<unsigned> &kill) const override;
+  virtual void
+  InitializeDomainFromInstruction(solver_t &solver,
+                                  const llvm::Instruction &inst) const override;
+
+private:
+  const StackSlotInfo &_info;
+};
+
+// 逃逸的栈槽的生命期（前向）：lifetime.start 之后、lifetime.end 之前。
+// meet 为并集，任何一条路径上处于生命期内即视为占用
+class StackSlotLifetime final
+    : public dfa::StaticFramework<StackSlotLifetime, StackSlot,
+                                  dfa::Direction::Forward, dfa::UnionMeet,
+                                  dfa::EmptySetCond, dfa::EmptySetCond> {
+  friend static_framework_t;
+
+public:
+  explicit StackSlotLifetime(const StackSlotInfo &info) : _info(info) {}
+  virtual llvm::StringRef getName() const override {
+    return "stack-slot-lifetime";
+  }
+
+protected:
+  virtual void GenKill(const solver_t &solver, const llvm::Instruction &inst,
+                       llvm::SmallVectorImpl<unsigned> &gen,
+                       llvm::SmallVectorImpl<unsigned> &kill) const override;
+  virtual void
+  InitializeDomainFromInstruction(solver_t &solver,
+                                  const llvm::Instruction &inst) const override;
+
+private:
+  const StackSlotInfo &_info;
+};
+
+// New PM interface: -passes=dfa-stack-coloring
+// 在每条指令处，活跃的、被该指令访问的以及处于生命期内的栈槽两两冲突；
+// 按大小从大到小贪心着色，同一颜色的栈槽合并为其中最大的一个（对齐不低于
+// 其余成员）。每个函数节省的栈帧字节数以优化备注输出
+// （-pass-remarks=dfa-stack-coloring），累计值计入 STATISTIC
+struct StackColoringPass : public llvm::PassInfoMixin<StackColoringPass> {
+  llvm::PreservedAnalyses run(llvm::Function &F,
+                              llvm::FunctionAnalysisManager &FAM);
+};
+
+#endif
@@ -0,0 +1,62 @@
+#pragma once
+
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <type_traits>
+#include <utility>
+
+#include <llvm/ADT/BitVector.h>
+
+namespace dfa {
+
+// 比特向量的字类型，与 llvm::BitVector 的存储一致
+typedef uintptr_t word_t;
+static_assert(std::is_same<decltype(std::declval<llvm::BitVector>().getData()),
+                           llvm::ArrayRef<word_t>>::value,
+              "word_t 必须与 llvm::BitVector 的存储字一致");
+
+// GEN/KILL 传递函数 out = gen | (in & ~kill) 的整字实现。
+// 同一个核函数有三个版本，运行时按 CPU 支持的指令集选择最快的一个。
+enum class KernelKind { Scalar, SSE2, AVX2 };
+
+// 当前 CPU 上可用的最快版本
+KernelKind getBestKernel();
+
+// 当前 CPU 是否支持该版本
+bool isKernelSupported(KernelKind kind);
+
+const char *getKernelName(KernelKind kind);
+
+// 计算 out = gen | (in & ~kill)，共 num_words 个字，返回 out 是否发生变化。
+// out 可以与 in 是同一块内存。
+bool transferWords(KernelKind kind, word_t *out, const word_t *in,
+                   const word_t *gen, const word_t *kill, size_t num_words);
+
+// 使用 getBestKernel() 选出的版本
+bool transferWords(word_t *out, const word_t *in, const word_t *gen,
+                   const word_t *kill, size_t num_words);
+
+// 在 llvm::BitVector 上应用 out = gen | (in & ~kill)，返回 out 是否发生变化。
+// BitVector 只提供只读的 getData()；out 本身不是 const 对象，
+// 因此通过 const_cast 原地写入它的存储是合法的。各输入未使用的高位均为 0，
+// 结果的高位也为 0，满足 BitVector 的不变式。
+inline bool transferBV(llvm::BitVector &out, const llvm::BitVector &in,
+                       const llvm::BitVector &gen,
+                       const llvm::BitVector &kill) {
+  assert(in.size() == gen.size() && in.size() == kill.size() &&
+         "GEN/KILL 的大小必须等于域的大小");
+  bool resized = out.size() != in.size();
+  if (resized) {
+    out.resize(in.size());
+  }
+  if (in.empty()) {
+    return resized;
+  }
+  word_t *out_words = const_cast<word_t *>(out.getData().data());
+  return transferWords(out_words, in.getData().data(), gen.getData().data(),
+                       kill.getData().data(), in.getData().size()) ||
+         resized;
+}
+
+} // namespace dfa
@@ -0,0 +1,398 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdlib>
+#include <memory>
+#include <utility>
+#include <vector>
+
+#include <llvm/ADT/ArrayRef.h>
+#include <llvm/ADT/BitVector.h>
+#include <llvm/Support/ErrorHandling.h>
+
+#include "cscd70/bitkernels.h"
+#include "cscd70/sets.h"
+
+namespace dfa {
+
+// meet 运算：前向/后向分析中对前驱/后继的输出集合取并集或交集
+enum class MeetKind { Union, Intersect };
+
+// meet 运算的编译期策略。BlockSets::visit 以策略为模板参数，
+// 内层的整字循环没有分支，可以内联并向量化
+struct UnionMeet {
+  static constexpr MeetKind kind_c = MeetKind::Union;
+  static void apply(word_t *dst, const word_t *src, size_t num_words) {
+    for (size_t w = 0; w < num_words; ++w) {
+      dst[w] |= src[w];
+    }
+  }
+  template <typename TSet> static void apply(TSet &dst, const TSet &src) {
+    dst |= src;
+  }
+};
+
+struct IntersectMeet {
+  static constexpr MeetKind kind_c = MeetKind::Intersect;
+  static void apply(word_t *dst, const word_t *src, size_t num_words) {
+    for (size_t w = 0; w < num_words; ++w) {
+      dst[w] &= src[w];
+    }
+  }
+  template <typename TSet> static void apply(TSet &dst, const TSet &src) {
+    dst &= src;
+  }
+};
+
+// 行优先的比特矩阵：所有行位于同一块连续内存中，每行 W 个字
+// （W = ceil(列数 / word_bits)），第 r 行从第 r * W 个字开始，
+// 行内位的排列与 llvm::BitVector 相同。各行未使用的高位始终为 0
+class SetMatrix {
+public:
+  static constexpr unsigned kWordBits = sizeof(word_t) * 8;
+
+  SetMatrix() {}
+  // 所有位初始为 0。存储由 calloc 分配：大矩阵直接映射操作系统的零页，
+  // 不需要再逐字清零
+  SetMatrix(unsigned num_rows, unsigned num_bits)
+      : _num_rows(num_rows), _num_bits(num_bits),
+        _num_words((num_bits + kWordBits - 1) / kWordBits),
+        _words(static_cast<word_t *>(
+            std::calloc(std::max<size_t>(size(), 1), sizeof(word_t)))) {
+    if (!_words) {
+      llvm::report_bad_alloc_error("SetMatrix: 内存不足");
+    }
+  }
+
+  unsigned getNumRows() const { return _num_rows; }
+  unsigned getNumBits() const { return _num_bits; }
+  // 每行的字数
+  unsigned getNumWords() const { return _num_words; }
+
+  word_t *row(unsigned r) {
+    return _words.get() + static_cast<size_t>(r) * _num_words;
+  }
+  const word_t *row(unsigned r) const {
+    return _words.get() + static_cast<size_t>(r) * _num_words;
+  }
+
+  bool test(unsigned r, unsigned idx) const {
+    return (row(r)[idx / kWordBits] >> (idx % kWordBits)) & 1;
+  }
+  void set(unsigned r, unsigned idx) {
+    row(r)[idx / kWordBits] |= word_t(1) << (idx % kWordBits);
+  }
+
+  void setRow(unsigned r, const llvm::BitVector &bv);
+  llvm::BitVector getRow(unsigned r) const;
+  void copyRow(unsigned dst, unsigned src);
+
+  size_t getMemoryUsage() const {
+    return sizeof(*this) + size() * sizeof(word_t);
+  }
+
+private:
+  struct FreeDeleter {
+    void operator()(word_t *words) const { std::free(words); }
+  };
+
+  // 矩阵的总字数
+  size_t size() const { return static_cast<size_t>(_num_rows) * _num_words; }
+
+  unsigned _num_rows = 0;
+  unsigned _num_bits = 0;
+  unsigned _num_words = 0;
+  std::unique_ptr<word_t[], FreeDeleter> _words;
+};
+
+// BlockSets<DenseSet> 在共享矩阵中占用的列：第 word_offset 个字开始的
+// ceil(域大小 / word_bits) 个字。多个分析融合求解时（见 FusedSolver），
+// 它们的集合在同一个矩阵的每一行中并排存放
+struct SlabSlice {
+  std::shared_ptr<SetMatrix> matrix;
+  unsigned word_offset = 0;
+};
+
+// 控制流边上的调整（升序的域下标）。边上的 GEN/KILL 通常只有几个元素，
+// 因此保存为下标列表，meet 时在操作数集合的副本上逐位修改
+struct EdgeAdjust {
+  llvm::ArrayRef<unsigned> gen;
+  llvm::ArrayRef<unsigned> kill;
+};
+
+// 一个函数中所有基本块的集合：每个基本块的 GEN、KILL 与遍历方向上的
+// 输入/输出集合，以及有调整的控制流边的 GEN/KILL，按 Solver 给出的稠密
+// 基本块号与边号索引（边上的下标列表由 Solver 持有，这里只引用）。
+// SetSolver 决定迭代顺序，BlockSets 负责集合的存储、meet 与传递函数。
+// 通用版本中每个集合是一个独立的 TSet 对象；DenseSet 的特化（见下）把
+// 全部集合放在一个 SetMatrix 中。
+//  @tparam TSet 集合策略：DenseSet、SparseSet 或 ChunkedSet（见 sets.h）
+template <typename TSet> class BlockSets {
+public:
+  static constexpr SetKind kind_c = TSet::kind_c;
+
+  // 所有集合初始为空。track_memory 为真时在 visit 中维护集合占用的内存
+  BlockSets(unsigned num_blocks, unsigned num_edges, unsigned domain_size,
+            const llvm::BitVector &ic, const llvm::BitVector &bc,
+            bool track_memory)
+      : _domain_size(domain_size), _ic(TSet::fromBitVector(ic)),
+        _bc(TSet::fromBitVector(bc)), _track_memory(track_memory),
+        _blocks(num_blocks), _edges(num_edges) {}
+
+  void setGenKill(unsigned block, llvm::ArrayRef<unsigned> gen,
+                  llvm::ArrayRef<unsigned> kill) {
+    Block &b = _blocks[block];
+    b.gen = fromIndices(gen);
+    b.kill = fromIndices(kill);
+  }
+
+  void setEdge(unsigned edge, llvm::ArrayRef<unsigned> gen,
+               llvm::ArrayRef<unsigned> kill) {
+    _edges[edge].gen = gen;
+    _edges[edge].kill = kill;
+  }
+
+  // 输入集合置空，输出集合置为 IC
+  void resetBlock(unsigned block) {
+    _blocks[block].input = TSet(_domain_size);
+    _blocks[block].output = _ic;
+  }
+
+  // 直接设置输入/输出集合，用于读回缓存的结果
+  void setBlock(unsigned block, const llvm::BitVector &input,
+                const llvm::BitVector &output) {
+    _blocks[block].input = TSet::fromBitVector(input);
+    _blocks[block].output = TSet::fromBitVector(output);
+  }
+
+  // 取出 old 中 old_block 的输入/输出集合。mapping 为旧下标到新下标的映射
+  // （-1 表示已删除，为空表示域没有变化），新元素取 fill 中的值
+  void takeBlock(unsigned block, BlockSets &old, unsigned old_block,
+                 llvm::ArrayRef<int> mapping, unsigned old_size,
+                 const llvm::BitVector &fill) {
+    Block &b = _blocks[block];
+    Block &old_b = old._blocks[old_block];
+    if (mapping.empty()) {
+      b.input = std::move(old_b.input);
+      b.output = std::move(old_b.output);
+    } else {
+      b.input = remap(old_b.input, mapping, old_size, fill);
+      b.output = remap(old_b.output, mapping, old_size, fill);
+    }
+  }
+
+  // 对基本块做 meet 并应用 GEN/KILL，返回输出集合是否发生变化。
+  // operands 为 meet 操作数的基本块号，edges 为对应边的边号（-1 表示没有调整）；
+  // 没有操作数时输入集合为 BC
+  //  @tparam TMeet meet 策略：UnionMeet 或 IntersectMeet
+  template <typename TMeet>
+  bool visit(unsigned block, llvm::ArrayRef<unsigned> operands,
+             llvm::ArrayRef<int> edges) {
+    Block &b = _blocks[block];
+    size_t before = 0;
+    if (_track_memory) {
+      before = b.input.getMemoryUsage() + b.output.getMemoryUsage();
+    }
+    meet<TMeet>(b.input, operands, edges);
+    bool changed = TSet::transfer(b.output, b.input, b.gen, b.kill);
+    if (_track_memory) {
+      _memory += b.input.getMemoryUsage() + b.output.getMemoryUsage();
+      _memory -= before;
+    }
+    return changed;
+  }
+
+  llvm::BitVector getInputBV(unsigned block) const {
+    return _blocks[block].input.toBitVector(_domain_size);
+  }
+  llvm::BitVector getOutputBV(unsigned block) const {
+    return _blocks[block].output.toBitVector(_domain_size);
+  }
+
+  // 所有集合当前占用的内存（字节）。初始化完成后由 recomputeMemory 统计，
+  // 之后由 visit 增量维护
+  size_t getMemoryUsage() const { return _memory; }
+  void recomputeMemory() {
+    _memory = 0;
+    for (const Block &b : _blocks) {
+      _memory += b.gen.getMemoryUsage() + b.kill.getMemoryUsage() +
+                 b.input.getMemoryUsage() + b.output.getMemoryUsage();
+    }
+  }
+
+private:
+  struct Block {
+    TSet gen;    // 块内各指令传递函数复合后产生的元素
+    TSet kill;   // 块内各指令传递函数复合后杀死的元素
+    TSet input;  // 遍历方向上的输入集合（前向为 IN[B]，后向为 OUT[B]）
+    TSet output; // 遍历方向上的输出集合（前向为 OUT[B]，后向为 IN[B]）
+  };
+
+  TSet fromIndices(llvm::ArrayRef<unsigned> indices) const {
+    TSet set(_domain_size);
+    for (unsigned idx : indices) {
+      set.set(idx);
+    }
+    return set;
+  }
+
+  static TSet remap(const TSet &set, llvm::ArrayRef<int> mapping,
+                    unsigned old_size, const llvm::BitVector &fill) {
+    llvm::BitVector bv = fill;
+    for (unsigned idx : set.toBitVector(old_size).set_bits()) {
+      if (mapping[idx] != -1) {
+        bv.set(mapping[idx]);
+      }
+    }
+    return TSet::fromBitVector(bv);
+  }
+
+  // 边上的调整只涉及少数几个元素，先去掉 kill，再加入 gen
+  template <typename TMeet>
+  void meet(TSet &input, llvm::ArrayRef<unsigned> operands,
+            llvm::ArrayRef<int> edges) {
+    if (operands.empty()) {
+      input = _bc;
+      return;
+    }
+    for (unsigned k = 0; k < operands.size(); ++k) {
+      const TSet *contrib = &_blocks[operands[k]].output;
+      if (edges[k] != -1) {
+        const EdgeAdjust &edge = _edges[edges[k]];
+        _edge_tmp = *contrib;
+        for (unsigned idx : edge.kill) {
+          _edge_tmp.reset(idx);
+        }
+        for (unsigned idx : edge.gen) {
+          _edge_tmp.set(idx);
+        }
+        contrib = &_edge_tmp;
+      }
+      if (k == 0) {
+        input = *contrib;
+      } else {
+        TMeet::apply(input, *contrib);
+      }
+    }
+  }
+
+  unsigned _domain_size;
+  TSet _ic;
+  TSet _bc;
+  bool _track_memory;
+  std::vector<Block> _blocks;
+  std::vector<EdgeAdjust> _edges;
+  // 经过边上调整的 meet 操作数的临时集合
+  TSet _edge_tmp;
+  size_t _memory = 0;
+};
+
+// 稠密表示的特化：一个函数的全部集合存放在同一个 SetMatrix 中，
+// 行的排列为
+//   基本块 b:  第 4b 到 4b+3 行，依次为 GEN、KILL、输入、输出
+//   最后三行:  IC、BC 与边上调整的临时集合
+// 同一基本块的四个集合相邻，visit 一个基本块只访问连续的 4W 个字；
+// 整个求解过程只有一次内存分配，meet 与传递函数直接在行上做整字运算。
+// 矩阵也可以由多个 BlockSets 共享，每个只使用其中的若干列（见 SlabSlice）
+template <> class BlockSets<DenseSet> {
+public:
+  static constexpr SetKind kind_c = SetKind::Dense;
+
+  // 独占一个新的矩阵
+  BlockSets(unsigned num_blocks, unsigned num_edges, unsigned domain_size,
+            const llvm::BitVector &ic, const llvm::BitVector &bc,
+            bool track_memory);
+  // 使用共享矩阵中 slice 指定的列，矩阵必须有 num_blocks * 4 + 3 行
+  BlockSets(unsigned num_blocks, unsigned num_edges, unsigned domain_size,
+            const llvm::BitVector &ic, const llvm::BitVector &bc,
+            const SlabSlice &slice);
+
+  // 矩阵的行数；共享矩阵的列数为各个使用者所需的字数之和
+  static unsigned getNumRows(unsigned num_blocks) {
+    return num_blocks * NumSlots + 3;
+  }
+
+  void setGenKill(unsigned block, llvm::ArrayRef<unsigned> gen,
+                  llvm::ArrayRef<unsigned> kill);
+  void setEdge(unsigned edge, llvm::ArrayRef<unsigned> gen,
+               llvm::ArrayRef<unsigned> kill);
+  void resetBlock(unsigned block);
+  void setBlock(unsigned block, const llvm::BitVector &input,
+                const llvm::BitVector &output) {
+    setRow(blockRow(block, Input), input);
+    setRow(blockRow(block, Output), output);
+  }
+  void takeBlock(unsigned block, BlockSets &old, unsigned old_block,
+                 llvm::ArrayRef<int> mapping, unsigned old_size,
+                 const llvm::BitVector &fill);
+  // 对 UnionMeet 与 IntersectMeet 显式实例化（见 BlockSets.cpp）
+  template <typename TMeet>
+  bool visit(unsigned block, llvm::ArrayRef<unsigned> operands,
+             llvm::ArrayRef<int> edges);
+
+  // 按域切片求解（见 SetSolver::solveSliced）：复制第 [word_begin, word_end)
+  // 个字对应的域元素，得到一个独占新矩阵的独立问题，下标减去
+  // word_begin * word_bits。GEN/KILL 的每一位互不影响，各片可以分别求解
+  BlockSets extractColumns(unsigned word_begin, unsigned word_end) const;
+  // 把 extractColumns 得到的 slice 的 IN/OUT 写回原来的列。不同的片只写
+  // 各自的字，因此可以在多个线程上同时写回
+  void storeColumns(const BlockSets &slice, unsigned word_begin);
+  unsigned getNumWords() const { return _num_words; }
+
+  llvm::BitVector getInputBV(unsigned block) const {
+    return getRow(blockRow(block, Input));
+  }
+  llvm::BitVector getOutputBV(unsigned block) const {
+    return getRow(blockRow(block, Output));
+  }
+
+  // 矩阵的大小在构造时确定，求解过程中不变；共享矩阵时只计入自己的列
+  size_t getMemoryUsage() const {
+    return sizeof(SetMatrix) +
+           static_cast<size_t>(_matrix->getNumRows()) * _num_words *
+               sizeof(word_t);
+  }
+  void recomputeMemory() {}
+
+private:
+  enum Slot { Gen, Kill, Input, Output, NumSlots };
+
+  // 只设置成员，IC/BC 与集合由调用者填写
+  BlockSets(unsigned num_blocks, unsigned num_edges, unsigned domain_size,
+            const SlabSlice &slice);
+
+  static unsigned blockRow(unsigned block, Slot slot) {
+    return block * NumSlots + slot;
+  }
+  unsigned icRow() const { return _num_blocks * NumSlots; }
+  unsigned bcRow() const { return icRow() + 1; }
+  unsigned tmpRow() const { return icRow() + 2; }
+
+  // 第 r 行中属于本对象的 _num_words 个字
+  word_t *row(unsigned r) { return _matrix->row(r) + _word_offset; }
+  const word_t *row(unsigned r) const {
+    return _matrix->row(r) + _word_offset;
+  }
+  void set(unsigned r, unsigned idx) {
+    row(r)[idx / SetMatrix::kWordBits] |= word_t(1)
+                                          << (idx % SetMatrix::kWordBits);
+  }
+  void setRow(unsigned r, const llvm::BitVector &bv);
+  llvm::BitVector getRow(unsigned r) const;
+  void copyRow(unsigned dst, unsigned src) {
+    std::copy(row(src), row(src) + _num_words, row(dst));
+  }
+  void setIndices(unsigned r, llvm::ArrayRef<unsigned> indices);
+
+  unsigned _num_blocks;
+  unsigned _domain_size;
+  std::vector<EdgeAdjust> _edges;
+  // extractColumns 得到的切片自己持有平移后的边上下标，_edges 引用这里
+  std::vector<unsigned> _edge_indices;
+  std::shared_ptr<SetMatrix> _matrix;
+  unsigned _word_offset = 0;
+  unsigned _num_words;
+};
+
+} // namespace dfa
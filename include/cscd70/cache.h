@@ -0,0 +1,47 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include <llvm/ADT/BitVector.h>
+#include <llvm/ADT/StringRef.h>
+#include <llvm/IR/Function.h>
+#include <llvm/Support/CommandLine.h>
+
+#include "cscd70/sets.h"
+
+namespace dfa {
+
+// dfa::Framework 结果的磁盘缓存（-dfa-cache-dir），实现在 lib/Cache.cpp。
+// 每个函数的基本块集合存为一个文件，文件名由函数体的结构哈希、分析名与
+// 分析版本决定，因此函数没有变化时再次运行 opt 可以直接读回结果。
+// 命中与未命中计入 STATISTIC（-stats，DEBUG_TYPE 为 "dfa-cache"）。
+// 写入先写临时文件再改名，多个线程或进程同时写同一个文件也是安全的。
+
+// 命令行选项 -dfa-cache-dir，为空时不使用缓存
+extern llvm::cl::opt<std::string> DFACacheDir;
+
+// 一个函数的求解结果：按基本块号排列的遍历方向上的输入/输出集合，
+// 以及求解时使用的集合表示
+struct CachedSets {
+  SetKind set_kind = SetKind::Dense;
+  std::vector<llvm::BitVector> inputs;
+  std::vector<llvm::BitVector> outputs;
+};
+
+// F 的结果在缓存目录中的路径。未设置 -dfa-cache-dir 或 analysis 为空
+// （分析不使用缓存）时返回空串。
+// 结构哈希只覆盖 GEN/KILL 类分析依赖的内容（见 lib/Cache.cpp），与值的
+// 名字无关；分析的钩子语义改变时应增加 version
+std::string getCachePath(const llvm::Function &F, llvm::StringRef analysis,
+                         unsigned version);
+
+// 读取缓存文件。文件不存在、格式不符或形状（基本块数、域大小）不一致时
+// 返回 false，计为未命中
+bool loadCachedSets(llvm::StringRef path, unsigned num_blocks,
+                    unsigned domain_size, CachedSets &sets);
+
+// 写入缓存文件，必要时创建缓存目录。失败时只放弃写入，不报错
+void storeCachedSets(llvm::StringRef path, const CachedSets &sets);
+
+} // namespace dfa
@@ -1,19 +1,42 @@
 #pragma once
 
+#include <algorithm>
+#include <array>
 #include <cassert>
+#include <functional>
+#include <iterator>
+#include <memory>
+#include <queue>
+#include <string>
+#include <tuple>
 #include <type_traits>
 #include <unordered_map>
-#include <unordered_set>
+#include <vector>
 
+#include <llvm/ADT/ArrayRef.h>
 #include <llvm/ADT/BitVector.h>
-#include <llvm/ADT/PostOrderIterator.h>
+#include <llvm/ADT/DenseMap.h>
+#include <llvm/ADT/SmallPtrSet.h>
+#include <llvm/ADT/SmallVector.h>
 #include <llvm/IR/CFG.h>
 #include <llvm/IR/Function.h>
 #include <llvm/IR/InstIterator.h>
 #include <llvm/IR/Instructions.h>
+#include <llvm/IR/Module.h>
+#include <llvm/IR/PassManager.h>
 #include <llvm/Pass.h>
+#include <llvm/Support/CommandLine.h>
+#include <llvm/Support/Format.h>
+#include <llvm/Support/ThreadPool.h>
+#include <llvm/Support/Threading.h>
 #include <llvm/Support/raw_ostream.h>
 
+#include "cscd70/bitkernels.h"
+#include "cscd70/blocksets.h"
+#include "cscd70/cache.h"
+#include "cscd70/sets.h"
+#include "cscd70/stats.h"
+
 using namespace llvm;
 
 namespace dfa {
@@ -21,11 +44,73 @@ namespace dfa {
 // 分析方向枚举，用于确定数据流分析是向前还是向后
 enum class Direction { Forward, Backward };
 
-// 数据流分析框架的定义
-//  @tparam TDomainElement 数据流分析的域元素类型
-//  @tparam TDirection 分析的方向（向前或向后）
-template <typename TDomainElement, Direction TDirection>
-class Framework : public FunctionPass {
+// 不动点求解策略
+//  RoundRobin: 按布局顺序反复遍历所有基本块，直到没有变化
+//  Worklist:   按逆后序（前向）或后序（后向）处理工作表，只有当基本块的
+//              边界集合发生变化时才把它的后继（前向）或前驱（后向）重新入队
+//  SCC:        按依赖图的嵌套强连通分量（见 ComponentOrder）求解，内层循环
+//              先迭代到局部不动点，再回到外层；增量更新时使用工作表
+enum class SolverKind { RoundRobin, Worklist, SCC };
+
+// 求解策略在 -dfa-solver 中的名字，定义在 lib/Framework.cpp
+const char *getSolverKindName(SolverKind kind);
+
+// 命令行选项 -dfa-solver，定义在 lib/Framework.cpp
+extern cl::opt<SolverKind> DFASolver;
+// 命令行选项 -dfa-threads，定义在 lib/Framework.cpp
+extern cl::opt<unsigned> DFAThreads;
+// 命令行选项 -dfa-set 与 -dfa-set-stats，定义在 lib/Framework.cpp
+extern cl::opt<SetKind> DFASet;
+extern cl::opt<bool> DFASetStats;
+// 命令行选项 -dfa-loop-stats，定义在 lib/Framework.cpp
+extern cl::opt<bool> DFALoopStats;
+// 命令行选项 -dfa-domain-slices，定义在 lib/Framework.cpp
+extern cl::opt<unsigned> DFADomainSlices;
+
+// 按函数并行的任务（ModuleDriver、ModuleSummaries）在执行期间持有一个
+// ModuleTaskScope。此时硬件线程已经被这些任务占满，任务中的求解不再按域
+// 切片（见 Solver::getNumDomainSlices），以免每个任务再建立自己的线程池
+class ModuleTaskScope {
+public:
+  ModuleTaskScope() : _outer(_active) { _active = true; }
+  ~ModuleTaskScope() { _active = _outer; }
+  ModuleTaskScope(const ModuleTaskScope &) = delete;
+  ModuleTaskScope &operator=(const ModuleTaskScope &) = delete;
+
+  // 当前线程是否在执行按函数并行的任务
+  static bool isActive() { return _active; }
+
+private:
+  bool _outer;
+  static inline thread_local bool _active = false;
+};
+
+// 结果的输出格式，命令行选项 -dfa-print 与 -dfa-output 定义在 lib/Framework.cpp
+//  None:      只求解，不输出（旧 PassManager 下的默认值）
+//  Text:      每条指令及其集合的文本，即 printInstBVMap
+//  Summary:   每个基本块 IN/OUT 集合的大小
+//  JSONLines: 每行一个 JSON 对象，集合为字数组
+//  Binary:    小端序的二进制记录，集合为字数组
+enum class PrintFormat { None, Text, Summary, JSONLines, Binary };
+extern cl::opt<PrintFormat> DFAPrint;
+extern cl::opt<std::string> DFAOutput;
+
+// -dfa-output 指定的输出流，"-" 表示 outs()。文件使用 64KB 的缓冲区；
+// binary 格式在开头写入魔数 "DFA1"
+class Output {
+public:
+  Output();
+  ~Output();
+  raw_ostream &os() { return _file ? *_file : outs(); }
+
+private:
+  std::unique_ptr<raw_fd_ostream> _file;
+};
+
+// 写入带转义的 JSON 字符串
+void writeJSONString(raw_ostream &OS, StringRef str);
+// 以小端序写入 value 的低 bytes 个字节
+void writeLE(raw_ostream &OS, uint64_t value, unsigned bytes);
 
 // 定义一个宏，用于根据分析方向启用特定的方法
 //  @param dir 分析的方向
@@ -34,164 +119,2039 @@ class Framework : public FunctionPass {
   template <Direction _TDirection = TDirection> \
   typename std::enable_if<_TDirection == dir, ret>::type
 
-protected:
-  // 定义域元素类型的别名
-  typedef TDomainElement domain_element_t;
-  // 分析方向的静态常量
-  static constexpr Direction direction_c = TDirection;
+template <typename TDomainElement, Direction TDirection> class Framework;
+template <typename TDomainElement, Direction TDirection> class Solver;
+template <typename... TAnalyses> class FusedSolver;
+template <typename TDomainElement, Direction TDirection> class QueryEngine;
+
+// 依赖图（前向分析为后继边，后向分析为前驱边）的嵌套强连通分量，即
+// Bourdoncle 的弱拓扑序：最外层的元素按拓扑序排列，每个非平凡的强连通分量
+// 以遍历顺序中最靠前的基本块为头，去掉头之后其余部分递归地分解为更小的
+// 分量。可归约的控制流图中，分量就是循环，嵌套关系与循环嵌套相同。
+// 元素以 int 表示：>= 0 为基本块号，< 0 为分量 ~item
+struct ComponentOrder {
+  struct Component {
+    unsigned head;
+    // 外层分量，-1 表示最外层
+    int parent;
+    // 嵌套深度，最外层的分量为 1
+    unsigned depth;
+    // 除头以外的元素，按拓扑序
+    std::vector<int> body;
+  };
 
-  // 域集合，存储分析中的所有元素
-  std::unordered_set<TDomainElement> _domain;
+  std::vector<int> top;
+  std::vector<Component> components;
+  // 基本块所在的最内层分量，不在任何分量中时为 -1
+  std::vector<int> block_component;
+};
 
-  // 指令到比特向量的映射
-  // 映射从指令指针到比特向量（用于存储OUT集合）
-  std::unordered_map<const Instruction *, BitVector> _inst_bv_map;
+// 函数中基本块与指令的稠密编号以及控制流图的邻接关系，由 build 一次性建立
+// （与指令数和控制流边数成线性），之后不再修改。基本块号与指令号都是在
+// 函数中的布局顺序；meet 操作数与依赖者按压缩稀疏行（CSR）格式存放在连续的
+// 数组中，求解时不再查找哈希表或遍历 use 链表。
+// 只取决于函数与分析方向，因此同一方向的多个分析可以共享（见 FusedSolver）
+struct CFGIndex {
+  std::vector<const BasicBlock *> blocks;
+  DenseMap<const BasicBlock *, unsigned> block_index;
+  // 基本块 b 的指令号为 [inst_begin[b], inst_begin[b + 1])
+  std::vector<unsigned> inst_begin;
+  DenseMap<const Instruction *, unsigned> inst_index;
+  // 基本块 b 的 meet 操作数为 operands[operand_begin[b] .. operand_begin[b + 1])
+  std::vector<unsigned> operand_begin;
+  std::vector<unsigned> operands;
+  // 基本块的出口集合变化后需要重新计算的基本块，格式同上
+  std::vector<unsigned> dependent_begin;
+  std::vector<unsigned> dependents;
+  // 工作表求解的处理顺序及每个基本块在其中的位置：前向分析为逆后序，
+  // 后向分析为后序，从入口不可达的基本块按布局顺序追加在末尾
+  std::vector<unsigned> order;
+  std::vector<unsigned> order_pos;
+  // 嵌套强连通分量，只在 build 的 with_components 为真时建立
+  ComponentOrder components;
 
-  // 返回初始条件的虚函数，由子类实现
-  virtual BitVector IC() const = 0;
+  // 定义在 lib/Framework.cpp。with_components 用于 SolverKind::SCC 与
+  // -dfa-loop-stats，代价为 O(边数 × 最大嵌套深度)
+  static std::shared_ptr<const CFGIndex>
+  build(const Function &func, Direction direction,
+        bool with_components = false);
+};
 
-  // 返回边界条件的虚函数，由子类实现
-  virtual BitVector BC() const = 0;
+// 按 ComponentOrder 的元素递归求解，见 solveComponents
+template <typename TVisit, typename TOnIteration>
+void solveComponentItems(const ComponentOrder &order, ArrayRef<int> items,
+                         TVisit &visit, TOnIteration &on_iteration) {
+  for (int item : items) {
+    if (item >= 0) {
+      visit(item);
+      continue;
+    }
+    const ComponentOrder::Component &component = order.components[~item];
+    visit(component.head);
+    do {
+      on_iteration(~item);
+      solveComponentItems(order, component.body, visit, on_iteration);
+    } while (visit(component.head));
+  }
+}
+
+// 按 cfg.components 求解（Bourdoncle 的递归策略）：最外层的元素按拓扑序各
+// 处理一次；分量先处理头，再反复处理其余元素（内层分量递归地迭代到局部
+// 不动点）与头，直到头的输出集合不再变化。每个环都经过头，因此头稳定时
+// 整个分量也稳定了。
+// 与工作表一样跳过操作数自上次处理以来都没有变化的基本块：除头以外，
+// 分量内的边都指向拓扑序靠后的元素，因此一遍之后只有头可能需要重新处理
+//  @param visit 处理一个基本块，返回输出集合是否变化
+//  @param on_iteration 分量每迭代一遍时调用，参数为分量号
+template <typename TVisit, typename TOnIteration>
+void solveComponents(const CFGIndex &cfg, TVisit &visit,
+                     TOnIteration &on_iteration) {
+  BitVector dirty(cfg.blocks.size(), true);
+  auto visit_dirty = [&](unsigned block) {
+    if (!dirty.test(block)) {
+      return false;
+    }
+    dirty.reset(block);
+    if (!visit(block)) {
+      return false;
+    }
+    for (unsigned slot = cfg.dependent_begin[block];
+         slot < cfg.dependent_begin[block + 1]; ++slot) {
+      dirty.set(cfg.dependents[slot]);
+    }
+    return true;
+  };
+  solveComponentItems(cfg.components, cfg.components.top, visit_dirty,
+                      on_iteration);
+}
+
+// -dfa-loop-stats 的统计：每个基本块被处理的次数，以及按分量求解时
+// 每个分量迭代的遍数（按 ComponentOrder 中的分量号索引）
+struct LoopStats {
+  std::vector<unsigned> block_visits;
+  std::vector<unsigned> iterations;
+};
+
+// 按某种集合表示保存基本块集合并迭代到不动点。Solver 在建立域与
+// GEN/KILL 摘要之后选择集合表示，并通过这个接口访问结果，
+// 因此 Solver 的使用者不需要知道具体的集合类型。
+// 基本块以 Solver 的稠密基本块号（布局顺序）标识。
+class SetSolverBase {
+public:
+  virtual ~SetSolverBase() {}
+
+  virtual void solve() = 0;
+  virtual SetKind getSetKind() const = 0;
+  // 以下查询把集合转换为比特向量返回
+  virtual BitVector getInputBV(unsigned block) const = 0;
+  virtual BitVector getOutputBV(unsigned block) const = 0;
+  // 求解过程中所有集合占用内存的峰值（字节），只在 isSetMemoryTracked 时统计
+  virtual size_t getPeakMemory() const = 0;
+  // 累计处理基本块的次数（包括增量更新）
+  virtual unsigned getNumVisits() const = 0;
+  // 累计调用块与边的传递函数的次数（包括增量更新），见 SolveStats::transfers
+  virtual uint64_t getNumTransfers() const = 0;
+  // 最近一次求解或增量更新的遍数，见 SolveStats::sweeps
+  virtual unsigned getNumSweeps() const = 0;
+  // 直接设置基本块的集合，用于读回缓存的结果（见 cscd70/cache.h）；
+  // 所有基本块设置完之后调用 finishSetBlocks 重新统计集合内存
+  virtual void setBlock(unsigned block, const BitVector &input,
+                        const BitVector &output) = 0;
+  virtual void finishSetBlocks() = 0;
+
+  // 对单个基本块做 meet 与传递函数，返回输出集合是否发生变化。
+  // solve 在内部使用；FusedSolver 在多个分析共享的遍历中直接调用
+  virtual bool visitBlock(unsigned block) = 0;
+
+  // -dfa-loop-stats 下的统计，未开启时为空
+  virtual const LoopStats *getLoopStats() const = 0;
+  // 按分量求解时，分量 component 又迭代了一遍
+  virtual void countIteration(unsigned component) = 0;
+  // 开始新的一遍；FusedSolver 自己迭代时由它计数
+  virtual void countSweep() = 0;
+
+  // 增量更新，见 Solver::update。cone 中的基本块与新出现的基本块
+  // （old_blocks 中为 -1，old_blocks 为新块号到旧块号的映射）重置为 IC，
+  // 其余基本块的集合按 mapping（旧下标 -> 新下标，-1 表示已删除；为空表示
+  // 域没有变化）搬到新的域上，新元素取 fill 中的值。之后只从 cone 开始迭代
+  virtual void update(const BitVector &cone, ArrayRef<int> old_blocks,
+                      ArrayRef<int> mapping, unsigned old_size,
+                      const BitVector &fill, const BitVector &ic,
+                      const BitVector &bc) = 0;
+};
+
+// 以 TSet 为集合表示的求解状态，包含两种迭代策略。
+// 集合的存储、meet 与传递函数由 BlockSets<TSet> 完成（见 blocksets.h），
+// 控制流图的邻接关系与遍历顺序取自 Solver 中按基本块号建立的数组。
+// 求解时只在基本块之间迭代，单条指令的集合由 Solver::getInstBV 按需计算，
+// 因此内存为 O(基本块数 × 集合大小)，而不是 O(指令数 × 集合大小)。
+//  @tparam TSet 集合策略：DenseSet、SparseSet 或 ChunkedSet（见 sets.h）
+//  @tparam TMeet meet 策略：UnionMeet 或 IntersectMeet（见 blocksets.h）
+template <typename TDomainElement, Direction TDirection, typename TSet,
+          typename TMeet>
+class SetSolver final : public SetSolverBase {
+public:
+  typedef Solver<TDomainElement, TDirection> solver_t;
+
+private:
+  const solver_t &_solver;
+  BlockSets<TSet> _sets;
+
+  // 是否统计集合内存的峰值，见 isSetMemoryTracked
+  bool _track_memory = isSetMemoryTracked();
+  size_t _peak_memory = 0;
+  unsigned _num_visits = 0;
+  uint64_t _num_transfers = 0;
+  unsigned _num_sweeps = 0;
+  std::unique_ptr<LoopStats> _loop_stats;
+
+public:
+  // 由 Solver 的摘要与 IC/BC 建立各基本块的集合，所有输出集合初始化为 IC。
+  // slice 不为空时集合放在共享矩阵的指定列中，只用于稠密表示
+  SetSolver(const solver_t &solver, const BitVector &ic, const BitVector &bc,
+            const SlabSlice *slice = nullptr)
+      : _solver(solver), _sets(makeSets(solver, ic, bc, slice)) {
+    for (unsigned block = 0; block < _solver.getNumBlocks(); ++block) {
+      _sets.resetBlock(block);
+    }
+    resetMemory();
+    resetLoopStats();
+  }
+
+  virtual SetKind getSetKind() const override { return TSet::kind_c; }
+
+  virtual BitVector getInputBV(unsigned block) const override {
+    return _sets.getInputBV(block);
+  }
+
+  virtual BitVector getOutputBV(unsigned block) const override {
+    return _sets.getOutputBV(block);
+  }
+
+  virtual size_t getPeakMemory() const override { return _peak_memory; }
+  virtual unsigned getNumVisits() const override { return _num_visits; }
+  virtual uint64_t getNumTransfers() const override { return _num_transfers; }
+  virtual unsigned getNumSweeps() const override { return _num_sweeps; }
+
+  virtual void setBlock(unsigned block, const BitVector &input,
+                        const BitVector &output) override {
+    _sets.setBlock(block, input, output);
+  }
+  virtual void finishSetBlocks() override { resetMemory(); }
+
+  virtual const LoopStats *getLoopStats() const override {
+    return _loop_stats.get();
+  }
+  virtual void countIteration(unsigned component) override {
+    if (_loop_stats) {
+      ++_loop_stats->iterations[component];
+    }
+  }
+  virtual void countSweep() override { ++_num_sweeps; }
+
+  virtual void solve() override {
+    if constexpr (std::is_same<TSet, DenseSet>::value) {
+      unsigned num_slices = _solver.getNumDomainSlices();
+      if (num_slices > 1) {
+        solveSliced(num_slices);
+        return;
+      }
+    }
+    solveUnsliced();
+  }
+
+private:
+  // 切片的求解器，集合由 BlockSets::extractColumns 给出
+  SetSolver(const solver_t &solver, BlockSets<TSet> &&sets)
+      : _solver(solver), _sets(std::move(sets)) {
+    resetMemory();
+    resetLoopStats();
+  }
+
+  // 按域切片求解：GEN/KILL 问题的每一位都是独立的，把域按字均分成
+  // num_slices 片，每片复制到自己的矩阵中，在各自的线程上求解后写回。
+  // 用于单个巨大的函数，此时按函数并行（ModuleDriver）帮不上忙
+  void solveSliced(unsigned num_slices) {
+    unsigned num_words = _sets.getNumWords();
+    std::vector<std::unique_ptr<SetSolver>> slices(num_slices);
+    ThreadPool pool(hardware_concurrency(num_slices));
+    for (unsigned idx = 0; idx < num_slices; ++idx) {
+      unsigned word_begin = num_words * idx / num_slices,
+               word_end = num_words * (idx + 1) / num_slices;
+      // 每个任务只写入 slices[idx] 与自己的列，不需要加锁
+      pool.async([this, &slices, idx, word_begin, word_end]() {
+        slices[idx].reset(new SetSolver(
+            _solver, _sets.extractColumns(word_begin, word_end)));
+        slices[idx]->solveUnsliced();
+        _sets.storeColumns(slices[idx]->_sets, word_begin);
+      });
+    }
+    pool.wait();
+
+    size_t slice_memory = 0;
+    for (const std::unique_ptr<SetSolver> &slice : slices) {
+      _num_visits += slice->_num_visits;
+      _num_transfers += slice->_num_transfers;
+      // 各片同时迭代，遍数取最多的一片
+      _num_sweeps = std::max(_num_sweeps, slice->_num_sweeps);
+      slice_memory += slice->_peak_memory;
+      if (_loop_stats) {
+        for (unsigned block = 0; block < _solver.getNumBlocks(); ++block) {
+          _loop_stats->block_visits[block] +=
+              slice->_loop_stats->block_visits[block];
+        }
+        for (unsigned comp = 0; comp < _loop_stats->iterations.size();
+             ++comp) {
+          _loop_stats->iterations[comp] +=
+              slice->_loop_stats->iterations[comp];
+        }
+      }
+    }
+    if (_track_memory) {
+      _peak_memory = std::max(_peak_memory,
+                              _sets.getMemoryUsage() + slice_memory);
+    }
+  }
+
+  void solveUnsliced() {
+    _num_sweeps = 0;
+    switch (_solver.getFramework().getSolverKind()) {
+    case SolverKind::Worklist:
+      solveWorklist(nullptr);
+      break;
+    case SolverKind::RoundRobin:
+      while (traverseCFG()) {
+      }
+      break;
+    case SolverKind::SCC: {
+      // 分量的顺序与遍历顺序不一定相同，这里以再次处理本遍处理过的
+      // 基本块（回到分量的头）作为新的一遍
+      BitVector swept(_solver.getNumBlocks());
+      auto visit = [this, &swept](unsigned block) {
+        if (_num_sweeps == 0 || swept.test(block)) {
+          countSweep();
+          swept.reset();
+        }
+        swept.set(block);
+        return visitBlock(block);
+      };
+      auto on_iteration = [this](unsigned component) {
+        countIteration(component);
+      };
+      solveComponents(_solver.getCFGIndex(), visit, on_iteration);
+      break;
+    }
+    }
+  }
+
+public:
+  virtual void update(const BitVector &cone, ArrayRef<int> old_blocks,
+                      ArrayRef<int> mapping, unsigned old_size,
+                      const BitVector &fill, const BitVector &ic,
+                      const BitVector &bc) override {
+    // 已删除的基本块随旧集合一起丢弃；融合求解的集合在这里搬出共享矩阵
+    BlockSets<TSet> old_sets = std::move(_sets);
+    _sets = makeSets(_solver, ic, bc, nullptr);
+    for (unsigned block = 0; block < _solver.getNumBlocks(); ++block) {
+      if (cone.test(block) || old_blocks[block] == -1) {
+        _sets.resetBlock(block);
+      } else {
+        _sets.takeBlock(block, old_sets, old_blocks[block], mapping, old_size,
+                        fill);
+      }
+    }
+    resetMemory();
+    resetLoopStats();
+    _num_sweeps = 0;
+
+    // 按分量求解不能只从锥开始，增量更新时改用工作表
+    if (_solver.getFramework().getSolverKind() == SolverKind::RoundRobin) {
+      while (traverseCFG()) {
+      }
+    } else {
+      solveWorklist(&cone);
+    }
+  }
+
+private:
+  // 由 Solver 中的摘要建立基本块与控制流边的 GEN/KILL 集合
+  static BlockSets<TSet> makeSets(const solver_t &solver, const BitVector &ic,
+                                  const BitVector &bc,
+                                  const SlabSlice *slice) {
+    BlockSets<TSet> sets = makeEmptySets(solver, ic, bc, slice);
+    for (unsigned block = 0; block < solver.getNumBlocks(); ++block) {
+      const auto &summary = solver._bb_summaries[block];
+      sets.setGenKill(block, summary.gen, summary.kill);
+    }
+    for (unsigned edge = 0; edge < solver._edge_summaries.size(); ++edge) {
+      const auto &summary = solver._edge_summaries[edge];
+      sets.setEdge(edge, summary.gen, summary.kill);
+    }
+    return sets;
+  }
+
+  static BlockSets<TSet> makeEmptySets(const solver_t &solver,
+                                       const BitVector &ic, const BitVector &bc,
+                                       const SlabSlice *slice) {
+    if constexpr (std::is_same<TSet, DenseSet>::value) {
+      if (slice) {
+        return BlockSets<TSet>(solver.getNumBlocks(),
+                               solver._edge_summaries.size(),
+                               solver.getDomainSize(), ic, bc, *slice);
+      }
+    }
+    assert(!slice && "只有稠密表示可以放在共享矩阵中");
+    return BlockSets<TSet>(solver.getNumBlocks(), solver._edge_summaries.size(),
+                           solver.getDomainSize(), ic, bc,
+                           isSetMemoryTracked());
+  }
+
+  void resetLoopStats() {
+    if (!DFALoopStats) {
+      return;
+    }
+    _loop_stats = std::make_unique<LoopStats>();
+    _loop_stats->block_visits.assign(_solver.getNumBlocks(), 0);
+    _loop_stats->iterations.assign(
+        _solver.getComponentOrder().components.size(), 0);
+  }
+
+  void resetMemory() {
+    if (!_track_memory) {
+      return;
+    }
+    _sets.recomputeMemory();
+    _peak_memory = std::max(_peak_memory, _sets.getMemoryUsage());
+  }
+
+public:
+  // 对单个基本块做 meet 并应用 GEN/KILL 摘要，返回输出集合是否发生变化
+  virtual bool visitBlock(unsigned block) override {
+    ++_num_visits;
+    if (_loop_stats) {
+      ++_loop_stats->block_visits[block];
+    }
+    ArrayRef<int> edges = _solver.getMeetOperandEdges(block);
+    _num_transfers += 1 + countEdgeTransfers(edges);
+    bool changed = _sets.template visit<TMeet>(
+        block, _solver.getMeetOperandIndices(block), edges);
+    if (_track_memory) {
+      _peak_memory = std::max(_peak_memory, _sets.getMemoryUsage());
+    }
+    return changed;
+  }
+
+private:
+  // 入边中有调整的边数；没有边摘要的分析（大多数）不必逐条检查
+  unsigned countEdgeTransfers(ArrayRef<int> edges) const {
+    if (_solver._edge_summaries.empty()) {
+      return 0;
+    }
+    return std::count_if(edges.begin(), edges.end(),
+                         [](int edge) { return edge != -1; });
+  }
+
+  // 遍历控制流图（轮询方式，按布局顺序）
+  bool traverseCFG() {
+    countSweep();
+    bool transform = false;
+    for (unsigned block = 0; block < _solver.getNumBlocks(); ++block) {
+      transform |= visitBlock(block);
+    }
+    return transform;
+  }
+
+  // 工作表求解：初始时所有基本块（或只有 seeds 中的基本块）按遍历顺序入队，
+  // 之后只有出口集合变化的基本块才会让依赖它的基本块重新入队
+  void solveWorklist(const BitVector *seeds) {
+    ArrayRef<unsigned> order = _solver.getTraversalOrder();
+
+    // 以遍历顺序中的位置作为优先级，位置越靠前越先处理
+    std::priority_queue<unsigned, std::vector<unsigned>, std::greater<unsigned>>
+        worklist;
+    BitVector queued(order.size(), false);
+    for (unsigned pos = 0; pos < order.size(); ++pos) {
+      if (!seeds || seeds->test(order[pos])) {
+        queued[pos] = true;
+        worklist.push(pos);
+      }
+    }
+
+    // 与按分量求解相同，再次处理本遍处理过的基本块时开始新的一遍
+    BitVector swept(order.size());
+    bool first = true;
+    while (!worklist.empty()) {
+      unsigned pos = worklist.top();
+      worklist.pop();
+      queued[pos] = false;
+      if (first || swept.test(pos)) {
+        countSweep();
+        swept.reset();
+      }
+      first = false;
+      swept.set(pos);
+
+      if (!visitBlock(order[pos])) {
+        continue;
+      }
+      for (unsigned dep : _solver.getMeetDependentIndices(order[pos])) {
+        unsigned dep_pos = _solver.getTraversalPosition(dep);
+        if (!queued[dep_pos]) {
+          queued[dep_pos] = true;
+          worklist.push(dep_pos);
+        }
+      }
+    }
+  }
+};
+
+// 单个函数的求解器，持有该函数的全部求解状态（域、GEN/KILL 摘要与集合）。
+// 分析（Framework 的子类）本身不再保存任何逐函数的状态，
+// 因此同一个分析对象可以同时在多个线程上求解不同的函数。
+// 基本块集合的表示在建立域之后确定（见 SetKind），由 SetSolver 保存。
+//  @tparam TDomainElement 数据流分析的域元素类型
+//  @tparam TDirection 分析的方向（向前或向后）
+template <typename TDomainElement, Direction TDirection> class Solver {
+public:
+  typedef Framework<TDomainElement, TDirection> framework_t;
+
+private:
+  template <typename, Direction, typename, typename> friend class SetSolver;
+  template <typename...> friend class FusedSolver;
+  friend class QueryEngine<TDomainElement, TDirection>;
+
+  // 分析对象，提供 IC/BC/MeetOp/GenKill 等钩子
+  const framework_t &_framework;
+  // 被分析的函数
+  const Function &_func;
+
+  // 域集合，存储分析中的所有元素。
+  // 元素按在函数中首次出现的顺序稠密编号，下标即比特向量中的位置；
+  // _domain_index 为反向索引，二者在 solve/update 中一次性建立。
+  std::vector<TDomainElement> _domain;
+  std::unordered_map<TDomainElement, unsigned> _domain_index;
+
+  // 基本块与指令的编号及控制流图的邻接关系，融合求解时与其他分析共享
+  std::shared_ptr<const CFGIndex> _cfg;
+  // 与 CFGIndex::operands 一一对应：该控制流边的摘要在 _edge_summaries 中的
+  // 下标，边上没有调整时为 -1（由 buildSummaries 填写）
+  std::vector<int> _operand_edges;
+
+  // 基本块或控制流边的 GEN/KILL 摘要，升序的域下标。
+  // 与集合表示无关，SetSolver 据此建立自己的集合；增量更新时与新摘要比较
+  struct Summary {
+    std::vector<unsigned> gen;
+    std::vector<unsigned> kill;
+  };
+  // 按基本块号索引
+  std::vector<Summary> _bb_summaries;
+  // 只保存有调整的边，由 _operand_edges 索引
+  std::vector<Summary> _edge_summaries;
+  MeetKind _meet_kind = MeetKind::Union;
+
+  SetProfile _set_profile;
+  std::unique_ptr<SetSolverBase> _sets;
+  // 最近一次 solve 的结果从缓存读回：没有摘要、集合统计量，也没有迭代
+  bool _from_cache = false;
+
+public:
+  Solver(const framework_t &framework, const Function &func)
+      : _framework(framework), _func(func) {}
+
+  const framework_t &getFramework() const { return _framework; }
+  const Function &getFunction() const { return _func; }
+
+  // 向域中加入元素，已存在时忽略。供 InitializeDomainFromInstruction 使用
+  void addDomainElement(const TDomainElement &elem) {
+    if (_domain_index.emplace(elem, _domain.size()).second) {
+      _domain.push_back(elem);
+    }
+  }
+
+  // 获取域中元素的索引，不在域中时返回 -1。O(1)
+  int getDomainIndex(const TDomainElement &elem) const {
+    auto iter = _domain_index.find(elem);
+    if (iter == _domain_index.end())
+      return -1;
+    return iter->second;
+  }
+
+  // 根据索引获取域中的元素。O(1)
+  const TDomainElement &getDomainElement(unsigned idx) const {
+    return _domain[idx];
+  }
+
+  unsigned getDomainSize() const { return _domain.size(); }
+
+  // 基本块与指令的稠密编号（布局顺序），可以用作外部数组的下标
+  unsigned getNumBlocks() const { return _cfg->blocks.size(); }
+  const BasicBlock &getBlock(unsigned block) const {
+    return *_cfg->blocks[block];
+  }
+  unsigned getBlockIndex(const BasicBlock &bb) const {
+    auto iter = _cfg->block_index.find(&bb);
+    assert(iter != _cfg->block_index.end() && "基本块不在函数中");
+    return iter->second;
+  }
+  unsigned getNumInsts() const { return _cfg->inst_index.size(); }
+  unsigned getInstIndex(const Instruction &inst) const {
+    auto iter = _cfg->inst_index.find(&inst);
+    assert(iter != _cfg->inst_index.end() && "指令不在函数中");
+    return iter->second;
+  }
+  // 基本块的第一条指令（布局顺序）的指令号
+  unsigned getFirstInstIndex(unsigned block) const {
+    return _cfg->inst_begin[block];
+  }
+
+  // 以基本块号表示的 meet 操作数、依赖者与工作表处理顺序
+  ArrayRef<unsigned> getMeetOperandIndices(unsigned block) const {
+    return ArrayRef<unsigned>(_cfg->operands).slice(
+        _cfg->operand_begin[block],
+        _cfg->operand_begin[block + 1] - _cfg->operand_begin[block]);
+  }
+  ArrayRef<int> getMeetOperandEdges(unsigned block) const {
+    return ArrayRef<int>(_operand_edges)
+        .slice(_cfg->operand_begin[block],
+               _cfg->operand_begin[block + 1] - _cfg->operand_begin[block]);
+  }
+  ArrayRef<unsigned> getMeetDependentIndices(unsigned block) const {
+    return ArrayRef<unsigned>(_cfg->dependents)
+        .slice(_cfg->dependent_begin[block],
+               _cfg->dependent_begin[block + 1] - _cfg->dependent_begin[block]);
+  }
+  ArrayRef<unsigned> getTraversalOrder() const { return _cfg->order; }
+  unsigned getTraversalPosition(unsigned block) const {
+    return _cfg->order_pos[block];
+  }
+  const CFGIndex &getCFGIndex() const { return *_cfg; }
+  // 依赖图的嵌套强连通分量，只在 SolverKind::SCC 或 -dfa-loop-stats 下建立
+  const ComponentOrder &getComponentOrder() const { return _cfg->components; }
+
+  MeetKind getMeetKind() const { return _meet_kind; }
+
+  // 按域切片求解时的实际片数：每片至少 kMinSliceWords 个字，否则线程的
+  // 开销会超过收益；不切片或在按函数并行的任务中求解时为 1
+  static constexpr unsigned kMinSliceWords = 8;
+  unsigned getNumDomainSlices() const {
+    if (ModuleTaskScope::isActive()) {
+      return 1;
+    }
+    unsigned slices = _framework.getDomainSlices();
+    if (slices == 0) {
+      slices = hardware_concurrency().compute_thread_count();
+    }
+    unsigned num_words =
+        (getDomainSize() + SetMatrix::kWordBits - 1) / SetMatrix::kWordBits;
+    return std::max(1u, std::min(slices, num_words / kMinSliceWords));
+  }
+
+  // 实际使用的集合表示、选择时使用的统计量以及集合内存的峰值
+  SetKind getSetKind() const { return _sets->getSetKind(); }
+  const SetProfile &getSetProfile() const { return _set_profile; }
+  size_t getPeakMemory() const { return _sets->getPeakMemory(); }
+  // 累计处理基本块的次数，可用于比较增量更新与重新求解的工作量
+  unsigned getNumVisits() const { return _sets->getNumVisits(); }
+  // 累计调用块与边的传递函数的次数，以及最近一次求解或增量更新的遍数
+  uint64_t getNumTransfers() const { return _sets->getNumTransfers(); }
+  unsigned getNumSweeps() const { return _sets->getNumSweeps(); }
+
+  // 基本块在遍历方向上的输出集合：前向分析为 OUT[B]，后向分析为 IN[B]
+  BitVector getOutputBV(const BasicBlock &bb) const {
+    return _sets->getOutputBV(getBlockIndex(bb));
+  }
+
+  // 基本块在遍历方向上的输入集合：前向分析为 IN[B]，后向分析为 OUT[B]
+  BitVector getInputBV(const BasicBlock &bb) const {
+    return _sets->getInputBV(getBlockIndex(bb));
+  }
+
+  // 单条指令的传递函数：bv = gen ∪ (bv - kill)。
+  // 只按 GEN/KILL 中的下标逐位修改，代价与 GEN/KILL 的大小成正比。
+  void TransferFunc(const Instruction &inst, BitVector &bv) const {
+    SmallVector<unsigned, 4> gen, kill;
+    _framework.GenKill(*this, inst, gen, kill);
+    for (unsigned idx : kill) {
+      bv.reset(idx);
+    }
+    for (unsigned idx : gen) {
+      bv.set(idx);
+    }
+  }
+
+  // 按需计算单条指令的集合（遍历方向上该指令之后的集合），
+  // 从所在基本块的输入集合开始重放块内的传递函数
+  BitVector getInstBV(const Instruction &inst) const {
+    const BasicBlock &bb = *inst.getParent();
+    BitVector bv = getInputBV(bb);
+    for (const Instruction &curr : InstTraversalOrder(bb)) {
+      TransferFunc(curr, bv);
+      if (&curr == &inst) {
+        break;
+      }
+    }
+    return bv;
+  }
+
+  // 把所有指令的集合（含义同 getInstBV）物化为一个行优先矩阵，
+  // 第 i 行为指令号 i 的集合。每个基本块只重放一次传递函数，
+  // 适合需要反复查询逐条指令结果的使用者
+  SetMatrix getInstSetMatrix() const {
+    SetMatrix matrix(getNumInsts(), getDomainSize());
+    for (unsigned block = 0; block < getNumBlocks(); ++block) {
+      const BasicBlock &bb = getBlock(block);
+      BitVector bv = _sets->getInputBV(block);
+      for (const Instruction &inst : InstTraversalOrder(bb)) {
+        TransferFunc(inst, bv);
+        matrix.setRow(getInstIndex(inst), bv);
+      }
+    }
+    return matrix;
+  }
 
 private:
   // 打印带有掩码的域集合
-  void printDomainWithMask(const BitVector &mask) const {
-    outs() << "{";
+  void printDomainWithMask(raw_ostream &OS, const BitVector &mask) const {
+    OS << "{";
     assert(mask.size() == _domain.size() &&
            "掩码大小必须等于域的大小");
-    unsigned mask_idx = 0;
-    for (const auto &elem : _domain) {
-      if (!mask[mask_idx++]) {
-        continue;
-      }
-      outs() << elem << ",";
+    for (unsigned mask_idx : mask.set_bits()) {
+      OS << _domain[mask_idx] << ",";
     }
-    outs() << "}";
+    OS << "}";
   }
 
   // 打印与指令相关的比特向量
-  void printInstBV(const Instruction &inst) const {
+  void printInstBV(raw_ostream &OS, const Instruction &inst,
+                   const BitVector &bv, const BitVector &input) const {
     const BasicBlock *const pbb = inst.getParent();
     if (&inst == &(*InstTraversalOrder(*pbb).begin())) {
       auto meet_operands = MeetOperands(*pbb);
       if (meet_operands.begin() == meet_operands.end()) {
-        outs() << "BC:\t";
-        printDomainWithMask(BC());
+        OS << "BC:\t";
       } else {
-        outs() << "MeetOp:\t";
-        printDomainWithMask(MeetOp(*pbb));
+        OS << "MeetOp:\t";
       }
-      outs() << "\n";
+      printDomainWithMask(OS, input);
+      OS << "\n";
     }
-    outs() << "Instruction: " << inst << "\n";
-    outs() << "\t";
-    printDomainWithMask(_inst_bv_map.at(&inst));
-    outs() << "\n";
+    OS << "Instruction: " << inst << "\n";
+    OS << "\t";
+    printDomainWithMask(OS, bv);
+    OS << "\n";
   }
 
-protected:
-  // 打印函数中指令和比特向量的映射
-  void printInstBVMap(const Function &F) const {
-    outs() << "***********************************\n";
-    outs() << "* Instruction-BitVector Mapping    \n";
-    outs() << "***********************************\n";
-    for (const auto &inst : instructions(F)) {
-      printInstBV(inst);
+public:
+  // 打印函数中指令和比特向量的映射。每个基本块只重放一次传递函数。
+  void printInstBVMap(raw_ostream &OS = outs()) const {
+    OS << "***********************************\n";
+    OS << "* Instruction-BitVector Mapping    \n";
+    OS << "***********************************\n";
+    // 块内各指令的集合，按指令号减去块内第一条指令的指令号索引
+    std::vector<BitVector> inst_bvs;
+    for (unsigned block = 0; block < getNumBlocks(); ++block) {
+      const BasicBlock &bb = getBlock(block);
+      unsigned first = getFirstInstIndex(block);
+      inst_bvs.resize(bb.size());
+      BitVector input = _sets->getInputBV(block);
+      BitVector bv = input;
+      for (const Instruction &inst : InstTraversalOrder(bb)) {
+        TransferFunc(inst, bv);
+        inst_bvs[getInstIndex(inst) - first] = bv;
+      }
+      unsigned offset = 0;
+      for (const Instruction &inst : bb) {
+        printInstBV(OS, inst, inst_bvs[offset++], input);
+      }
+    }
+  }
+
+  // 按 format 输出结果，PrintFormat::None 时什么也不输出
+  void print(raw_ostream &OS, PrintFormat format) const {
+    switch (format) {
+    case PrintFormat::None:
+      break;
+    case PrintFormat::Text:
+      printInstBVMap(OS);
+      break;
+    case PrintFormat::Summary:
+      printSummary(OS);
+      break;
+    case PrintFormat::JSONLines:
+      writeJSONLines(OS);
+      break;
+    case PrintFormat::Binary:
+      writeBinary(OS);
+      break;
+    }
+  }
+
+  // 只输出每个基本块 IN/OUT 集合的大小
+  void printSummary(raw_ostream &OS) const {
+    OS << "function '" << _func.getName() << "': domain " << _domain.size()
+       << ", " << _func.size() << " blocks\n";
+    unsigned block_id = 0;
+    for (const BasicBlock &bb : _func) {
+      BitVector in, out;
+      getBlockINOUT(bb, in, out);
+      OS << "  bb" << block_id++;
+      if (bb.hasName()) {
+        OS << " (" << bb.getName() << ")";
+      }
+      OS << ": in " << in.count() << ", out " << out.count() << "\n";
+    }
+  }
+
+  // JSON Lines 格式，依次为：
+  //   {"function":..,"direction":..,"domain_size":D,"blocks":B,"word_bits":64}
+  //   {"domain":[元素的文本, ...]}
+  //   每个基本块 {"block":块号,"name":..,"in":[字],"out":[字]}，随后是块内
+  //   各指令（按遍历方向）{"inst":指令号,"block":块号,"set":[字]}
+  // 块号与指令号为在函数中的布局顺序；集合的第 i 位在第 i / 64 个字的
+  // 第 i % 64 位（字为 BitVector 的存储字，word_bits 给出其位数）
+  void writeJSONLines(raw_ostream &OS) const {
+    OS << "{\"function\":";
+    writeJSONString(OS, _func.getName());
+    OS << ",\"direction\":\""
+       << (TDirection == Direction::Forward ? "forward" : "backward")
+       << "\",\"domain_size\":" << _domain.size()
+       << ",\"blocks\":" << _func.size()
+       << ",\"word_bits\":" << sizeof(word_t) * 8 << "}\n";
+    OS << "{\"domain\":[";
+    std::string str;
+    for (unsigned idx = 0; idx < _domain.size(); ++idx) {
+      str.clear();
+      raw_string_ostream elem_os(str);
+      elem_os << _domain[idx];
+      elem_os.flush();
+      if (idx != 0) {
+        OS << ",";
+      }
+      writeJSONString(OS, str);
+    }
+    OS << "]}\n";
+
+    auto writeWords = [&OS](const BitVector &bv) {
+      OS << "[";
+      ArrayRef<word_t> words = bv.getData();
+      for (unsigned idx = 0; idx < words.size(); ++idx) {
+        if (idx != 0) {
+          OS << ",";
+        }
+        OS << static_cast<uint64_t>(words[idx]);
+      }
+      OS << "]";
+    };
+    forEachBlock([&](unsigned block_id, const BasicBlock &bb,
+                     const BitVector &in, const BitVector &out) {
+      OS << "{\"block\":" << block_id;
+      if (bb.hasName()) {
+        OS << ",\"name\":";
+        writeJSONString(OS, bb.getName());
+      }
+      OS << ",\"in\":";
+      writeWords(in);
+      OS << ",\"out\":";
+      writeWords(out);
+      OS << "}\n";
+    }, [&](unsigned inst_id, unsigned block_id, const BitVector &bv) {
+      OS << "{\"inst\":" << inst_id << ",\"block\":" << block_id
+         << ",\"set\":";
+      writeWords(bv);
+      OS << "}\n";
+    });
+  }
+
+  // 二进制格式，所有整数均为小端序，每个集合为 W 个 u64
+  // （W = ceil(域大小 / word_bits)，位的排列与 JSON Lines 相同）：
+  //   函数:   u32 'F', u32 名字长度, 名字, u32 方向（0 前向，1 后向）,
+  //           u32 域大小, u32 基本块数, u32 word_bits, u32 W,
+  //           域中每个元素: u32 文本长度, 文本
+  //   基本块: u32 'B', u32 块号, IN, OUT
+  //   指令:   u32 'I', u32 指令号, u32 块号, 集合
+  // 文件以魔数 "DFA1" 开头（由 Output 写入）
+  void writeBinary(raw_ostream &OS) const {
+    unsigned num_words = BitVector(_domain.size()).getData().size();
+    writeLE(OS, 'F', 4);
+    writeLE(OS, _func.getName().size(), 4);
+    OS << _func.getName();
+    writeLE(OS, TDirection == Direction::Forward ? 0 : 1, 4);
+    writeLE(OS, _domain.size(), 4);
+    writeLE(OS, _func.size(), 4);
+    writeLE(OS, sizeof(word_t) * 8, 4);
+    writeLE(OS, num_words, 4);
+    std::string str;
+    for (const TDomainElement &elem : _domain) {
+      str.clear();
+      raw_string_ostream elem_os(str);
+      elem_os << elem;
+      elem_os.flush();
+      writeLE(OS, str.size(), 4);
+      OS << str;
+    }
+
+    auto writeWords = [&OS](const BitVector &bv) {
+      for (word_t word : bv.getData()) {
+        writeLE(OS, word, 8);
+      }
+    };
+    forEachBlock([&](unsigned block_id, const BasicBlock &,
+                     const BitVector &in, const BitVector &out) {
+      writeLE(OS, 'B', 4);
+      writeLE(OS, block_id, 4);
+      writeWords(in);
+      writeWords(out);
+    }, [&](unsigned inst_id, unsigned block_id, const BitVector &bv) {
+      writeLE(OS, 'I', 4);
+      writeLE(OS, inst_id, 4);
+      writeLE(OS, block_id, 4);
+      writeWords(bv);
+    });
+  }
+
+private:
+  // 基本块的 IN/OUT 集合（与分析方向无关的含义）
+  void getBlockINOUT(const BasicBlock &bb, BitVector &in,
+                     BitVector &out) const {
+    if (TDirection == Direction::Forward) {
+      in = getInputBV(bb);
+      out = getOutputBV(bb);
+    } else {
+      in = getOutputBV(bb);
+      out = getInputBV(bb);
+    }
+  }
+
+  // 按布局顺序遍历基本块，对每个基本块调用 block_fn，再按遍历方向重放
+  // 块内的传递函数，对每条指令调用 inst_fn。每次只保存一个集合，
+  // 因此可以边计算边输出
+  template <typename TBlockFn, typename TInstFn>
+  void forEachBlock(TBlockFn block_fn, TInstFn inst_fn) const {
+    for (unsigned block = 0; block < getNumBlocks(); ++block) {
+      const BasicBlock &bb = getBlock(block);
+      BitVector in, out;
+      getBlockINOUT(bb, in, out);
+      block_fn(block, bb, in, out);
+
+      BitVector bv = _sets->getInputBV(block);
+      for (const Instruction &inst : InstTraversalOrder(bb)) {
+        TransferFunc(inst, bv);
+        inst_fn(getInstIndex(inst), block, bv);
+      }
     }
   }
 
+public:
   // 遇见操作符和传递函数的定义
   // 根据分析方向启用不同的方法
-  METHOD_ENABLE_IF_DIRECTION(Direction::Forward, pred_const_range)
+  METHOD_ENABLE_IF_DIRECTION(Direction::Forward, const_pred_range)
   MeetOperands(const BasicBlock &bb) const { return predecessors(&bb); }
 
-  METHOD_ENABLE_IF_DIRECTION(Direction::Backward, succ_const_range)
+  METHOD_ENABLE_IF_DIRECTION(Direction::Backward, const_succ_range)
   MeetOperands(const BasicBlock &bb) const { return successors(&bb); }
 
-  // 遇见操作的虚函数，由子类实现
-  virtual BitVector MeetOp(const BasicBlock &bb) const = 0;
+  // 基本块的出口集合变化后需要重新计算的基本块
+  METHOD_ENABLE_IF_DIRECTION(Direction::Forward, const_succ_range)
+  MeetDependents(const BasicBlock &bb) const { return successors(&bb); }
 
-  // 传递函数的虚函数，由子类实现
-  virtual bool TransferFunc(const Instruction &inst, const BitVector &ibv,
-                            BitVector &obv) = 0;
+  METHOD_ENABLE_IF_DIRECTION(Direction::Backward, const_pred_range)
+  MeetDependents(const BasicBlock &bb) const { return predecessors(&bb); }
 
-private:
-  // 根据分析方向定义基本块和指令的遍历顺序
-  METHOD_ENABLE_IF_DIRECTION(Direction::Forward, iterator_range<SymbolTableList<BasicBlock>::const_iterator>)
-  BBTraversalOrder(const Function &F) const {
-    return make_range(F.begin(), F.end());
-  }
-
-  METHOD_ENABLE_IF_DIRECTION(Direction::Forward, iterator_range<SymbolTableList<Instruction>::const_iterator>)
+  // 根据分析方向定义指令的遍历顺序
+  METHOD_ENABLE_IF_DIRECTION(Direction::Forward, iterator_range<BasicBlock::const_iterator>)
   InstTraversalOrder(const BasicBlock &bb) const {
     return make_range(bb.begin(), bb.end());
   }
 
-  METHOD_ENABLE_IF_DIRECTION(Direction::Backward, iterator_range<SymbolTableList<Instruction>::const_reverse_iterator>)
+  METHOD_ENABLE_IF_DIRECTION(Direction::Backward, iterator_range<BasicBlock::const_reverse_iterator>)
   InstTraversalOrder(const BasicBlock &bb) const {
-    return make_range(bb.getInstList().rbegin(), bb.getInstList().rend());
+    return make_range(bb.rbegin(), bb.rend());
   }
 
-protected:
-  // 获取域中元素的索引
-  int getDomainIndex(const TDomainElement &elem) const {
-    auto inst_dom_iter = _domain.find(elem);
-    if (inst_dom_iter == _domain.end())
-      return -1;
-    int idx = 0;
-    for (auto dom_iter = _domain.begin(); inst_dom_iter != dom_iter; ++dom_iter)
-      ++idx;
-    return idx;
+  // 按遍历顺序复合块内各指令的 GEN/KILL，得到基本块的摘要（升序的域下标）：
+  //   GEN_B = gen_n ∪ (... (gen_1 - kill_2) ... - kill_n)
+  //   KILL_B = kill_1 ∪ ... ∪ kill_n
+  // 只记录每个元素最后一次出现时是 gen 还是 kill，代价与 GEN/KILL 的总大小成正比。
+  // gen_kill(inst, gen, kill) 给出单条指令的 GEN/KILL，见 Framework::BlockGenKill
+  template <typename TGenKill>
+  void composeGenKill(const BasicBlock &bb, TGenKill gen_kill,
+                      std::vector<unsigned> &gen,
+                      std::vector<unsigned> &kill) const {
+    SmallDenseMap<unsigned, bool, 16> last_is_gen;
+    SmallVector<unsigned, 4> inst_gen, inst_kill;
+    for (const Instruction &inst : InstTraversalOrder(bb)) {
+      inst_gen.clear();
+      inst_kill.clear();
+      gen_kill(inst, inst_gen, inst_kill);
+      for (unsigned idx : inst_kill) {
+        last_is_gen[idx] = false;
+        kill.push_back(idx);
+      }
+      for (unsigned idx : inst_gen) {
+        last_is_gen[idx] = true;
+      }
+    }
+    for (const auto &entry : last_is_gen) {
+      if (entry.second) {
+        gen.push_back(entry.first);
+      }
+    }
+    sortUnique(gen);
+    sortUnique(kill);
   }
 
-  // 遍历控制流图
-  bool traverseCFG(const Function &func) {
-    bool transform = false;
-    for (const BasicBlock &basicBlock : BBTraversalOrder(func)) {
-      BitVector ibv;
-      if (&basicBlock == &(*BBTraversalOrder(func).begin()))
-        ibv = BC();
-      else
-        ibv = MeetOp(basicBlock);
-      for (const Instruction &inst : InstTraversalOrder(basicBlock)) {
-        transform |= TransferFunc(inst, ibv, _inst_bv_map[&inst]);
-        ibv = _inst_bv_map[&inst];
+private:
+
+  static void sortUnique(std::vector<unsigned> &indices) {
+    std::sort(indices.begin(), indices.end());
+    indices.erase(std::unique(indices.begin(), indices.end()), indices.end());
+  }
+
+  // 按在函数中首次出现的顺序建立域。融合求解时按基本块交替调用各个分析的
+  // buildDomain(block)，每个基本块只遍历一次
+  void buildDomain() {
+    clearDomain();
+    for (unsigned block = 0; block < getNumBlocks(); ++block) {
+      buildDomain(block);
+    }
+  }
+
+  void clearDomain() {
+    _domain.clear();
+    _domain_index.clear();
+  }
+
+  void buildDomain(unsigned block) {
+    _framework.InitializeDomainFromBlock(*this, getBlock(block));
+  }
+
+  // 计算所有基本块与控制流边的 GEN/KILL 摘要，必须在域建立之后。
+  // 融合求解时与 buildDomain 一样按基本块交替调用各个分析
+  void buildSummaries() {
+    clearSummaries();
+    for (unsigned block = 0; block < getNumBlocks(); ++block) {
+      buildSummaries(block);
+    }
+  }
+
+  void clearSummaries() {
+    _meet_kind = _framework.MeetOp();
+    _bb_summaries.assign(getNumBlocks(), Summary());
+    _edge_summaries.clear();
+    _operand_edges.assign(_cfg->operands.size(), -1);
+  }
+
+  void buildSummaries(unsigned block) {
+    const BasicBlock &bb = getBlock(block);
+    Summary &bb_summary = _bb_summaries[block];
+    _framework.BlockGenKill(*this, bb, bb_summary.gen, bb_summary.kill);
+    SmallVector<unsigned, 4> edge_gen, edge_kill;
+    for (unsigned slot = _cfg->operand_begin[block];
+         slot < _cfg->operand_begin[block + 1]; ++slot) {
+      edge_gen.clear();
+      edge_kill.clear();
+      _framework.EdgeGenKill(*this, getBlock(_cfg->operands[slot]), bb,
+                             edge_gen, edge_kill);
+      if (edge_gen.empty() && edge_kill.empty()) {
+        continue;
       }
+      _operand_edges[slot] = _edge_summaries.size();
+      _edge_summaries.emplace_back();
+      Summary &summary = _edge_summaries.back();
+      summary.gen.assign(edge_gen.begin(), edge_gen.end());
+      summary.kill.assign(edge_kill.begin(), edge_kill.end());
+      sortUnique(summary.gen);
+      sortUnique(summary.kill);
     }
-    return transform;
+  }
+
+  // 旧摘要按 mapping 映射到新域后是否与新摘要相同
+  static bool sameList(const std::vector<unsigned> &old_list,
+                       const std::vector<unsigned> &new_list,
+                       ArrayRef<int> mapping) {
+    if (old_list.size() != new_list.size()) {
+      return false;
+    }
+    if (mapping.empty()) {
+      return old_list == new_list;
+    }
+    std::vector<unsigned> mapped;
+    mapped.reserve(old_list.size());
+    for (unsigned idx : old_list) {
+      if (mapping[idx] == -1) {
+        return false;
+      }
+      mapped.push_back(mapping[idx]);
+    }
+    std::sort(mapped.begin(), mapped.end());
+    return mapped == new_list;
+  }
+
+  static bool sameSummary(const Summary &old_summary,
+                          const Summary &new_summary, ArrayRef<int> mapping) {
+    return sameList(old_summary.gen, new_summary.gen, mapping) &&
+           sameList(old_summary.kill, new_summary.kill, mapping);
+  }
+
+  // 基本块的 meet 操作数以及各操作数所在边上的调整是否与旧的相同
+  bool sameOperands(const CFGIndex &old_cfg, ArrayRef<int> old_operand_edges,
+                    unsigned old_block, unsigned block,
+                    const std::vector<Summary> &old_edge_summaries,
+                    ArrayRef<int> mapping) const {
+    unsigned old_begin = old_cfg.operand_begin[old_block];
+    unsigned begin = _cfg->operand_begin[block];
+    unsigned size = _cfg->operand_begin[block + 1] - begin;
+    if (old_cfg.operand_begin[old_block + 1] - old_begin != size) {
+      return false;
+    }
+    for (unsigned k = 0; k < size; ++k) {
+      if (old_cfg.blocks[old_cfg.operands[old_begin + k]] !=
+          _cfg->blocks[_cfg->operands[begin + k]]) {
+        return false;
+      }
+      int old_edge = old_operand_edges[old_begin + k];
+      int edge = _operand_edges[begin + k];
+      if ((old_edge == -1) != (edge == -1)) {
+        return false;
+      }
+      if (edge != -1 && !sameSummary(old_edge_summaries[old_edge],
+                                     _edge_summaries[edge], mapping)) {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  // 把升序下标列表计入聚集程度的统计：元素数、非空 128 位段数、非空块数
+  static void countClusters(const std::vector<unsigned> &indices,
+                            uint64_t &elems, uint64_t &segments,
+                            uint64_t &chunks) {
+    unsigned last_segment = ~0u, last_chunk = ~0u;
+    for (unsigned idx : indices) {
+      if (idx / SparseSet::kElementBits != last_segment) {
+        last_segment = idx / SparseSet::kElementBits;
+        ++segments;
+      }
+      if (idx >> ChunkedSet::kChunkBits != last_chunk) {
+        last_chunk = idx >> ChunkedSet::kChunkBits;
+        ++chunks;
+      }
+    }
+    elems += indices.size();
+  }
+
+  // 估计集合的大小与聚集程度：集合至少与 IC、BC 一样大，
+  // 也至少与各基本块的 GEN ∪ KILL 的平均大小一样大
+  SetProfile makeSetProfile(const BitVector &ic, const BitVector &bc) const {
+    SetProfile profile;
+    profile.domain_size = _domain.size();
+    profile.num_sets = _func.size();
+
+    uint64_t elems = 0, segments = 0, chunks = 0;
+    std::vector<unsigned> indices;
+    for (const Summary &summary : _bb_summaries) {
+      indices.clear();
+      std::set_union(summary.gen.begin(), summary.gen.end(),
+                     summary.kill.begin(), summary.kill.end(),
+                     std::back_inserter(indices));
+      countClusters(indices, elems, segments, chunks);
+    }
+    double mean = _func.empty() ? 0.0 : double(elems) / _func.size();
+    for (const BitVector *bv : {&ic, &bc}) {
+      indices.clear();
+      for (unsigned idx : bv->set_bits()) {
+        indices.push_back(idx);
+      }
+      countClusters(indices, elems, segments, chunks);
+      mean = std::max(mean, double(indices.size()));
+    }
+    profile.elems_per_set = mean;
+    if (segments != 0) {
+      profile.elems_per_segment = double(elems) / segments;
+      profile.elems_per_chunk = double(elems) / chunks;
+    }
+    return profile;
+  }
+
+  // 由摘要与 IC/BC 的统计确定集合表示，-dfa-set=auto 时逐函数选择
+  SetKind selectSetKind(const BitVector &ic, const BitVector &bc) {
+    _set_profile = makeSetProfile(ic, bc);
+    SetKind kind = _framework.getSetKind();
+    if (kind == SetKind::Auto) {
+      kind = chooseSetKind(_set_profile);
+    }
+    return kind;
+  }
+
+  // 集合表示与 meet 运算在这里一次性确定，此后的迭代中都是编译期常量。
+  // slice 不为空时稠密集合放在共享矩阵的指定列中（见 FusedSolver）
+  std::unique_ptr<SetSolverBase>
+  createSetSolver(SetKind kind, const BitVector &ic, const BitVector &bc,
+                  const SlabSlice *slice = nullptr) const {
+    if (_meet_kind == MeetKind::Union) {
+      return createSetSolver<UnionMeet>(kind, ic, bc, slice);
+    }
+    return createSetSolver<IntersectMeet>(kind, ic, bc, slice);
+  }
+
+  template <typename TMeet>
+  std::unique_ptr<SetSolverBase>
+  createSetSolver(SetKind kind, const BitVector &ic, const BitVector &bc,
+                  const SlabSlice *slice) const {
+    switch (kind) {
+    case SetKind::Sparse:
+      return std::make_unique<
+          SetSolver<TDomainElement, TDirection, SparseSet, TMeet>>(*this, ic,
+                                                                   bc, slice);
+    case SetKind::Chunked:
+      return std::make_unique<
+          SetSolver<TDomainElement, TDirection, ChunkedSet, TMeet>>(
+          *this, ic, bc, slice);
+    case SetKind::Auto:
+    case SetKind::Dense:
+      break;
+    }
+    return std::make_unique<
+        SetSolver<TDomainElement, TDirection, DenseSet, TMeet>>(*this, ic, bc,
+                                                                slice);
+  }
+
+  // -dfa-set-stats：输出各表示的估计内存、实际选择与实际峰值。结果从缓存
+  // 读回时没有估计所需的统计量，只输出实际的表示与读回后的内存
+  void printSetStats(raw_ostream &OS) const {
+    if (_from_cache) {
+      OS << "dfa-set: function '" << _func.getName() << "': domain "
+         << getDomainSize() << ", " << getNumBlocks()
+         << " blocks, loaded from cache; using " << getSetKindName(getSetKind())
+         << ", peak " << getPeakMemory() << " bytes\n";
+      return;
+    }
+    OS << "dfa-set: function '" << _func.getName() << "': domain "
+       << _set_profile.domain_size << ", " << _set_profile.num_sets
+       << " blocks, ~" << format("%.1f", _set_profile.elems_per_set)
+       << " elements/set; estimated bytes/set:";
+    for (SetKind kind : {SetKind::Dense, SetKind::Sparse, SetKind::Chunked}) {
+      OS << " " << getSetKindName(kind) << " "
+         << estimateSetMemory(kind, _set_profile);
+    }
+    OS << "; using " << getSetKindName(getSetKind()) << ", peak "
+       << getPeakMemory() << " bytes\n";
+  }
+
+  // -dfa-loop-stats：按嵌套关系输出每个分量（循环）的头、深度、基本块数与
+  // 其中基本块被处理的总次数（含内层分量），按分量求解时还有迭代的遍数。
+  // 结果从缓存读回时没有迭代，处理次数与遍数均为 0
+  void printLoopStats(raw_ostream &OS) const {
+    const LoopStats &stats = *_sets->getLoopStats();
+    const ComponentOrder &order = getComponentOrder();
+    std::vector<unsigned> num_blocks(order.components.size(), 0);
+    std::vector<uint64_t> visits(order.components.size(), 0);
+    uint64_t total_visits = 0;
+    for (unsigned block = 0; block < getNumBlocks(); ++block) {
+      total_visits += stats.block_visits[block];
+      for (int comp = order.block_component[block]; comp != -1;
+           comp = order.components[comp].parent) {
+        ++num_blocks[comp];
+        visits[comp] += stats.block_visits[block];
+      }
+    }
+    bool by_component = _framework.getSolverKind() == SolverKind::SCC;
+    OS << "dfa-loops: function '" << _func.getName() << "': "
+       << getNumBlocks() << " blocks, " << order.components.size()
+       << " loops, " << total_visits << " visits"
+       << (_from_cache ? ", loaded from cache" : "") << "\n";
+    // 按嵌套关系先序输出
+    SmallVector<int, 16> stack(order.top.rbegin(), order.top.rend());
+    while (!stack.empty()) {
+      int item = stack.pop_back_val();
+      if (item >= 0) {
+        continue;
+      }
+      unsigned comp = ~item;
+      const ComponentOrder::Component &component = order.components[comp];
+      const BasicBlock &head = getBlock(component.head);
+      OS.indent(2 * component.depth) << "loop at bb" << component.head;
+      if (head.hasName()) {
+        OS << " (" << head.getName() << ")";
+      }
+      OS << ": depth " << component.depth << ", " << num_blocks[comp]
+         << " blocks, " << visits[comp] << " visits";
+      if (by_component) {
+        OS << ", " << stats.iterations[comp] << " iterations";
+      }
+      OS << "\n";
+      stack.append(component.body.rbegin(), component.body.rend());
+    }
+  }
+
+  // 从缓存读回各基本块的集合。摘要留空，之后的 update 会把所有基本块
+  // 视为修改过而整体重新迭代
+  bool loadFromCache(StringRef path) {
+    CachedSets cached;
+    if (!loadCachedSets(path, getNumBlocks(), getDomainSize(), cached)) {
+      return false;
+    }
+    clearSummaries();
+    BitVector ic = _framework.IC(*this), bc = _framework.BC(*this);
+    SetKind kind = _framework.getSetKind();
+    if (kind == SetKind::Auto) {
+      kind = cached.set_kind;
+    }
+    _sets = createSetSolver(kind, ic, bc);
+    for (unsigned block = 0; block < getNumBlocks(); ++block) {
+      _sets->setBlock(block, cached.inputs[block], cached.outputs[block]);
+    }
+    _sets->finishSetBlocks();
+    _from_cache = true;
+    return true;
+  }
+
+  void storeToCache(StringRef path) const {
+    CachedSets cached;
+    cached.set_kind = _sets->getSetKind();
+    cached.inputs.reserve(getNumBlocks());
+    cached.outputs.reserve(getNumBlocks());
+    for (unsigned block = 0; block < getNumBlocks(); ++block) {
+      cached.inputs.push_back(_sets->getInputBV(block));
+      cached.outputs.push_back(_sets->getOutputBV(block));
+    }
+    storeCachedSets(path, cached);
+  }
+
+  // 把这次求解的代价交给 recordSolveStats（见 cscd70/stats.h）。
+  // start 为开始时间，没有测量时间时为零；cached 表示结果从缓存读回
+  void recordStats(const TimeRecord &start, bool cached) const {
+    SolveStats stats;
+    stats.num_blocks = getNumBlocks();
+    stats.num_insts = getNumInsts();
+    stats.domain_size = getDomainSize();
+    stats.set_kind = getSetKind();
+    stats.solver_kind = _framework.getSolverKind();
+    stats.cached = cached;
+    stats.visits = getNumVisits();
+    // 建立摘要时每条指令调用一次传递函数
+    stats.transfers = getNumTransfers() + (cached ? 0 : getNumInsts());
+    stats.sweeps = getNumSweeps();
+    stats.peak_memory = getPeakMemory();
+    if (isSolveTimed()) {
+      stats.time = TimeRecord::getCurrentTime(false);
+      stats.time -= start;
+    }
+    recordSolveStats(_func, _framework.getName(), stats);
+  }
+
+  // 是否需要建立 ComponentOrder
+  bool needComponentOrder() const {
+    return _framework.getSolverKind() == SolverKind::SCC || DFALoopStats;
+  }
+
+public:
+  // 只建立编号与域，不计算摘要也不求解。按需查询（见 cscd70/query.h）
+  // 只需要这一步，摘要由查询引擎在搜索到的基本块上按需计算
+  void prepareDomain() {
+    _cfg = CFGIndex::build(_func, TDirection, needComponentOrder());
+    buildDomain();
+  }
+
+  // 在函数上求解数据流分析：建立域与 GEN/KILL 摘要，选择集合表示，
+  // 然后迭代到不动点。设置了 -dfa-cache-dir 时先查找缓存，命中时直接
+  // 读回各基本块的集合，不计算摘要也不迭代；未命中时求解后写入缓存。
+  // -dfa-set-stats 与 -dfa-loop-stats 在两种情况下都输出
+  void solve() {
+    TimeRecord start;
+    if (isSolveTimed()) {
+      start = TimeRecord::getCurrentTime(true);
+    }
+    prepareDomain();
+    _from_cache = false;
+    std::string cache_path = getCachePath(
+        _func, _framework.getCacheName(), _framework.getCacheVersion());
+    if (!cache_path.empty() && loadFromCache(cache_path)) {
+      recordStats(start, true);
+    } else {
+      buildSummaries();
+
+      BitVector ic = _framework.IC(*this), bc = _framework.BC(*this);
+      _sets = createSetSolver(selectSetKind(ic, bc), ic, bc);
+      _sets->solve();
+      if (!cache_path.empty()) {
+        storeToCache(cache_path);
+      }
+      recordStats(start, false);
+    }
+    if (DFASetStats) {
+      printSetStats(errs());
+    }
+    if (DFALoopStats) {
+      printLoopStats(errs());
+    }
+  }
+
+  // IR 修改之后增量地重新求解，结果与重新调用 solve 相同。
+  //  @param insts  被修改或新插入的指令（仍在函数中）
+  //  @param blocks 删除过指令、修改过终结指令或新插入的基本块；
+  //                已经删除的基本块也可以传入，会被忽略
+  // 域与 GEN/KILL 摘要按当前的 IR 重新建立（与指令数成线性），摘要或
+  // meet 操作数发生变化的基本块也计入修改，因此调用者不需要追踪非局部的
+  // 影响（例如新的使用者改变了另一个基本块的 KILL）。修改的基本块及其在
+  // 遍历方向上可达的基本块（受影响的锥）重置为 IC 后重新迭代，其余基本块
+  // 保留原来的结果。如果新加入域的元素在 IC 与 BC 中取值不同，无法确定
+  // 它们在锥外的取值，此时所有基本块都会重新迭代。
+  // 集合表示沿用 solve 时的选择。
+  void update(ArrayRef<const Instruction *> insts,
+              ArrayRef<const BasicBlock *> blocks = {}) {
+    assert(_sets && "update 之前必须先调用 solve");
+    _from_cache = false;
+
+    // 1. 按当前的 IR 重建编号（旧的编号中可能有已删除的基本块，
+    //    只用来按指针查找），再重建域，计算旧下标到新下标的映射
+    std::shared_ptr<const CFGIndex> old_cfg = std::move(_cfg);
+    _cfg = CFGIndex::build(_func, TDirection, needComponentOrder());
+    std::vector<TDomainElement> old_domain;
+    old_domain.swap(_domain);
+    buildDomain();
+    std::vector<int> mapping(old_domain.size());
+    bool domain_changed = old_domain.size() != _domain.size();
+    BitVector is_new(_domain.size(), true);
+    for (unsigned idx = 0; idx < old_domain.size(); ++idx) {
+      mapping[idx] = getDomainIndex(old_domain[idx]);
+      domain_changed |= mapping[idx] != static_cast<int>(idx);
+      if (mapping[idx] != -1) {
+        is_new.reset(mapping[idx]);
+      }
+    }
+    if (!domain_changed) {
+      mapping.clear();
+    }
+
+    // 2. 重建摘要，与旧摘要比较找出修改的基本块
+    std::vector<Summary> old_bb_summaries, old_edge_summaries;
+    std::vector<int> old_operand_edges;
+    old_bb_summaries.swap(_bb_summaries);
+    old_edge_summaries.swap(_edge_summaries);
+    old_operand_edges.swap(_operand_edges);
+    buildSummaries();
+
+    unsigned num_blocks = getNumBlocks();
+    // 新块号 -> 旧块号，新出现的基本块为 -1
+    std::vector<int> old_blocks(num_blocks, -1);
+    BitVector changed(num_blocks, false);
+    for (unsigned block = 0; block < num_blocks; ++block) {
+      auto iter = old_cfg->block_index.find(_cfg->blocks[block]);
+      if (iter == old_cfg->block_index.end()) {
+        changed.set(block);
+        continue;
+      }
+      old_blocks[block] = iter->second;
+      if (!sameOperands(*old_cfg, old_operand_edges, iter->second, block,
+                        old_edge_summaries, mapping) ||
+          !sameSummary(old_bb_summaries[iter->second], _bb_summaries[block],
+                       mapping)) {
+        changed.set(block);
+      }
+    }
+    // 只记录仍在函数中的基本块
+    auto markChanged = [this, &changed](const BasicBlock *bb) {
+      auto iter = _cfg->block_index.find(bb);
+      if (iter != _cfg->block_index.end()) {
+        changed.set(iter->second);
+      }
+    };
+    for (const Instruction *inst : insts) {
+      markChanged(inst->getParent());
+    }
+    for (const BasicBlock *bb : blocks) {
+      markChanged(bb);
+    }
+
+    // 3. 计算受影响的锥，以及锥外基本块中新元素的取值
+    BitVector ic = _framework.IC(*this), bc = _framework.BC(*this);
+    BitVector fill = ic;
+    fill &= is_new;
+    BitVector bc_new = bc;
+    bc_new &= is_new;
+    BitVector cone(num_blocks, false);
+    if (fill != bc_new) {
+      cone.set();
+    } else {
+      SmallVector<unsigned, 16> stack;
+      for (unsigned block : changed.set_bits()) {
+        cone.set(block);
+        stack.push_back(block);
+      }
+      while (!stack.empty()) {
+        unsigned block = stack.pop_back_val();
+        for (unsigned dep : getMeetDependentIndices(block)) {
+          if (!cone.test(dep)) {
+            cone.set(dep);
+            stack.push_back(dep);
+          }
+        }
+      }
+    }
+
+    _sets->update(cone, old_blocks, mapping, old_domain.size(), fill, ic, bc);
+  }
+};
+
+// 数据流分析框架的定义。Framework 只描述分析本身（域、方向与各个钩子），
+// 不是 pass：旧 PassManager 通过 LegacyPass/ModuleDriver 包装，
+// 新 PassManager 通过 AnalysisResult 包装。
+//  @tparam TDomainElement 数据流分析的域元素类型
+//  @tparam TDirection 分析的方向（向前或向后）
+template <typename TDomainElement, Direction TDirection> class Framework {
+public:
+  // 定义域元素类型的别名
+  typedef TDomainElement domain_element_t;
+  // 分析方向的静态常量
+  static constexpr Direction direction_c = TDirection;
+  // 单个函数的求解器类型
+  typedef Solver<TDomainElement, TDirection> solver_t;
+
+protected:
+  friend solver_t;
+  template <typename...> friend class FusedSolver;
+  friend class QueryEngine<TDomainElement, TDirection>;
+
+  // 以下钩子都是 const 的，并通过 solver 参数访问逐函数的状态，
+  // 这样同一个分析对象可以被多个线程同时使用。
+
+  // 返回初始条件的虚函数，由子类实现。
+  // IC 与 BC 每个函数只调用一次，再转换为所选的集合表示
+  virtual BitVector IC(const solver_t &solver) const = 0;
+
+  // 返回边界条件的虚函数，由子类实现
+  virtual BitVector BC(const solver_t &solver) const = 0;
+
+  // 遇见操作的虚函数，由子类实现：返回对 meet 操作数取并集还是交集。
+  // meet 由框架按所选的集合表示完成，分析不直接接触基本块的集合
+  virtual MeetKind MeetOp() const = 0;
+
+  // 控制流边上的调整：meet 操作数 operand 的输出集合在参与 bb 的 meet 之前
+  // 先去掉 kill、再加入 gen（域下标）。默认没有调整。
+  // 例如活跃变量分析中，后继的 phi 来自其他前驱的取值在这条边上不活跃
+  virtual void EdgeGenKill(const solver_t &solver, const BasicBlock &operand,
+                           const BasicBlock &bb,
+                           SmallVectorImpl<unsigned> &gen,
+                           SmallVectorImpl<unsigned> &kill) const {}
+
+  // 单条指令的 GEN/KILL 集合（域下标），由子类实现。
+  // 指令的传递函数为 out = gen ∪ (in - kill)，同时出现在两者中的元素
+  // 最终属于 out。框架据此预先计算每个基本块的 GEN/KILL 摘要，
+  // 求解时的传递函数只需集合运算，不再逐位修改。
+  virtual void GenKill(const solver_t &solver, const Instruction &inst,
+                       SmallVectorImpl<unsigned> &gen,
+                       SmallVectorImpl<unsigned> &kill) const = 0;
+
+  // 从指令初始化域的方法，由子类实现
+  virtual void InitializeDomainFromInstruction(solver_t &solver,
+                                               const Instruction &inst) const = 0;
+
+  // 以下两个钩子把逐条指令的钩子批量化：Solver 对每个基本块只调用一次
+  // InitializeDomainFromBlock 与 BlockGenKill。默认实现逐条指令调用上面的
+  // 虚函数；StaticFramework 改为静态绑定的调用，可以内联
+  virtual void InitializeDomainFromBlock(solver_t &solver,
+                                         const BasicBlock &bb) const {
+    for (const Instruction &inst : bb) {
+      InitializeDomainFromInstruction(solver, inst);
+    }
+  }
+
+  // 基本块的 GEN/KILL 摘要（见 Solver::composeGenKill）
+  virtual void BlockGenKill(const solver_t &solver, const BasicBlock &bb,
+                            std::vector<unsigned> &gen,
+                            std::vector<unsigned> &kill) const {
+    solver.composeGenKill(
+        bb,
+        [this, &solver](const Instruction &inst,
+                        SmallVectorImpl<unsigned> &inst_gen,
+                        SmallVectorImpl<unsigned> &inst_kill) {
+          GenKill(solver, inst, inst_gen, inst_kill);
+        },
+        gen, kill);
   }
 
 public:
   // 构造函数
-  Framework(char ID) : FunctionPass(ID) {}
+  Framework()
+      : _solver_kind(DFASolver), _set_kind(DFASet),
+        _domain_slices(DFADomainSlices) {}
   // 析构函数
-  virtual ~Framework() override {}
+  virtual ~Framework() {}
+
+  // 选择求解策略，便于对两种方式做对比测试
+  void setSolverKind(SolverKind kind) { _solver_kind = kind; }
+  SolverKind getSolverKind() const { return _solver_kind; }
+
+  // 选择基本块集合的表示，SetKind::Auto 表示逐函数启发式选择
+  void setSetKind(SetKind kind) { _set_kind = kind; }
+  SetKind getSetKind() const { return _set_kind; }
+
+  // 稠密表示的域切片数（见 SetSolver::solveSliced），1 表示不切片，
+  // 0 表示每个硬件线程一片。实际的片数还受域大小限制，见
+  // Solver::getNumDomainSlices
+  void setDomainSlices(unsigned slices) { _domain_slices = slices; }
+  unsigned getDomainSlices() const { return _domain_slices; }
+
+  // 结果缓存（-dfa-cache-dir，见 cscd70/cache.h）中的分析名与版本。
+  // 名字为空（默认）的分析不使用缓存。钩子的语义改变时应增加版本，
+  // 使旧的缓存失效
+  virtual StringRef getCacheName() const { return ""; }
+  virtual unsigned getCacheVersion() const { return 1; }
+
+  // 统计中的分析名（-time-passes 的计时器、-dfa-stats-csv 与警告），
+  // 默认与缓存名相同
+  virtual StringRef getName() const {
+    StringRef name = getCacheName();
+    return name.empty() ? "dfa" : name;
+  }
+
+  // 求解单个函数，返回持有结果的求解器。本方法是 const 的，可以并发调用。
+  // 求解器引用本分析对象，因此分析对象的生命周期必须覆盖求解器。
+  std::unique_ptr<solver_t> solve(const Function &F) const {
+    auto solver = std::make_unique<solver_t>(*this, F);
+    solver->solve();
+    return solver;
+  }
+
+private:
+  SolverKind _solver_kind;
+  SetKind _set_kind;
+  unsigned _domain_slices;
+};
+
+// 初始条件与边界条件的编译期策略，供 StaticFramework 使用
+struct EmptySetCond {
+  static BitVector make(unsigned domain_size) {
+    return BitVector(domain_size, false);
+  }
+};
+
+struct FullSetCond {
+  static BitVector make(unsigned domain_size) {
+    return BitVector(domain_size, true);
+  }
+};
+
+// 编译期特化的数据流分析框架（CRTP）。meet 运算、初始条件与边界条件是
+// 编译期策略，IC/BC/MeetOp 由本类实现；分析只需实现 GenKill、
+// InitializeDomainFromInstruction 以及可选的 EdgeGenKill，并把本类声明为友元。
+// 分析必须是 final 类，本类通过它调用这些钩子时是静态绑定的，
+// 因此逐指令的循环（建立域与基本块摘要）可以内联，每个基本块只有一次虚函数调用；
+// 求解器对 MeetKind 的选择也在每个函数开始时一次性完成（见 UnionMeet）。
+// 例如：
+//   class Liveness final
+//       : public dfa::StaticFramework<Liveness, Variable, Direction::Backward,
+//                                     UnionMeet, EmptySetCond, EmptySetCond>
+//  @tparam TDerived 具体的分析
+//  @tparam TMeet meet 策略：UnionMeet 或 IntersectMeet
+//  @tparam TIC、TBC 初始条件与边界条件：EmptySetCond 或 FullSetCond
+template <typename TDerived, typename TDomainElement, Direction TDirection,
+          typename TMeet, typename TIC, typename TBC>
+class StaticFramework : public Framework<TDomainElement, TDirection> {
+public:
+  typedef Framework<TDomainElement, TDirection> framework_t;
+  typedef typename framework_t::solver_t solver_t;
+  typedef StaticFramework static_framework_t;
+  typedef TMeet meet_t;
+
+protected:
+  virtual BitVector IC(const solver_t &solver) const final {
+    return TIC::make(solver.getDomainSize());
+  }
+
+  virtual BitVector BC(const solver_t &solver) const final {
+    return TBC::make(solver.getDomainSize());
+  }
+
+  virtual MeetKind MeetOp() const final { return TMeet::kind_c; }
+
+  virtual void InitializeDomainFromBlock(solver_t &solver,
+                                         const BasicBlock &bb) const final {
+    for (const Instruction &inst : bb) {
+      derived().InitializeDomainFromInstruction(solver, inst);
+    }
+  }
+
+  virtual void BlockGenKill(const solver_t &solver, const BasicBlock &bb,
+                            std::vector<unsigned> &gen,
+                            std::vector<unsigned> &kill) const final {
+    solver.composeGenKill(
+        bb,
+        [this, &solver](const Instruction &inst,
+                        SmallVectorImpl<unsigned> &inst_gen,
+                        SmallVectorImpl<unsigned> &inst_kill) {
+          derived().GenKill(solver, inst, inst_gen, inst_kill);
+        },
+        gen, kill);
+  }
+
+private:
+  const TDerived &derived() const {
+    static_assert(std::is_final<TDerived>::value,
+                  "StaticFramework 的分析必须是 final 类，钩子才能静态绑定");
+    return static_cast<const TDerived &>(*this);
+  }
+};
+
+// 同一方向的多个分析的融合求解器。各分析共享同一个 CFGIndex（基本块与
+// 指令的编号、邻接关系与遍历顺序）；建立域与 GEN/KILL 摘要时每个基本块只
+// 遍历一次，依次交给各个分析；迭代时在同一个工作表（或轮询）中对每个
+// 基本块依次处理各个分析，只要有一个分析的输出集合变化，依赖者就重新入队。
+// 使用稠密表示的分析共享一个 SetMatrix，各分析的集合在每一行中并排存放，
+// 处理一个基本块时访问的是连续的内存。迭代策略取第一个分析的设置。
+// 求解完成后每个分析的结果由各自的 Solver 持有，查询、输出与增量更新都与
+// 单独求解时相同（update 会把该分析的集合搬出共享矩阵）。
+//  @tparam TAnalyses 方向相同的分析，例如 Liveness 与其他后向分析
+template <typename... TAnalyses> class FusedSolver {
+  static_assert(sizeof...(TAnalyses) > 0, "至少需要一个分析");
+  static constexpr Direction direction_c =
+      std::tuple_element_t<0, std::tuple<TAnalyses...>>::direction_c;
+  static_assert(((TAnalyses::direction_c == direction_c) && ...),
+                "融合求解的分析必须方向相同");
+
+public:
+  // 分析对象的生命周期必须覆盖本对象及取出的求解器
+  FusedSolver(const Function &F, const TAnalyses &...analyses)
+      : _func(F),
+        _solvers(std::make_unique<typename TAnalyses::solver_t>(analyses,
+                                                                F)...) {}
+
+  static constexpr unsigned getNumAnalyses() { return sizeof...(TAnalyses); }
+
+  // 第 I 个分析的求解器
+  template <unsigned I> const auto &getSolver() const {
+    return *std::get<I>(_solvers);
+  }
+  // 取出第 I 个分析的求解器，之后可以单独使用（例如 update）
+  template <unsigned I> auto takeSolver() {
+    return std::move(std::get<I>(_solvers));
+  }
+
+  void solve() {
+    TimeRecord start;
+    if (isSolveTimed()) {
+      start = TimeRecord::getCurrentTime(true);
+    }
+    SolverKind solver_kind =
+        std::get<0>(_solvers)->getFramework().getSolverKind();
+    std::shared_ptr<const CFGIndex> cfg =
+        CFGIndex::build(_func, direction_c,
+                        solver_kind == SolverKind::SCC || DFALoopStats);
+    unsigned num_blocks = cfg->blocks.size();
+    forEachSolver([&cfg](auto &solver) {
+      solver._cfg = cfg;
+      solver.clearDomain();
+    });
+    for (unsigned block = 0; block < num_blocks; ++block) {
+      forEachSolver([block](auto &solver) { solver.buildDomain(block); });
+    }
+    forEachSolver([](auto &solver) { solver.clearSummaries(); });
+    for (unsigned block = 0; block < num_blocks; ++block) {
+      forEachSolver([block](auto &solver) { solver.buildSummaries(block); });
+    }
+
+    // 先确定各分析的集合表示，稠密表示的分析在共享矩阵中依次占用若干列
+    std::array<BitVector, getNumAnalyses()> ics, bcs;
+    std::array<SetKind, getNumAnalyses()> kinds;
+    std::array<unsigned, getNumAnalyses()> offsets;
+    unsigned num_words = 0, idx = 0;
+    forEachSolver([&](auto &solver) {
+      ics[idx] = solver.getFramework().IC(solver);
+      bcs[idx] = solver.getFramework().BC(solver);
+      kinds[idx] = solver.selectSetKind(ics[idx], bcs[idx]);
+      offsets[idx] = num_words;
+      if (kinds[idx] == SetKind::Dense) {
+        num_words += (solver.getDomainSize() + SetMatrix::kWordBits - 1) /
+                     SetMatrix::kWordBits;
+      }
+      ++idx;
+    });
+    SlabSlice slice;
+    if (num_words != 0) {
+      slice.matrix = std::make_shared<SetMatrix>(
+          BlockSets<DenseSet>::getNumRows(num_blocks),
+          num_words * SetMatrix::kWordBits);
+    }
+    idx = 0;
+    forEachSolver([&](auto &solver) {
+      slice.word_offset = offsets[idx];
+      solver._sets = solver.createSetSolver(
+          kinds[idx], ics[idx], bcs[idx],
+          kinds[idx] == SetKind::Dense && slice.matrix ? &slice : nullptr);
+      _sets[idx] = solver._sets.get();
+      ++idx;
+    });
+
+    switch (solver_kind) {
+    case SolverKind::Worklist:
+      solveWorklist(*cfg);
+      break;
+    case SolverKind::RoundRobin:
+      solveRoundRobin(num_blocks);
+      break;
+    case SolverKind::SCC: {
+      // 与 SetSolver 相同，再次处理本遍处理过的基本块时开始新的一遍
+      BitVector swept(num_blocks);
+      bool first = true;
+      auto visit = [this, &swept, &first](unsigned block) {
+        if (first || swept.test(block)) {
+          countSweep();
+          swept.reset();
+        }
+        first = false;
+        swept.set(block);
+        return visitBlock(block);
+      };
+      auto on_iteration = [this](unsigned component) {
+        for (SetSolverBase *sets : _sets) {
+          sets->countIteration(component);
+        }
+      };
+      solveComponents(*cfg, visit, on_iteration);
+      break;
+    }
+    }
+    // 各分析分摊共享遍历的时间没有意义，每个分析都记入整个融合求解的时间
+    forEachSolver([&start](auto &solver) { solver.recordStats(start, false); });
+    forEachSolver([](auto &solver) {
+      if (DFASetStats) {
+        solver.printSetStats(errs());
+      }
+      if (DFALoopStats) {
+        solver.printLoopStats(errs());
+      }
+    });
+  }
+
+private:
+  template <typename TFn> void forEachSolver(TFn fn) {
+    std::apply([&fn](auto &...solvers) { (fn(*solvers), ...); }, _solvers);
+  }
+
+  // 依次处理各个分析，返回是否有分析的输出集合发生变化
+  bool visitBlock(unsigned block) {
+    bool changed = false;
+    for (SetSolverBase *sets : _sets) {
+      changed |= sets->visitBlock(block);
+    }
+    return changed;
+  }
+
+  // 所有分析都开始新的一遍
+  void countSweep() {
+    for (SetSolverBase *sets : _sets) {
+      sets->countSweep();
+    }
+  }
+
+  void solveRoundRobin(unsigned num_blocks) {
+    bool changed = true;
+    while (changed) {
+      changed = false;
+      countSweep();
+      for (unsigned block = 0; block < num_blocks; ++block) {
+        changed |= visitBlock(block);
+      }
+    }
+  }
+
+  // 与 SetSolver::solveWorklist 相同，只是每次处理基本块时处理所有分析
+  void solveWorklist(const CFGIndex &cfg) {
+    std::priority_queue<unsigned, std::vector<unsigned>, std::greater<unsigned>>
+        worklist;
+    BitVector queued(cfg.order.size(), true);
+    for (unsigned pos = 0; pos < cfg.order.size(); ++pos) {
+      worklist.push(pos);
+    }
+    BitVector swept(cfg.order.size());
+    bool first = true;
+    while (!worklist.empty()) {
+      unsigned pos = worklist.top();
+      worklist.pop();
+      queued[pos] = false;
+      if (first || swept.test(pos)) {
+        countSweep();
+        swept.reset();
+      }
+      first = false;
+      swept.set(pos);
+
+      unsigned block = cfg.order[pos];
+      if (!visitBlock(block)) {
+        continue;
+      }
+      for (unsigned slot = cfg.dependent_begin[block];
+           slot < cfg.dependent_begin[block + 1]; ++slot) {
+        unsigned dep_pos = cfg.order_pos[cfg.dependents[slot]];
+        if (!queued[dep_pos]) {
+          queued[dep_pos] = true;
+          worklist.push(dep_pos);
+        }
+      }
+    }
+  }
+
+  const Function &_func;
+  std::tuple<std::unique_ptr<typename TAnalyses::solver_t>...> _solvers;
+  // 各分析的集合，由各自的 Solver 持有
+  std::array<SetSolverBase *, sizeof...(TAnalyses)> _sets = {};
+};
+
+// 融合求解 F 上的多个同方向分析，见 FusedSolver
+template <typename... TAnalyses>
+FusedSolver<TAnalyses...> solveFused(const Function &F,
+                                     const TAnalyses &...analyses) {
+  FusedSolver<TAnalyses...> fused(F, analyses...);
+  fused.solve();
+  return fused;
+}
+
+// 旧 PassManager 下的函数 pass：求解并打印每个函数的结果
+//  @tparam TAnalysis 具体的分析，例如 Liveness，需要可默认构造
+template <typename TAnalysis> class LegacyPass : public FunctionPass {
+public:
+  static char ID;
+  LegacyPass() : FunctionPass(ID) {}
+  virtual ~LegacyPass() override {}
 
   // 分析使用的设置
-  virtual void getAnalysisUsage(AnalysisUsage &AU) const {
+  virtual void getAnalysisUsage(AnalysisUsage &AU) const override {
     AU.setPreservesAll();
   }
 
-protected:
-  // 从指令初始化域的方法，由子类实现
-  virtual void InitializeDomainFromInstruction(const Instruction &inst) = 0;
+  virtual bool doInitialization(Module &M) override {
+    if (DFAPrint != PrintFormat::None) {
+      _output = std::make_unique<Output>();
+    }
+    return false;
+  }
+
+  // 在函数上运行数据流分析，只有指定了 -dfa-print 时才输出结果
+  virtual bool runOnFunction(Function &F) override {
+    TAnalysis analysis;
+    auto solver = analysis.solve(F);
+    if (_output) {
+      solver->print(_output->os(), DFAPrint);
+    }
+    return false;
+  }
+
+  virtual bool doFinalization(Module &M) override {
+    _output.reset();
+    return false;
+  }
+
+private:
+  std::unique_ptr<Output> _output;
+};
 
+template <typename TAnalysis> char LegacyPass<TAnalysis>::ID = 0;
+
+// 模块级驱动：在 ThreadPool 上并行求解模块中所有有定义的函数，
+// 然后按函数在模块中的顺序输出结果，因此输出与线程数无关。
+//  @tparam TAnalysis 具体的分析，例如 Liveness，需要可默认构造
+template <typename TAnalysis> class ModuleDriver : public ModulePass {
 public:
-  // 在函数上运行数据流分析
-  virtual bool runOnFunction(Function &F) override final {
-    for (const auto &inst : instructions(F)) {
-      InitializeDomainFromInstruction(inst);
+  typedef typename TAnalysis::solver_t solver_t;
+
+  static char ID;
+  ModuleDriver() : ModulePass(ID) {}
+  virtual ~ModuleDriver() override {}
+
+  virtual void getAnalysisUsage(AnalysisUsage &AU) const override {
+    AU.setPreservesAll();
+  }
+
+  // 并行求解模块中的所有函数，结果按函数在模块中的顺序排列
+  static std::vector<std::unique_ptr<solver_t>>
+  solveModule(const TAnalysis &analysis, const Module &M) {
+    std::vector<const Function *> funcs;
+    for (const Function &F : M) {
+      if (!F.isDeclaration()) {
+        funcs.push_back(&F);
+      }
     }
-    for (const auto &inst : instructions(F)) {
-      _inst_bv_map.emplace(&inst, IC());
+
+    // 每个任务只写入自己下标对应的位置，不需要加锁
+    std::vector<std::unique_ptr<solver_t>> results(funcs.size());
+    ThreadPool pool(hardware_concurrency(DFAThreads));
+    for (unsigned idx = 0; idx < funcs.size(); ++idx) {
+      pool.async([&analysis, &funcs, &results, idx]() {
+        ModuleTaskScope scope;
+        results[idx] = analysis.solve(*funcs[idx]);
+      });
     }
-    while (traverseCFG(F)) {
+    pool.wait();
+    return results;
+  }
+
+  virtual bool runOnModule(Module &M) override {
+    TAnalysis analysis;
+    auto solvers = solveModule(analysis, M);
+    if (DFAPrint != PrintFormat::None) {
+      Output output;
+      for (const auto &solver : solvers) {
+        solver->print(output.os(), DFAPrint);
+      }
     }
-    printInstBVMap(F);
     return false;
   }
+};
 
-#undef METHOD_ENABLE_IF_DIRECTION
+template <typename TAnalysis> char ModuleDriver<TAnalysis>::ID = 0;
+
+// 新 PassManager 下分析的结果，由 FunctionAnalysisManager 缓存。
+// 分析对象与求解器都放在堆上，结果在 AnalysisManager 内部被移动时，
+// 求解器对分析对象的引用依然有效。
+// 没有定义 invalidate，因此沿用默认规则：除非 PreservedAnalyses 显式保留了
+// 该分析（或保留了函数上的所有分析），否则结果失效，下次查询时重新求解。
+//  @tparam TAnalysis 具体的分析，例如 Liveness，需要可默认构造
+template <typename TAnalysis> class AnalysisResult {
+public:
+  typedef typename TAnalysis::solver_t solver_t;
+  typedef typename TAnalysis::domain_element_t domain_element_t;
+
+  explicit AnalysisResult(const Function &F)
+      : _analysis(std::make_unique<TAnalysis>()),
+        _solver(_analysis->solve(F)) {}
+
+  const TAnalysis &getAnalysis() const { return *_analysis; }
+  const solver_t &getSolver() const { return *_solver; }
+
+  // 以下为常用查询的转发，含义与 Solver 中的同名方法相同
+  int getDomainIndex(const domain_element_t &elem) const {
+    return _solver->getDomainIndex(elem);
+  }
+  BitVector getInputBV(const BasicBlock &bb) const {
+    return _solver->getInputBV(bb);
+  }
+  BitVector getOutputBV(const BasicBlock &bb) const {
+    return _solver->getOutputBV(bb);
+  }
+  BitVector getInstBV(const Instruction &inst) const {
+    return _solver->getInstBV(inst);
+  }
+
+  // 新 PassManager 的 print<> pass 使用 -dfa-print 指定的格式，
+  // 未指定时输出文本
+  void print(raw_ostream &OS) const { _solver->print(OS, getPrintFormat()); }
+
+  static PrintFormat getPrintFormat() {
+    return DFAPrint == PrintFormat::None ? PrintFormat::Text : DFAPrint;
+  }
+
+  // 修改 IR 的 pass 可以增量更新结果，再在 PreservedAnalyses 中保留本分析
+  void update(ArrayRef<const Instruction *> insts,
+              ArrayRef<const BasicBlock *> blocks = {}) {
+    _solver->update(insts, blocks);
+  }
+
+private:
+  std::unique_ptr<TAnalysis> _analysis;
+  std::unique_ptr<solver_t> _solver;
 };
 
+#undef METHOD_ENABLE_IF_DIRECTION
+
 } // namespace dfa
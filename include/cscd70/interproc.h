@@ -0,0 +1,108 @@
+#pragma once
+
+#include <vector>
+
+#include <llvm/ADT/DenseMap.h>
+#include <llvm/IR/Function.h>
+#include <llvm/IR/Module.h>
+#include <llvm/Support/ThreadPool.h>
+#include <llvm/Support/Threading.h>
+
+#include "cscd70/framework.h"
+
+namespace dfa {
+
+// 调用图（只含直接调用）的强连通分量，按自底向上的层排列：SCC 所调用的
+// 其他 SCC 都在更低的层中，同一层的 SCC 互不调用，可以并行处理。
+// 只包含有精确定义的函数（Function::hasExactDefinition）；声明以及链接时
+// 可能被替换的定义（weak、linkonce 等）按外部函数处理
+struct CallGraphLevels {
+  // 每个 SCC 中的函数，按模块中的顺序
+  std::vector<std::vector<const Function *>> sccs;
+  // SCC 中是否有环（多个函数，或单个函数调用自身），即是否需要迭代
+  std::vector<bool> recursive;
+  // levels[l] 为第 l 层的 SCC（sccs 的下标），第 0 层不调用其他 SCC
+  std::vector<std::vector<unsigned>> levels;
+
+  // 定义在 lib/Interproc.cpp
+  static CallGraphLevels build(const Module &M);
+};
+
+// 自底向上的函数摘要。按 CallGraphLevels 逐层计算，同一层的 SCC 在
+// ThreadPool 上并行（-dfa-threads）；SCC 内的函数反复计算直到摘要不再变化，
+// 之后它们的调用者才会读取。
+// summarize(F, summaries) 计算 F 的摘要，通过 summaries.lookup(callee) 读取
+// 被调用者的摘要：更低的层已经完成，同一 SCC 中的是上一次的结果，初值为
+// TSummary()。summarize 必须单调，TSummary() 必须是最乐观的摘要，并且摘要
+// 的格高度有限，SCC 内的迭代才会终止。
+// summarize 在多个线程上同时调用，只能读取 IR，不能创建常量或修改 IR。
+//  @tparam TSummary 摘要类型，需要可默认构造并支持 ==
+template <typename TSummary> class ModuleSummaries {
+public:
+  template <typename TSummarize>
+  ModuleSummaries(const Module &M, TSummarize summarize)
+      : _levels(CallGraphLevels::build(M)) {
+    for (const std::vector<const Function *> &scc : _levels.sccs) {
+      for (const Function *func : scc) {
+        _index[func] = _summaries.size();
+        _summaries.emplace_back();
+      }
+    }
+    std::vector<unsigned> scc_visits(_levels.sccs.size(), 0);
+
+    // 每个任务只写入自己的 SCC 中的函数的摘要，读取的其他摘要都在更低的层，
+    // 不需要加锁
+    ThreadPool pool(hardware_concurrency(DFAThreads));
+    for (const std::vector<unsigned> &level : _levels.levels) {
+      for (unsigned scc : level) {
+        pool.async([this, &summarize, &scc_visits, scc]() {
+          ModuleTaskScope scope;
+          scc_visits[scc] = summarizeSCC(scc, summarize);
+        });
+      }
+      pool.wait();
+    }
+    for (unsigned visits : scc_visits) {
+      _num_visits += visits;
+    }
+  }
+
+  // F 的摘要；F 不是有精确定义的函数时返回 nullptr
+  const TSummary *lookup(const Function *F) const {
+    auto iter = _index.find(F);
+    return iter == _index.end() ? nullptr : &_summaries[iter->second];
+  }
+
+  const CallGraphLevels &getLevels() const { return _levels; }
+  // 累计调用 summarize 的次数，与函数数之差即为 SCC 内迭代的额外代价
+  unsigned getNumVisits() const { return _num_visits; }
+
+private:
+  template <typename TSummarize>
+  unsigned summarizeSCC(unsigned scc, TSummarize &summarize) {
+    const std::vector<const Function *> &funcs = _levels.sccs[scc];
+    unsigned visits = 0;
+    bool changed;
+    do {
+      changed = false;
+      for (const Function *func : funcs) {
+        TSummary summary = summarize(*func, *this);
+        ++visits;
+        TSummary &slot = _summaries[_index.lookup(func)];
+        if (!(summary == slot)) {
+          slot = std::move(summary);
+          changed = true;
+        }
+      }
+      // 没有环的 SCC（不递归的单个函数）只需计算一次
+    } while (changed && _levels.recursive[scc]);
+    return visits;
+  }
+
+  CallGraphLevels _levels;
+  DenseMap<const Function *, unsigned> _index;
+  std::vector<TSummary> _summaries;
+  unsigned _num_visits = 0;
+};
+
+} // namespace dfa
@@ -0,0 +1,244 @@
+#pragma once
+
+#include <memory>
+#include <vector>
+
+#include <llvm/ADT/BitVector.h>
+#include <llvm/ADT/SmallVector.h>
+#include <llvm/IR/Function.h>
+#include <llvm/IR/Instructions.h>
+
+#include "cscd70/framework.h"
+
+namespace dfa {
+
+template <typename TLattice> class LatticeFramework;
+
+// 格上的数据流分析。Framework 的域是比特向量，meet 只能是并或交，无法表达
+// 常量、区间这类值的格；本框架的值取自任意有限高度的格，由格策略 TLattice
+// 给出 bottom 与 join，由分析给出传递函数。
+// 值按 SSA 值稀疏地保存（每条指令一个格元素，而不是每个基本块每个域元素
+// 一个），沿 def-use 边传播，因此只支持前向分析。同时记录可执行的控制流边：
+// 终结指令只把当前的值下可能到达的后继（FeasibleSuccessors）标为可执行，
+// phi 只对可执行的入边取 join，不可执行的基本块中的指令不求值
+// （Wegman-Zadeck 的条件传播）。
+// 指令号与基本块号取自前向的 CFGIndex，可执行边按 meet 操作数（前驱）的槽位
+// 记录。值只会沿格上升，每条指令最多变化“格的高度”次，每次变化只重新处理
+// 它的使用者，因此总的工作量为 O(use 数 × 高度 + 控制流边数)。
+// 格策略 TLattice 需提供：
+//   value_t                                   格元素的类型，可复制
+//   static value_t bottom()                   最小元：尚未求得的值
+//   static bool join(value_t &dst, const value_t &src)
+//                                             dst = dst ⊔ src，返回是否变化
+template <typename TLattice> class LatticeSolver {
+public:
+  typedef typename TLattice::value_t value_t;
+  typedef LatticeFramework<TLattice> framework_t;
+
+  LatticeSolver(const framework_t &analysis, const Function &func)
+      : _analysis(analysis), _func(func),
+        _cfg(CFGIndex::build(func, Direction::Forward)),
+        _values(_cfg->inst_index.size(), TLattice::bottom()),
+        _queued(_cfg->inst_index.size()), _executable(_cfg->blocks.size()),
+        _edge_executable(_cfg->operands.size()) {}
+
+  const Function &getFunction() const { return _func; }
+
+  // 从入口基本块开始迭代到不动点
+  void solve() {
+    if (_cfg->blocks.empty()) {
+      return;
+    }
+    markBlock(0);
+    // 先处理值的变化，再处理新的可执行基本块，使基本块中的指令第一次求值时
+    // 操作数已尽量稳定
+    while (!_inst_worklist.empty() || !_block_worklist.empty()) {
+      while (!_inst_worklist.empty()) {
+        const Instruction *inst = _inst_worklist.back();
+        _inst_worklist.pop_back();
+        _queued.reset(_cfg->inst_index.lookup(inst));
+        visit(*inst);
+      }
+      if (!_block_worklist.empty()) {
+        unsigned block = _block_worklist.back();
+        _block_worklist.pop_back();
+        for (const Instruction &inst : *_cfg->blocks[block]) {
+          visit(inst);
+        }
+      }
+    }
+  }
+
+  // val 在不动点处的格元素。不是本函数中指令的值（形参、常量等）由分析的
+  // ExternalValue 给出；不可执行的基本块中的指令为 bottom
+  value_t getValue(const Value *val) const {
+    if (const auto *inst = dyn_cast<Instruction>(val)) {
+      auto iter = _cfg->inst_index.find(inst);
+      if (iter != _cfg->inst_index.end()) {
+        return _values[iter->second];
+      }
+    }
+    return _analysis.ExternalValue(*this, *val);
+  }
+
+  bool isExecutable(const BasicBlock *bb) const {
+    return _executable.test(_cfg->block_index.lookup(bb));
+  }
+
+  // 控制流边 from -> to 是否可执行
+  bool isEdgeExecutable(const BasicBlock *from, const BasicBlock *to) const {
+    int slot = getEdgeSlot(_cfg->block_index.lookup(from),
+                           _cfg->block_index.lookup(to));
+    return slot != -1 && _edge_executable.test(slot);
+  }
+
+  // 累计处理过的指令数
+  unsigned getNumVisits() const { return _num_visits; }
+
+private:
+  // 边 from -> to 在 to 的 meet 操作数（前驱）中的槽位。同一条边出现多次时
+  // （例如 switch 的多个分支指向同一个基本块）总是取第一个槽位
+  int getEdgeSlot(unsigned from, unsigned to) const {
+    for (unsigned slot = _cfg->operand_begin[to];
+         slot < _cfg->operand_begin[to + 1]; ++slot) {
+      if (_cfg->operands[slot] == from) {
+        return slot;
+      }
+    }
+    return -1;
+  }
+
+  void markBlock(unsigned block) {
+    _executable.set(block);
+    _block_worklist.push_back(block);
+  }
+
+  // 边第一次可执行时，目标基本块第一次可执行则整块入队，
+  // 否则只有它的 phi 多了一个入边，需要重新求值
+  void markEdge(unsigned from, unsigned to) {
+    int slot = getEdgeSlot(from, to);
+    assert(slot != -1 && "后继必须是控制流图中的边");
+    if (_edge_executable.test(slot)) {
+      return;
+    }
+    _edge_executable.set(slot);
+    if (!_executable.test(to)) {
+      markBlock(to);
+      return;
+    }
+    for (const PHINode &phi : _cfg->blocks[to]->phis()) {
+      push(phi);
+    }
+  }
+
+  void push(const Instruction &inst) {
+    unsigned inst_id = _cfg->inst_index.lookup(&inst);
+    if (!_queued.test(inst_id)) {
+      _queued.set(inst_id);
+      _inst_worklist.push_back(&inst);
+    }
+  }
+
+  // 把 value 并入指令的值，变化时重新处理它的使用者
+  void update(const Instruction &inst, const value_t &value) {
+    if (!TLattice::join(_values[_cfg->inst_index.lookup(&inst)], value)) {
+      return;
+    }
+    for (const User *user : inst.users()) {
+      if (const auto *user_inst = dyn_cast<Instruction>(user)) {
+        push(*user_inst);
+      }
+    }
+  }
+
+  void visit(const Instruction &inst) {
+    unsigned block = _cfg->block_index.lookup(inst.getParent());
+    if (!_executable.test(block)) {
+      return;
+    }
+    ++_num_visits;
+    if (const auto *phi = dyn_cast<PHINode>(&inst)) {
+      value_t value = TLattice::bottom();
+      for (unsigned k = 0; k < phi->getNumIncomingValues(); ++k) {
+        int slot = getEdgeSlot(
+            _cfg->block_index.lookup(phi->getIncomingBlock(k)), block);
+        if (slot != -1 && _edge_executable.test(slot)) {
+          TLattice::join(value, getValue(phi->getIncomingValue(k)));
+        }
+      }
+      update(inst, value);
+      return;
+    }
+    if (inst.isTerminator()) {
+      SmallVector<const BasicBlock *, 2> succs;
+      _analysis.FeasibleSuccessors(*this, inst, succs);
+      for (const BasicBlock *succ : succs) {
+        markEdge(block, _cfg->block_index.lookup(succ));
+      }
+    }
+    if (!inst.getType()->isVoidTy()) {
+      update(inst, _analysis.Transfer(*this, inst));
+    }
+  }
+
+  const framework_t &_analysis;
+  const Function &_func;
+  std::shared_ptr<const CFGIndex> _cfg;
+  // 按指令号
+  std::vector<value_t> _values;
+  BitVector _queued;
+  std::vector<const Instruction *> _inst_worklist;
+  // 按基本块号
+  BitVector _executable;
+  std::vector<unsigned> _block_worklist;
+  // 按 CFGIndex::operands 的槽位
+  BitVector _edge_executable;
+  unsigned _num_visits = 0;
+};
+
+// 格上的数据流分析的定义（见 LatticeSolver），与 Framework 一样只描述分析
+// 本身，钩子都是 const 的，同一个分析对象可以同时求解多个函数。
+//  @tparam TLattice 格策略
+template <typename TLattice> class LatticeFramework {
+public:
+  typedef TLattice lattice_t;
+  typedef typename TLattice::value_t value_t;
+  // 单个函数的求解器类型
+  typedef LatticeSolver<TLattice> solver_t;
+
+protected:
+  friend solver_t;
+
+  // 不是本函数中指令的值（形参、常量、全局值等）的格元素，即边界条件
+  virtual value_t ExternalValue(const solver_t &solver,
+                                const Value &val) const = 0;
+
+  // 指令的传递函数：由操作数的值（solver.getValue）求出指令的值，必须单调。
+  // 只对可执行的基本块中产生值的非 phi 指令调用；phi 由框架对可执行的入边
+  // 取 join
+  virtual value_t Transfer(const solver_t &solver,
+                           const Instruction &inst) const = 0;
+
+  // 终结指令 term 在当前的值下可能到达的后继，默认为全部后继。
+  // 操作数的值上升时结果只能增加（单调）
+  virtual void
+  FeasibleSuccessors(const solver_t &solver, const Instruction &term,
+                     SmallVectorImpl<const BasicBlock *> &succs) const {
+    for (unsigned k = 0; k < term.getNumSuccessors(); ++k) {
+      succs.push_back(term.getSuccessor(k));
+    }
+  }
+
+public:
+  virtual ~LatticeFramework() {}
+
+  // 求解单个函数，返回持有结果的求解器。本方法是 const 的，可以并发调用。
+  // 求解器引用本分析对象，因此分析对象的生命周期必须覆盖求解器
+  std::unique_ptr<solver_t> solve(const Function &F) const {
+    auto solver = std::make_unique<solver_t>(*this, F);
+    solver->solve();
+    return solver;
+  }
+};
+
+} // namespace dfa
@@ -0,0 +1,333 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+#include <llvm/ADT/ArrayRef.h>
+#include <llvm/ADT/BitVector.h>
+#include <llvm/ADT/DenseMap.h>
+#include <llvm/ADT/STLExtras.h>
+#include <llvm/ADT/SmallVector.h>
+#include <llvm/IR/Function.h>
+#include <llvm/IR/Instruction.h>
+
+#include "cscd70/framework.h"
+
+namespace dfa {
+
+// 按需查询：只回答“元素 e 是否在某条指令/某个基本块的集合中”，不求解整个
+// 函数。GEN/KILL 问题的每一位互不影响，单个元素经过一个基本块或一条控制流边
+// 的传递函数只有三种：置 1、置 0 或恒等。因此一个基本块输入中的某一位只取决于
+// 沿 meet 操作数反向、经由恒等传递函数可达的那部分控制流图（区域），在遇到
+// GEN 或 KILL 该元素的基本块（或边）处停止。查询时只搜索这个区域，在区域内
+// 解出布尔方程，得到的结果与 Solver::solve 相同：
+//   初始条件取 meet 的非吸收元（并集时为 0，交集时为 1，Liveness 与
+//   AvailExpr 都是这种情况）时，一个基本块取吸收元当且仅当区域中有一条路径
+//   通向取吸收元的常量；否则（初始条件取吸收元）区域中的环也保持吸收元，
+//   只有所有路径都通向非吸收元的常量时才取非吸收元。
+// 区域中任一基本块的区域都包含在其中，因此区域内所有基本块的结果都是精确的，
+// 按元素记忆化之后，之后的查询遇到它们即可停止。
+// 引擎在构造时只为函数建立编号与域（Solver::prepareDomain），基本块与控制流边
+// 的 GEN/KILL 摘要在搜索到时才计算并缓存，因此不在任何区域中的基本块不需要
+// 调用 GenKill。之后修改 IR 需要重新构造引擎。查询会修改缓存，同一个引擎
+// 不能在多个线程上同时使用。
+//  @tparam TDomainElement 数据流分析的域元素类型
+//  @tparam TDirection 分析的方向（向前或向后）
+template <typename TDomainElement, Direction TDirection> class QueryEngine {
+public:
+  typedef Solver<TDomainElement, TDirection> solver_t;
+  typedef typename solver_t::framework_t framework_t;
+
+private:
+  typedef typename solver_t::Summary summary_t;
+
+  // 记忆化结果的取值：未知、区域内待求解，以及 0/1
+  static constexpr int8_t kUnknown = -1;
+  static constexpr int8_t kPending = 2;
+
+  solver_t _solver;
+  BitVector _ic, _bc;
+  MeetKind _meet_kind;
+  // 按需计算的摘要：基本块的按块号索引，控制流边的按 CFGIndex::operands
+  // 中的位置索引
+  std::vector<summary_t> _bb_summaries, _edge_summaries;
+  BitVector _has_bb_summary, _has_edge_summary;
+  // 域下标 -> 每个基本块输入中该位的值，第一次查询该元素时建立
+  DenseMap<unsigned, std::vector<int8_t>> _memo;
+  // 基本块在当前区域中的位置，只对 kPending 的基本块有意义
+  std::vector<unsigned> _region_pos;
+  unsigned _num_visits = 0;
+
+public:
+  QueryEngine(const framework_t &framework, const Function &func)
+      : _solver(framework, func) {
+    _solver.prepareDomain();
+    _ic = framework.IC(_solver);
+    _bc = framework.BC(_solver);
+    _meet_kind = framework.MeetOp();
+    unsigned num_blocks = _solver.getNumBlocks();
+    unsigned num_edges = _solver.getCFGIndex().operands.size();
+    _bb_summaries.resize(num_blocks);
+    _has_bb_summary.resize(num_blocks);
+    _edge_summaries.resize(num_edges);
+    _has_edge_summary.resize(num_edges);
+    _region_pos.resize(num_blocks);
+  }
+
+  // 编号与域，可用于把元素或基本块转换为下标
+  const solver_t &getSolver() const { return _solver; }
+
+  // elem 是否在 inst 处的集合中，含义同 Solver::getInstBV（遍历方向上
+  // 该指令之后的集合；对 Liveness 即 inst 之前活跃）。不在域中的元素为 false
+  bool contains(const TDomainElement &elem, const Instruction &inst) {
+    int idx = _solver.getDomainIndex(elem);
+    if (idx == -1) {
+      return false;
+    }
+    // 块内最后一个涉及该元素的指令决定结果，没有时才需要基本块的输入
+    int bit = -1;
+    SmallVector<unsigned, 4> gen, kill;
+    for (const Instruction &curr :
+         _solver.InstTraversalOrder(*inst.getParent())) {
+      gen.clear();
+      kill.clear();
+      _solver._framework.GenKill(_solver, curr, gen, kill);
+      if (is_contained(kill, unsigned(idx))) {
+        bit = 0;
+      }
+      if (is_contained(gen, unsigned(idx))) {
+        bit = 1;
+      }
+      if (&curr == &inst) {
+        break;
+      }
+    }
+    if (bit != -1) {
+      return bit;
+    }
+    return getInputBit(_solver.getBlockIndex(*inst.getParent()), idx);
+  }
+
+  // elem 是否在基本块遍历方向上的输入/输出集合中，
+  // 含义同 Solver::getInputBV/getOutputBV
+  bool inInput(const TDomainElement &elem, const BasicBlock &bb) {
+    int idx = _solver.getDomainIndex(elem);
+    return idx != -1 && getInputBit(_solver.getBlockIndex(bb), idx);
+  }
+  bool inOutput(const TDomainElement &elem, const BasicBlock &bb) {
+    int idx = _solver.getDomainIndex(elem);
+    return idx != -1 && getOutputBit(_solver.getBlockIndex(bb), idx);
+  }
+
+  // 以基本块号与域下标查询
+  bool getInputBit(unsigned block, unsigned idx) {
+    std::vector<int8_t> &memo = getMemo(idx);
+    if (memo[block] == kUnknown) {
+      solveRegion(block, idx, memo);
+    }
+    return memo[block];
+  }
+  bool getOutputBit(unsigned block, unsigned idx) {
+    int bit = blockTransfer(block, idx);
+    return bit != -1 ? bit : getInputBit(block, idx);
+  }
+
+  // 累计搜索过的基本块数，可与 Solver::getNumVisits 比较
+  unsigned getNumVisits() const { return _num_visits; }
+  // 已计算摘要的基本块数
+  unsigned getNumSummarized() const { return _has_bb_summary.count(); }
+  // 已记忆化的元素数
+  unsigned getNumMemoized() const { return _memo.size(); }
+
+private:
+  std::vector<int8_t> &getMemo(unsigned idx) {
+    assert(idx < _solver.getDomainSize() && "域下标越界");
+    std::vector<int8_t> &memo = _memo[idx];
+    if (memo.empty()) {
+      memo.assign(_solver.getNumBlocks(), kUnknown);
+    }
+    return memo;
+  }
+
+  // 单个元素经过传递函数的结果：1/0 为常量，-1 为恒等。与 BlockSets 一致，
+  // 同时出现在 GEN 与 KILL 中时 GEN 优先
+  static int transfer(const summary_t &summary, unsigned idx) {
+    if (std::binary_search(summary.gen.begin(), summary.gen.end(), idx)) {
+      return 1;
+    }
+    if (std::binary_search(summary.kill.begin(), summary.kill.end(), idx)) {
+      return 0;
+    }
+    return -1;
+  }
+  int blockTransfer(unsigned block, unsigned idx) {
+    summary_t &summary = _bb_summaries[block];
+    if (!_has_bb_summary.test(block)) {
+      _has_bb_summary.set(block);
+      _solver._framework.BlockGenKill(_solver, _solver.getBlock(block),
+                                      summary.gen, summary.kill);
+    }
+    return transfer(summary, idx);
+  }
+
+  // CFGIndex::operands[slot] 所在的控制流边，与 Solver::buildSummaries 相同
+  int edgeTransfer(unsigned block, unsigned slot, unsigned idx) {
+    summary_t &summary = _edge_summaries[slot];
+    if (!_has_edge_summary.test(slot)) {
+      _has_edge_summary.set(slot);
+      SmallVector<unsigned, 4> gen, kill;
+      _solver._framework.EdgeGenKill(
+          _solver, _solver.getBlock(_solver.getCFGIndex().operands[slot]),
+          _solver.getBlock(block), gen, kill);
+      summary.gen.assign(gen.begin(), gen.end());
+      summary.kill.assign(kill.begin(), kill.end());
+      solver_t::sortUnique(summary.gen);
+      solver_t::sortUnique(summary.kill);
+    }
+    return transfer(summary, idx);
+  }
+
+  // 基本块 block 的第 slot 个 meet 操作数（经由所在边）对 meet 的贡献，
+  // 取决于该操作数的输入且尚未知道时为 -1
+  int contribution(unsigned block, unsigned slot, unsigned idx,
+                   const std::vector<int8_t> &memo) {
+    int bit = edgeTransfer(block, slot, idx);
+    if (bit != -1) {
+      return bit;
+    }
+    unsigned operand = _solver.getCFGIndex().operands[slot];
+    bit = blockTransfer(operand, idx);
+    if (bit != -1) {
+      return bit;
+    }
+    return memo[operand] == kPending ? -1 : memo[operand];
+  }
+
+  // 从 block 出发反向搜索区域，在区域内求解后把结果写入 memo
+  void solveRegion(unsigned block, unsigned idx, std::vector<int8_t> &memo) {
+    int8_t absorbing = _meet_kind == MeetKind::Union ? 1 : 0;
+    int8_t initial = _ic.test(idx);
+
+    // 1. 搜索区域：输入未知、需要一起求解的基本块，以及区域内的依赖
+    //    （操作数在区域中的位置, 依赖者在区域中的位置）
+    std::vector<unsigned> region;
+    std::vector<bool> has_absorbing;
+    std::vector<std::pair<unsigned, unsigned>> links;
+    auto enter = [&](unsigned b) {
+      memo[b] = kPending;
+      _region_pos[b] = region.size();
+      region.push_back(b);
+      has_absorbing.push_back(false);
+    };
+    enter(block);
+    const CFGIndex &cfg = _solver.getCFGIndex();
+    for (unsigned pos = 0; pos < region.size(); ++pos) {
+      unsigned curr = region[pos];
+      if (cfg.operand_begin[curr] == cfg.operand_begin[curr + 1]) {
+        has_absorbing[pos] = _bc.test(idx) == bool(absorbing);
+      }
+      for (unsigned slot = cfg.operand_begin[curr];
+           slot < cfg.operand_begin[curr + 1]; ++slot) {
+        unsigned operand = cfg.operands[slot];
+        int bit = contribution(curr, slot, idx, memo);
+        if (bit == -1) {
+          if (memo[operand] == kUnknown) {
+            enter(operand);
+          }
+          links.emplace_back(_region_pos[operand], pos);
+        } else if (bit == absorbing) {
+          has_absorbing[pos] = true;
+        }
+      }
+    }
+    _num_visits += region.size();
+
+    // 按操作数建立依赖者的邻接数组
+    unsigned size = region.size();
+    std::vector<unsigned> link_begin(size + 1, 0), dependents(links.size());
+    for (const auto &link : links) {
+      ++link_begin[link.first + 1];
+    }
+    for (unsigned pos = 0; pos < size; ++pos) {
+      link_begin[pos + 1] += link_begin[pos];
+    }
+    std::vector<unsigned> cursor(link_begin.begin(), link_begin.end() - 1);
+    for (const auto &link : links) {
+      dependents[cursor[link.first]++] = link.second;
+    }
+
+    // 2. 在区域内求解。一个基本块一旦确定，就沿依赖者传播
+    std::vector<int8_t> value(size, kUnknown);
+    std::vector<unsigned> queue;
+    auto propagate = [&](auto &&decide) {
+      for (unsigned head = 0; head < queue.size(); ++head) {
+        unsigned pos = queue[head];
+        for (unsigned slot = link_begin[pos]; slot < link_begin[pos + 1];
+             ++slot) {
+          unsigned dep = dependents[slot];
+          if (value[dep] == kUnknown && decide(dep)) {
+            queue.push_back(dep);
+          }
+        }
+      }
+    };
+    if (initial != absorbing) {
+      // 吸收元从常量沿路径传播，其余（包括只在环中循环的）为非吸收元
+      for (unsigned pos = 0; pos < size; ++pos) {
+        if (has_absorbing[pos]) {
+          value[pos] = absorbing;
+          queue.push_back(pos);
+        }
+      }
+      propagate([&](unsigned dep) {
+        value[dep] = absorbing;
+        return true;
+      });
+      for (int8_t &bit : value) {
+        if (bit == kUnknown) {
+          bit = !absorbing;
+        }
+      }
+    } else {
+      // 所有贡献都已确定为非吸收元的基本块才取非吸收元，其余保持吸收元
+      std::vector<unsigned> pending(size, 0);
+      for (const auto &link : links) {
+        ++pending[link.second];
+      }
+      for (unsigned pos = 0; pos < size; ++pos) {
+        if (!has_absorbing[pos] && pending[pos] == 0) {
+          value[pos] = !absorbing;
+          queue.push_back(pos);
+        }
+      }
+      propagate([&](unsigned dep) {
+        if (has_absorbing[dep] || --pending[dep] != 0) {
+          return false;
+        }
+        value[dep] = !absorbing;
+        return true;
+      });
+      for (int8_t &bit : value) {
+        if (bit == kUnknown) {
+          bit = absorbing;
+        }
+      }
+    }
+    for (unsigned pos = 0; pos < size; ++pos) {
+      memo[region[pos]] = value[pos];
+    }
+  }
+};
+
+// 为 F 建立分析 analysis 的按需查询引擎，见 QueryEngine。
+// 需要少数几个结果时代替 Framework::solve；需要大量结果时 solve 更快
+template <typename TAnalysis>
+QueryEngine<typename TAnalysis::domain_element_t, TAnalysis::direction_c>
+makeQueryEngine(const TAnalysis &analysis, const Function &F) {
+  return QueryEngine<typename TAnalysis::domain_element_t,
+                     TAnalysis::direction_c>(analysis, F);
+}
+
+} // namespace dfa
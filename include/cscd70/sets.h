@@ -0,0 +1,245 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+#include <llvm/ADT/BitVector.h>
+#include <llvm/ADT/SparseBitVector.h>
+
+#include "cscd70/bitkernels.h"
+
+namespace dfa {
+
+// dfa::Framework 中基本块集合的表示方式。Solver 以模板参数（集合策略）
+// 的形式使用它们，三种策略提供相同的接口：
+//   构造（域大小）、test/set/reset、|=、&=、subtract（差集）、==、
+//   transfer（out = gen | (in & ~kill)，返回 out 是否变化）、
+//   fromBitVector/toBitVector、getMemoryUsage，以及用于启发式选择的
+//   estimateMemory。
+//  Auto:    由 chooseSetKind 根据域大小与密度选择
+//  Dense:   llvm::BitVector，整字 SIMD 传递函数，适合小域或稠密集合
+//  Sparse:  llvm::SparseBitVector，128 位一段的链表，适合稀疏且聚集的集合
+//  Chunked: 类似 Roaring 的分块压缩位图，适合稀疏且分散的集合
+enum class SetKind { Auto, Dense, Sparse, Chunked };
+
+const char *getSetKindName(SetKind kind);
+
+// 稠密集合：llvm::BitVector 的包装
+class DenseSet {
+public:
+  static constexpr SetKind kind_c = SetKind::Dense;
+
+  DenseSet() {}
+  explicit DenseSet(unsigned domain_size) : _bv(domain_size, false) {}
+
+  static DenseSet fromBitVector(const llvm::BitVector &bv) {
+    DenseSet set;
+    set._bv = bv;
+    return set;
+  }
+  llvm::BitVector toBitVector(unsigned) const { return _bv; }
+
+  bool test(unsigned idx) const { return _bv.test(idx); }
+  void set(unsigned idx) { _bv.set(idx); }
+  void reset(unsigned idx) { _bv.reset(idx); }
+
+  DenseSet &operator|=(const DenseSet &rhs) {
+    _bv |= rhs._bv;
+    return *this;
+  }
+  DenseSet &operator&=(const DenseSet &rhs) {
+    _bv &= rhs._bv;
+    return *this;
+  }
+  DenseSet &subtract(const DenseSet &rhs) {
+    _bv.reset(rhs._bv);
+    return *this;
+  }
+  bool operator==(const DenseSet &rhs) const { return _bv == rhs._bv; }
+  bool operator!=(const DenseSet &rhs) const { return !(*this == rhs); }
+
+  // 由 transferBV 按整字（SIMD）计算
+  static bool transfer(DenseSet &out, const DenseSet &in, const DenseSet &gen,
+                       const DenseSet &kill) {
+    return transferBV(out._bv, in._bv, gen._bv, kill._bv);
+  }
+
+  size_t getMemoryUsage() const { return sizeof(*this) + _bv.getMemorySize(); }
+
+  // 域大小为 domain_size 时单个集合的字节数，与元素个数无关
+  static size_t estimateMemory(unsigned domain_size) {
+    return sizeof(DenseSet) + (domain_size + 63) / 64 * sizeof(word_t);
+  }
+
+private:
+  llvm::BitVector _bv;
+};
+
+// 稀疏集合：llvm::SparseBitVector 的包装。
+// 每段 128 位，只为含有元素的段分配链表结点
+class SparseSet {
+public:
+  static constexpr SetKind kind_c = SetKind::Sparse;
+  static constexpr unsigned kElementBits = 128;
+  typedef llvm::SparseBitVector<kElementBits> sbv_t;
+
+  SparseSet() {}
+  explicit SparseSet(unsigned) {}
+
+  static SparseSet fromBitVector(const llvm::BitVector &bv) {
+    SparseSet set;
+    for (unsigned idx : bv.set_bits()) {
+      set._sbv.set(idx);
+    }
+    return set;
+  }
+  llvm::BitVector toBitVector(unsigned domain_size) const {
+    llvm::BitVector bv(domain_size, false);
+    for (unsigned idx : _sbv) {
+      bv.set(idx);
+    }
+    return bv;
+  }
+
+  bool test(unsigned idx) const { return _sbv.test(idx); }
+  void set(unsigned idx) { _sbv.set(idx); }
+  void reset(unsigned idx) { _sbv.reset(idx); }
+
+  SparseSet &operator|=(const SparseSet &rhs) {
+    _sbv |= rhs._sbv;
+    return *this;
+  }
+  SparseSet &operator&=(const SparseSet &rhs) {
+    _sbv &= rhs._sbv;
+    return *this;
+  }
+  SparseSet &subtract(const SparseSet &rhs) {
+    _sbv.intersectWithComplement(rhs._sbv);
+    return *this;
+  }
+  bool operator==(const SparseSet &rhs) const { return _sbv == rhs._sbv; }
+  bool operator!=(const SparseSet &rhs) const { return !(*this == rhs); }
+
+  static bool transfer(SparseSet &out, const SparseSet &in,
+                       const SparseSet &gen, const SparseSet &kill) {
+    SparseSet result = in;
+    result.subtract(kill);
+    result |= gen;
+    if (result == out) {
+      return false;
+    }
+    out = std::move(result);
+    return true;
+  }
+
+  // 链表结点数 × (段 + 两个链表指针)
+  size_t getMemoryUsage() const {
+    size_t num_elements = 0;
+    unsigned last = ~0u;
+    for (unsigned idx : _sbv) {
+      if (idx / kElementBits != last) {
+        last = idx / kElementBits;
+        ++num_elements;
+      }
+    }
+    return sizeof(*this) + num_elements * kNodeBytes;
+  }
+
+  // num_elems 个元素、平均每个 128 位段内有 elems_per_segment 个元素时的字节数
+  static size_t estimateMemory(double num_elems, double elems_per_segment);
+
+private:
+  static constexpr size_t kNodeBytes =
+      sizeof(llvm::SparseBitVectorElement<kElementBits>) + 2 * sizeof(void *);
+
+  sbv_t _sbv;
+};
+
+// 类似 Roaring 的分块压缩位图。
+// 元素下标的高位为块号，每块覆盖 kChunkSize 个元素；块内元素不超过
+// kArrayMax 个时存为有序的 16 位数组，否则存为位图，二者的分界点
+// 正好是两种存储大小相等的位置。容器类型完全由块内元素个数决定，
+// 因此同一集合只有一种表示，可以直接逐块比较。
+// Roaring 的块宽为 2^16，但编译器中的域通常只有数千到数万个元素，
+// 这里取 2^12，使一个位图块只有 512 字节。
+class ChunkedSet {
+public:
+  static constexpr SetKind kind_c = SetKind::Chunked;
+  static constexpr unsigned kChunkBits = 12;
+  static constexpr unsigned kChunkSize = 1u << kChunkBits;
+  static constexpr unsigned kBitmapWords = kChunkSize / 64;
+  static constexpr unsigned kArrayMax = kChunkSize / 16;
+
+  ChunkedSet() {}
+  explicit ChunkedSet(unsigned) {}
+
+  static ChunkedSet fromBitVector(const llvm::BitVector &bv);
+  llvm::BitVector toBitVector(unsigned domain_size) const;
+
+  bool test(unsigned idx) const;
+  void set(unsigned idx);
+  void reset(unsigned idx);
+
+  ChunkedSet &operator|=(const ChunkedSet &rhs);
+  ChunkedSet &operator&=(const ChunkedSet &rhs);
+  ChunkedSet &subtract(const ChunkedSet &rhs);
+  bool operator==(const ChunkedSet &rhs) const;
+  bool operator!=(const ChunkedSet &rhs) const { return !(*this == rhs); }
+
+  static bool transfer(ChunkedSet &out, const ChunkedSet &in,
+                       const ChunkedSet &gen, const ChunkedSet &kill);
+
+  size_t getMemoryUsage() const;
+
+  // num_elems 个元素、平均每块有 elems_per_chunk 个元素时的字节数
+  static size_t estimateMemory(double num_elems, double elems_per_chunk);
+
+private:
+  struct Chunk {
+    unsigned key;                 // 块号，即元素下标 >> kChunkBits
+    unsigned card;                // 块内元素个数，不为 0
+    std::vector<uint16_t> array;  // card <= kArrayMax 时使用，升序
+    std::vector<uint64_t> bitmap; // card > kArrayMax 时使用，kBitmapWords 个字
+
+    bool isBitmap() const { return !bitmap.empty(); }
+    bool operator==(const Chunk &rhs) const {
+      return key == rhs.key && card == rhs.card && array == rhs.array &&
+             bitmap == rhs.bitmap;
+    }
+  };
+
+  // 按块号二分查找，返回第一个块号不小于 key 的位置
+  std::vector<Chunk>::iterator lowerBound(unsigned key);
+  std::vector<Chunk>::const_iterator lowerBound(unsigned key) const;
+
+  static void toWords(const Chunk &chunk, uint64_t *words);
+  // 根据位图重建块并选择容器，返回块是否非空
+  static bool fromWords(Chunk &chunk, const uint64_t *words);
+  // 元素个数变化后按 kArrayMax 切换容器
+  static void normalize(Chunk &chunk);
+
+  std::vector<Chunk> _chunks; // 按块号升序，不含空块
+};
+
+// 启发式选择集合表示时使用的统计量，由 Solver 根据基本块的 GEN/KILL
+// 摘要以及 IC/BC 估计
+struct SetProfile {
+  unsigned domain_size = 0;
+  unsigned num_sets = 0;
+  // 估计的单个集合的元素个数
+  double elems_per_set = 0;
+  // 元素的聚集程度：平均每个非空 128 位段 / 每个非空块内的元素个数
+  double elems_per_segment = 1;
+  double elems_per_chunk = 1;
+};
+
+// 单个集合在给定表示下的估计字节数
+size_t estimateSetMemory(SetKind kind, const SetProfile &profile);
+
+// 选择估计内存最小的表示。稠密集合的传递函数最快，
+// 因此只有当其他表示的估计内存不到稠密集合的一半时才选择它们
+SetKind chooseSetKind(const SetProfile &profile);
+
+} // namespace dfa
@@ -0,0 +1,70 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+#include <llvm/ADT/StringRef.h>
+#include <llvm/IR/Function.h>
+#include <llvm/Support/CommandLine.h>
+#include <llvm/Support/Timer.h>
+
+#include "cscd70/sets.h"
+
+namespace dfa {
+
+// 求解策略，定义在 cscd70/framework.h
+enum class SolverKind;
+
+// dfa::Framework 的求解代价统计，实现在 lib/Stats.cpp。Solver 与 FusedSolver
+// 在每个函数求解之后调用 recordSolveStats，统计量按以下方式输出：
+//  - STATISTIC（-stats，DEBUG_TYPE 为 "dfa"）：所有函数的累计值与最大值
+//  - -time-passes：按分析名汇总的求解时间，在进程退出时作为 "dfa" 计时器组输出
+//  - -dfa-stats-csv=<file>：每个函数一行
+// 遍数超过 -dfa-sweep-warning 的函数在 stderr 上给出警告。遍数的含义随
+// 求解策略而不同（见 SolveStats::sweeps），阈值应按所用的 -dfa-solver 选择。
+// recordSolveStats 可以在多个线程上同时调用。
+
+// 命令行选项 -dfa-stats-csv，为空时不输出
+extern llvm::cl::opt<std::string> DFAStatsCSV;
+// 命令行选项 -dfa-sweep-warning，为 0 时不警告
+extern llvm::cl::opt<unsigned> DFASweepWarning;
+
+// 单个函数一次求解的代价
+struct SolveStats {
+  unsigned num_blocks = 0;
+  unsigned num_insts = 0;
+  unsigned domain_size = 0;
+  SetKind set_kind = SetKind::Dense;
+  // 求解策略，决定 sweeps 的含义
+  SolverKind solver_kind{};
+  // 结果从缓存读回，没有建立摘要，也没有迭代
+  bool cached = false;
+  // 处理基本块（meet 与块的传递函数）的次数
+  uint64_t visits = 0;
+  // 调用传递函数的次数：建立摘要时每条指令一次；迭代时每处理一个基本块
+  // 一次块的传递函数，以及每条有调整（EdgeGenKill）的入边各一次
+  uint64_t transfers = 0;
+  // 遍数。轮询为遍历所有基本块的次数；工作表与按分量求解在再次处理本遍
+  // 处理过的基本块时开始新的一遍。后两者的一遍只覆盖需要重新处理的基本块，
+  // 而且每次回到循环的头都算一遍，因此同一个函数在不同策略下的遍数不能
+  // 直接比较，只有同一策略下的遍数可以互相比较
+  unsigned sweeps = 0;
+  // 集合内存的峰值（字节），见 isSetMemoryTracked
+  size_t peak_memory = 0;
+  // 建立域、摘要与迭代（或读取缓存）的时间，见 isSolveTimed
+  llvm::TimeRecord time;
+};
+
+// 是否需要统计集合内存的峰值：-dfa-set-stats、-dfa-stats-csv 或 -stats。
+// 统计峰值需要在每次处理基本块之后检查集合大小，因此默认关闭
+bool isSetMemoryTracked();
+
+// 是否需要测量求解时间：-time-passes 或 -dfa-stats-csv
+bool isSolveTimed();
+
+// 记录函数 F 上分析 analysis 的一次求解
+void recordSolveStats(const llvm::Function &F, llvm::StringRef analysis,
+                      const SolveStats &stats);
+
+} // namespace dfa
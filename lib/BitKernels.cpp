@@ -0,0 +1,142 @@
+// dfa::Framework 的 GEN/KILL 传递函数核：标量、SSE2 与 AVX2 三个版本，
+// 运行时根据 CPU 支持的指令集选择
+#include "cscd70/bitkernels.h"
+
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#define DFA_X86_KERNELS 1
+#include <immintrin.h>
+#endif
+
+namespace dfa {
+
+namespace {
+
+bool transferScalar(word_t *out, const word_t *in, const word_t *gen,
+                    const word_t *kill, size_t num_words) {
+  word_t diff = 0;
+  for (size_t idx = 0; idx < num_words; ++idx) {
+    word_t word = gen[idx] | (in[idx] & ~kill[idx]);
+    diff |= word ^ out[idx];
+    out[idx] = word;
+  }
+  return diff != 0;
+}
+
+#ifdef DFA_X86_KERNELS
+static_assert(sizeof(word_t) == 8, "x86-64 的 BitVector 字应为 64 位");
+
+// SSE2 是 x86-64 的基础指令集，不需要额外的 target 属性
+bool transferSSE2(word_t *out, const word_t *in, const word_t *gen,
+                  const word_t *kill, size_t num_words) {
+  __m128i diff = _mm_setzero_si128();
+  size_t idx = 0;
+  for (; idx + 2 <= num_words; idx += 2) {
+    __m128i vin = _mm_loadu_si128(reinterpret_cast<const __m128i *>(in + idx));
+    __m128i vgen =
+        _mm_loadu_si128(reinterpret_cast<const __m128i *>(gen + idx));
+    __m128i vkill =
+        _mm_loadu_si128(reinterpret_cast<const __m128i *>(kill + idx));
+    __m128i vold = _mm_loadu_si128(reinterpret_cast<const __m128i *>(out + idx));
+    // _mm_andnot_si128(a, b) = ~a & b
+    __m128i word = _mm_or_si128(vgen, _mm_andnot_si128(vkill, vin));
+    diff = _mm_or_si128(diff, _mm_xor_si128(word, vold));
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(out + idx), word);
+  }
+  bool changed =
+      _mm_movemask_epi8(_mm_cmpeq_epi8(diff, _mm_setzero_si128())) != 0xFFFF;
+  return transferScalar(out + idx, in + idx, gen + idx, kill + idx,
+                        num_words - idx) ||
+         changed;
+}
+
+__attribute__((target("avx2"))) bool
+transferAVX2(word_t *out, const word_t *in, const word_t *gen,
+             const word_t *kill, size_t num_words) {
+  __m256i diff = _mm256_setzero_si256();
+  size_t idx = 0;
+  for (; idx + 4 <= num_words; idx += 4) {
+    __m256i vin =
+        _mm256_loadu_si256(reinterpret_cast<const __m256i *>(in + idx));
+    __m256i vgen =
+        _mm256_loadu_si256(reinterpret_cast<const __m256i *>(gen + idx));
+    __m256i vkill =
+        _mm256_loadu_si256(reinterpret_cast<const __m256i *>(kill + idx));
+    __m256i vold =
+        _mm256_loadu_si256(reinterpret_cast<const __m256i *>(out + idx));
+    __m256i word = _mm256_or_si256(vgen, _mm256_andnot_si256(vkill, vin));
+    diff = _mm256_or_si256(diff, _mm256_xor_si256(word, vold));
+    _mm256_storeu_si256(reinterpret_cast<__m256i *>(out + idx), word);
+  }
+  bool changed = !_mm256_testz_si256(diff, diff);
+  return transferScalar(out + idx, in + idx, gen + idx, kill + idx,
+                        num_words - idx) ||
+         changed;
+}
+#endif
+
+typedef bool (*kernel_t)(word_t *, const word_t *, const word_t *,
+                         const word_t *, size_t);
+
+kernel_t getKernel(KernelKind kind) {
+  switch (kind) {
+#ifdef DFA_X86_KERNELS
+  case KernelKind::AVX2:
+    return transferAVX2;
+  case KernelKind::SSE2:
+    return transferSSE2;
+#endif
+  default:
+    return transferScalar;
+  }
+}
+
+} // namespace
+
+bool isKernelSupported(KernelKind kind) {
+  switch (kind) {
+  case KernelKind::Scalar:
+    return true;
+#ifdef DFA_X86_KERNELS
+  case KernelKind::SSE2:
+    return true;
+  case KernelKind::AVX2:
+    return __builtin_cpu_supports("avx2");
+#endif
+  default:
+    return false;
+  }
+}
+
+KernelKind getBestKernel() {
+  static const KernelKind best =
+      isKernelSupported(KernelKind::AVX2)   ? KernelKind::AVX2
+      : isKernelSupported(KernelKind::SSE2) ? KernelKind::SSE2
+                                            : KernelKind::Scalar;
+  return best;
+}
+
+const char *getKernelName(KernelKind kind) {
+  switch (kind) {
+  case KernelKind::Scalar:
+    return "scalar";
+  case KernelKind::SSE2:
+    return "sse2";
+  case KernelKind::AVX2:
+    return "avx2";
+  }
+  return "unknown";
+}
+
+bool transferWords(KernelKind kind, word_t *out, const word_t *in,
+                   const word_t *gen, const word_t *kill, size_t num_words) {
+  assert(isKernelSupported(kind) && "当前 CPU 不支持该版本");
+  return getKernel(kind)(out, in, gen, kill, num_words);
+}
+
+bool transferWords(word_t *out, const word_t *in, const word_t *gen,
+                   const word_t *kill, size_t num_words) {
+  static const kernel_t kernel = getKernel(getBestKernel());
+  return kernel(out, in, gen, kill, num_words);
+}
+
+} // namespace dfa
@@ -0,0 +1,241 @@
+// dfa::Framework 的集合存储：SetMatrix 与稠密表示的 BlockSets
+#include "cscd70/blocksets.h"
+
+#include <algorithm>
+
+#include <llvm/Config/llvm-config.h>
+#include <llvm/Support/MathExtras.h>
+
+namespace dfa {
+
+namespace {
+// LLVM 16 起 countTrailingZeros 被 llvm/ADT/bit.h 中的 countr_zero 取代
+#if LLVM_VERSION_MAJOR >= 16
+unsigned lowestBit(word_t word) { return llvm::countr_zero(word); }
+#else
+unsigned lowestBit(word_t word) { return llvm::countTrailingZeros(word); }
+#endif
+} // namespace
+
+//-----------------------------------------------------------------------------
+// SetMatrix
+//-----------------------------------------------------------------------------
+void SetMatrix::setRow(unsigned r, const llvm::BitVector &bv) {
+  assert(bv.size() == _num_bits && "比特向量的大小必须等于列数");
+  llvm::ArrayRef<word_t> words = bv.getData();
+  std::copy(words.begin(), words.end(), row(r));
+}
+
+// BitVector 只提供只读的 getData()；bv 本身不是 const 对象，
+// 因此通过 const_cast 写入它的存储是合法的（见 transferBV）
+llvm::BitVector SetMatrix::getRow(unsigned r) const {
+  llvm::BitVector bv(_num_bits, false);
+  if (_num_words != 0) {
+    word_t *words = const_cast<word_t *>(bv.getData().data());
+    std::copy(row(r), row(r) + _num_words, words);
+  }
+  return bv;
+}
+
+void SetMatrix::copyRow(unsigned dst, unsigned src) {
+  std::copy(row(src), row(src) + _num_words, row(dst));
+}
+
+//-----------------------------------------------------------------------------
+// BlockSets<DenseSet>
+//-----------------------------------------------------------------------------
+BlockSets<DenseSet>::BlockSets(unsigned num_blocks, unsigned num_edges,
+                               unsigned domain_size, const llvm::BitVector &ic,
+                               const llvm::BitVector &bc, bool)
+    : BlockSets(num_blocks, num_edges, domain_size, ic, bc,
+                SlabSlice{std::make_shared<SetMatrix>(getNumRows(num_blocks),
+                                                      domain_size),
+                          0}) {}
+
+BlockSets<DenseSet>::BlockSets(unsigned num_blocks, unsigned num_edges,
+                               unsigned domain_size, const llvm::BitVector &ic,
+                               const llvm::BitVector &bc,
+                               const SlabSlice &slice)
+    : BlockSets(num_blocks, num_edges, domain_size, slice) {
+  setRow(icRow(), ic);
+  setRow(bcRow(), bc);
+}
+
+BlockSets<DenseSet>::BlockSets(unsigned num_blocks, unsigned num_edges,
+                               unsigned domain_size, const SlabSlice &slice)
+    : _num_blocks(num_blocks), _domain_size(domain_size), _edges(num_edges),
+      _matrix(slice.matrix), _word_offset(slice.word_offset),
+      _num_words((domain_size + SetMatrix::kWordBits - 1) /
+                 SetMatrix::kWordBits) {
+  assert(_matrix->getNumRows() == getNumRows(num_blocks) &&
+         _word_offset + _num_words <= _matrix->getNumWords() &&
+         "共享矩阵的大小与基本块数或列的范围不符");
+}
+
+void BlockSets<DenseSet>::setRow(unsigned r, const llvm::BitVector &bv) {
+  assert(bv.size() == _domain_size && "比特向量的大小必须等于域的大小");
+  llvm::ArrayRef<word_t> words = bv.getData();
+  std::copy(words.begin(), words.end(), row(r));
+}
+
+// 同 SetMatrix::getRow
+llvm::BitVector BlockSets<DenseSet>::getRow(unsigned r) const {
+  llvm::BitVector bv(_domain_size, false);
+  if (_num_words != 0) {
+    word_t *words = const_cast<word_t *>(bv.getData().data());
+    std::copy(row(r), row(r) + _num_words, words);
+  }
+  return bv;
+}
+
+void BlockSets<DenseSet>::setIndices(unsigned r,
+                                     llvm::ArrayRef<unsigned> indices) {
+  std::fill(row(r), row(r) + _num_words, 0);
+  for (unsigned idx : indices) {
+    set(r, idx);
+  }
+}
+
+void BlockSets<DenseSet>::setGenKill(unsigned block,
+                                     llvm::ArrayRef<unsigned> gen,
+                                     llvm::ArrayRef<unsigned> kill) {
+  setIndices(blockRow(block, Gen), gen);
+  setIndices(blockRow(block, Kill), kill);
+}
+
+void BlockSets<DenseSet>::setEdge(unsigned edge, llvm::ArrayRef<unsigned> gen,
+                                  llvm::ArrayRef<unsigned> kill) {
+  _edges[edge].gen = gen;
+  _edges[edge].kill = kill;
+}
+
+void BlockSets<DenseSet>::resetBlock(unsigned block) {
+  setIndices(blockRow(block, Input), {});
+  copyRow(blockRow(block, Output), icRow());
+}
+
+void BlockSets<DenseSet>::takeBlock(unsigned block, BlockSets &old,
+                                    unsigned old_block,
+                                    llvm::ArrayRef<int> mapping,
+                                    unsigned old_size,
+                                    const llvm::BitVector &fill) {
+  for (Slot slot : {Input, Output}) {
+    word_t *dst = row(blockRow(block, slot));
+    const word_t *src = old.row(blockRow(old_block, slot));
+    if (mapping.empty()) {
+      std::copy(src, src + _num_words, dst);
+      continue;
+    }
+    // 逐个取出旧集合中的元素，映射到新下标
+    setRow(blockRow(block, slot), fill);
+    for (unsigned w = 0; w < old._num_words; ++w) {
+      for (word_t word = src[w]; word != 0; word &= word - 1) {
+        unsigned idx = w * SetMatrix::kWordBits + lowestBit(word);
+        assert(idx < old_size && "旧集合的高位必须为 0");
+        (void)old_size;
+        if (mapping[idx] != -1) {
+          set(blockRow(block, slot), mapping[idx]);
+        }
+      }
+    }
+  }
+}
+
+BlockSets<DenseSet>
+BlockSets<DenseSet>::extractColumns(unsigned word_begin,
+                                    unsigned word_end) const {
+  assert(word_begin < word_end && word_end <= _num_words &&
+         "切片必须是非空的字区间");
+  unsigned bit_begin = word_begin * SetMatrix::kWordBits;
+  unsigned bit_end = std::min(word_end * SetMatrix::kWordBits, _domain_size);
+  unsigned num_rows = getNumRows(_num_blocks);
+  BlockSets slice(
+      _num_blocks, _edges.size(), bit_end - bit_begin,
+      SlabSlice{std::make_shared<SetMatrix>(num_rows, bit_end - bit_begin), 0});
+  // 最后一个字中超出域的高位在原矩阵中始终为 0，整字复制即可
+  for (unsigned r = 0; r < num_rows; ++r) {
+    std::copy(row(r) + word_begin, row(r) + word_end, slice.row(r));
+  }
+
+  // 先确定每条边在 _edge_indices 中的区间，填完之后再建立引用
+  auto inRange = [=](unsigned idx) { return idx >= bit_begin && idx < bit_end; };
+  std::vector<unsigned> edge_begin;
+  edge_begin.reserve(_edges.size() * 2 + 1);
+  for (const EdgeAdjust &edge : _edges) {
+    for (llvm::ArrayRef<unsigned> indices : {edge.gen, edge.kill}) {
+      edge_begin.push_back(slice._edge_indices.size());
+      for (unsigned idx : indices) {
+        if (inRange(idx)) {
+          slice._edge_indices.push_back(idx - bit_begin);
+        }
+      }
+    }
+  }
+  edge_begin.push_back(slice._edge_indices.size());
+  llvm::ArrayRef<unsigned> all(slice._edge_indices);
+  for (unsigned edge = 0; edge < _edges.size(); ++edge) {
+    unsigned gen = edge_begin[edge * 2], kill = edge_begin[edge * 2 + 1],
+             end = edge_begin[edge * 2 + 2];
+    slice._edges[edge].gen = all.slice(gen, kill - gen);
+    slice._edges[edge].kill = all.slice(kill, end - kill);
+  }
+  return slice;
+}
+
+void BlockSets<DenseSet>::storeColumns(const BlockSets &slice,
+                                       unsigned word_begin) {
+  assert(slice._num_blocks == _num_blocks &&
+         word_begin + slice._num_words <= _num_words &&
+         "切片与原集合的形状不符");
+  for (unsigned block = 0; block < _num_blocks; ++block) {
+    for (Slot slot : {Input, Output}) {
+      const word_t *src = slice.row(blockRow(block, slot));
+      std::copy(src, src + slice._num_words,
+                row(blockRow(block, slot)) + word_begin);
+    }
+  }
+}
+
+template <typename TMeet>
+bool BlockSets<DenseSet>::visit(unsigned block,
+                                llvm::ArrayRef<unsigned> operands,
+                                llvm::ArrayRef<int> edges) {
+  size_t num_words = _num_words;
+  word_t *input = row(blockRow(block, Input));
+  if (operands.empty()) {
+    std::copy(row(bcRow()), row(bcRow()) + num_words, input);
+  }
+  word_t *tmp = row(tmpRow());
+  for (unsigned k = 0; k < operands.size(); ++k) {
+    const word_t *contrib = row(blockRow(operands[k], Output));
+    if (edges[k] != -1) {
+      // 边上的调整只涉及少数几个元素，在副本上逐位修改
+      const EdgeAdjust &edge = _edges[edges[k]];
+      std::copy(contrib, contrib + num_words, tmp);
+      for (unsigned idx : edge.kill) {
+        tmp[idx / SetMatrix::kWordBits] &=
+            ~(word_t(1) << (idx % SetMatrix::kWordBits));
+      }
+      for (unsigned idx : edge.gen) {
+        tmp[idx / SetMatrix::kWordBits] |= word_t(1) << (idx % SetMatrix::kWordBits);
+      }
+      contrib = tmp;
+    }
+    if (k == 0) {
+      std::copy(contrib, contrib + num_words, input);
+    } else {
+      TMeet::apply(input, contrib, num_words);
+    }
+  }
+  return transferWords(row(blockRow(block, Output)), input,
+                       row(blockRow(block, Gen)), row(blockRow(block, Kill)),
+                       num_words);
+}
+
+template bool BlockSets<DenseSet>::visit<UnionMeet>(unsigned,
+                                                    llvm::ArrayRef<unsigned>,
+                                                    llvm::ArrayRef<int>);
+template bool BlockSets<DenseSet>::visit<IntersectMeet>(
+    unsigned, llvm::ArrayRef<unsigned>, llvm::ArrayRef<int>);
+
+} // namespace dfa
@@ -0,0 +1,380 @@
+// dfa::Framework 结果的磁盘缓存：函数体的结构哈希与缓存文件的读写
+#include "cscd70/cache.h"
+
+#include <llvm/ADT/DenseMap.h>
+#include <llvm/ADT/SmallString.h>
+#include <llvm/ADT/Statistic.h>
+#include <llvm/IR/Constants.h>
+#include <llvm/IR/Instructions.h>
+#include <llvm/IR/Module.h>
+#include <llvm/IR/ModuleSlotTracker.h>
+#include <llvm/Support/Endian.h>
+#include <llvm/Support/FileSystem.h>
+#include <llvm/Support/LEB128.h>
+#include <llvm/Support/MD5.h>
+#include <llvm/Support/MemoryBuffer.h>
+#include <llvm/Support/Path.h>
+
+#include "cscd70/framework.h"
+
+#define DEBUG_TYPE "dfa-cache"
+
+STATISTIC(NumCacheHits, "Number of functions whose dataflow results were "
+                        "loaded from the cache");
+STATISTIC(NumCacheMisses, "Number of functions solved because their "
+                          "dataflow results were not in the cache");
+STATISTIC(NumCacheStores, "Number of dataflow results written to the cache");
+
+namespace dfa {
+
+cl::opt<std::string>
+    DFACacheDir("dfa-cache-dir",
+                cl::desc("Directory that caches dfa::Framework results per "
+                         "function, keyed by a structural hash of the "
+                         "function body (default: no cache)"),
+                cl::value_desc("directory"), cl::init(""));
+
+namespace {
+// 缓存文件格式的版本，与分析的版本无关；格式改变时增加
+constexpr uint32_t kCacheFormat = 3;
+
+// 函数体的结构哈希（MD5）：依次编码函数类型、各基本块的指令数以及每条指令
+// 的操作码、类型、可选标志（nsw/exact 等）、附加的类型或谓词与操作数。
+// 操作数中的参数、基本块与指令按在函数中的编号编码，整数常量按位宽与值，
+// 全局值按名字（无名的按在模块的全局变量、函数或别名列表中的位置），其他
+// 常量按带模块的文本（无名全局值打印为槽号而不是 <badref>）；类型第一次出现时编码文本，之后只编码按出现
+// 顺序分配的编号。因此结果与值的名字以及进程无关（不使用指针或 hash_code）。
+// 整数以 ULEB128 编码，直接追加到缓冲区（raw_svector_ostream 每次写入都
+// 有虚调用，逐字节写入时占了大部分时间），最后一次性计算 MD5。
+// 不覆盖元数据、对齐与调用属性，钩子依赖这些内容的分析不应使用缓存
+class StructuralHasher {
+public:
+  explicit StructuralHasher(const Function &func)
+      : _func(func), _slots(func.getParent(), false) {
+    unsigned num_insts = func.getInstructionCount();
+    _local.reserve(func.arg_size() + func.size() + num_insts);
+    _buffer.reserve(num_insts * 16);
+    unsigned id = 0;
+    for (const Argument &arg : func.args()) {
+      _local[&arg] = id++;
+    }
+    for (const BasicBlock &bb : func) {
+      _local[&bb] = id++;
+      for (const Instruction &inst : bb) {
+        _local[&inst] = id++;
+      }
+    }
+  }
+
+  MD5::MD5Result hash(StringRef analysis, unsigned version) {
+    addString(analysis);
+    addInt(version);
+    addType(_func.getFunctionType());
+    for (const BasicBlock &bb : _func) {
+      addInt(bb.size());
+      for (const Instruction &inst : bb) {
+        addInst(inst);
+      }
+    }
+    MD5 md5;
+    md5.update(_buffer);
+    MD5::MD5Result result;
+    md5.final(result);
+    return result;
+  }
+
+private:
+  void addInt(uint64_t value) {
+    uint8_t bytes[16];
+    unsigned size = encodeULEB128(value, bytes);
+    _buffer.append(bytes, bytes + size);
+  }
+  void addString(StringRef str) {
+    addInt(str.size());
+    _buffer.append(str.begin(), str.end());
+  }
+  void addType(Type *type) {
+    auto result = _types.try_emplace(type, _types.size());
+    addInt(result.first->second);
+    if (result.second) {
+      std::string str;
+      raw_string_ostream type_os(str);
+      type->print(type_os);
+      type_os.flush();
+      addString(str);
+    }
+  }
+
+  void addInst(const Instruction &inst) {
+    addInt(inst.getOpcode());
+    addType(inst.getType());
+    addInt(inst.getRawSubclassOptionalData());
+    if (const auto *cmp = dyn_cast<CmpInst>(&inst)) {
+      addInt(cmp->getPredicate());
+    } else if (const auto *alloca = dyn_cast<AllocaInst>(&inst)) {
+      addType(alloca->getAllocatedType());
+    } else if (const auto *gep = dyn_cast<GetElementPtrInst>(&inst)) {
+      addType(gep->getSourceElementType());
+    } else if (const auto *call = dyn_cast<CallBase>(&inst)) {
+      addType(call->getFunctionType());
+    } else if (const auto *extract = dyn_cast<ExtractValueInst>(&inst)) {
+      for (unsigned idx : extract->indices()) {
+        addInt(idx);
+      }
+    } else if (const auto *insert = dyn_cast<InsertValueInst>(&inst)) {
+      for (unsigned idx : insert->indices()) {
+        addInt(idx);
+      }
+    } else if (const auto *shuffle = dyn_cast<ShuffleVectorInst>(&inst)) {
+      for (int elem : shuffle->getShuffleMask()) {
+        addInt(elem);
+      }
+    }
+    addInt(inst.getNumOperands());
+    for (const Value *operand : inst.operand_values()) {
+      addOperand(operand);
+    }
+    // phi 的来源基本块不是操作数
+    if (const auto *phi = dyn_cast<PHINode>(&inst)) {
+      for (const BasicBlock *bb : phi->blocks()) {
+        addOperand(bb);
+      }
+    }
+  }
+
+  void addOperand(const Value *value) {
+    auto iter = _local.find(value);
+    if (iter != _local.end()) {
+      addInt('L');
+      addInt(iter->second);
+      return;
+    }
+    if (const auto *constant = dyn_cast<ConstantInt>(value)) {
+      addInt('K');
+      addType(constant->getType());
+      const APInt &apint = constant->getValue();
+      for (unsigned w = 0; w < apint.getNumWords(); ++w) {
+        addInt(apint.getRawData()[w]);
+      }
+      return;
+    }
+    if (const auto *global = dyn_cast<GlobalValue>(value)) {
+      addInt('G');
+      if (global->hasName()) {
+        addString(global->getName());
+      } else {
+        addString("");
+        addInt(getUnnamedGlobalID(global));
+      }
+      return;
+    }
+    // 其余的常量、元数据与内联汇编按文本编码
+    addInt('C');
+    addType(value->getType());
+    std::string str;
+    raw_string_ostream value_os(str);
+    value->printAsOperand(value_os, false, _slots);
+    value_os.flush();
+    addString(str);
+  }
+
+  // 无名全局值的编号：种类与在所属列表中的位置，第一次用到时才编号
+  unsigned getUnnamedGlobalID(const GlobalValue *global) {
+    if (_unnamed.empty() && _func.getParent() != nullptr) {
+      const Module &module = *_func.getParent();
+      unsigned idx = 0;
+      for (const GlobalVariable &var : module.globals()) {
+        _unnamed[&var] = idx++ * 4;
+      }
+      idx = 0;
+      for (const Function &func : module) {
+        _unnamed[&func] = idx++ * 4 + 1;
+      }
+      idx = 0;
+      for (const GlobalAlias &alias : module.aliases()) {
+        _unnamed[&alias] = idx++ * 4 + 2;
+      }
+      idx = 0;
+      for (const GlobalIFunc &ifunc : module.ifuncs()) {
+        _unnamed[&ifunc] = idx++ * 4 + 3;
+      }
+    }
+    auto iter = _unnamed.find(global);
+    return iter == _unnamed.end() ? ~0U : iter->second;
+  }
+
+  const Function &_func;
+  // 打印常量时复用，模块的槽号只计算一次
+  ModuleSlotTracker _slots;
+  DenseMap<const Value *, unsigned> _local;
+  DenseMap<const GlobalValue *, unsigned> _unnamed;
+  DenseMap<Type *, unsigned> _types;
+  SmallVector<uint8_t, 0> _buffer;
+};
+
+// 集合的两种编码，写入时取较短的一种
+enum SetEncoding : uint8_t { DenseWords = 0, SparseDeltas = 1 };
+
+uint32_t readU32(const char *&pos) {
+  uint32_t value = support::endian::read32le(pos);
+  pos += 4;
+  return value;
+}
+
+// 按 [pos, end) 解码一个集合；数据越界或元素超出域时返回 false
+bool readSet(const char *&pos, const char *end, BitVector &bv) {
+  if (pos == end) {
+    return false;
+  }
+  uint8_t encoding = *pos++;
+  unsigned num_words = bv.getData().size();
+  if (encoding == DenseWords) {
+    if (size_t(end - pos) < size_t(num_words) * 8) {
+      return false;
+    }
+    // 同 SetMatrix::getRow，直接写入 BitVector 的存储字
+    word_t *words = const_cast<word_t *>(bv.getData().data());
+    for (unsigned w = 0; w < num_words; ++w) {
+      words[w] = support::endian::read64le(pos);
+      pos += 8;
+    }
+    // 高位必须为 0，否则之后的 count() 等操作会出错
+    return bv.size() % 64 == 0 || num_words == 0 ||
+           (words[num_words - 1] >> (bv.size() % 64)) == 0;
+  }
+  if (encoding != SparseDeltas) {
+    return false;
+  }
+  const char *error = nullptr;
+  unsigned size;
+  auto next = [&]() {
+    uint64_t value = decodeULEB128(reinterpret_cast<const uint8_t *>(pos),
+                                   &size, reinterpret_cast<const uint8_t *>(end),
+                                   &error);
+    pos += size;
+    return value;
+  };
+  uint64_t count = next();
+  uint64_t idx = 0;
+  for (uint64_t k = 0; k < count && !error; ++k) {
+    // 第一个元素直接存下标，之后存与前一个元素的差
+    idx += next() + (k == 0 ? 0 : 1);
+    if (error || idx >= bv.size()) {
+      return false;
+    }
+    bv.set(idx);
+  }
+  return !error;
+}
+
+// 元素较少时存递增下标之差的 ULEB128，否则存全部的字
+void writeSet(raw_ostream &OS, const BitVector &bv) {
+  unsigned count = bv.count();
+  // 每个差值按 2 字节估计
+  if (size_t(count) * 2 >= bv.getData().size() * 8) {
+    OS << char(DenseWords);
+    for (word_t word : bv.getData()) {
+      writeLE(OS, word, 8);
+    }
+    return;
+  }
+  OS << char(SparseDeltas);
+  encodeULEB128(count, OS);
+  int prev = -1;
+  for (unsigned idx : bv.set_bits()) {
+    encodeULEB128(prev == -1 ? idx : idx - prev - 1, OS);
+    prev = idx;
+  }
+}
+} // namespace
+
+std::string getCachePath(const Function &F, StringRef analysis,
+                         unsigned version) {
+  if (DFACacheDir.empty() || analysis.empty()) {
+    return "";
+  }
+  MD5::MD5Result digest = StructuralHasher(F).hash(analysis, version);
+  SmallString<128> path(DFACacheDir.getValue());
+  sys::path::append(path, analysis + "-" + digest.digest() + ".dfa");
+  return std::string(path.str());
+}
+
+// 文件格式（小端序）：
+//   "DFAC", u32 格式版本, u32 集合表示, u32 基本块数, u32 域大小，
+//   随后每个基本块依次为输入与输出集合。每个集合以 1 字节的编码开头：
+//   DenseWords 之后为全部的 u64 字，SparseDeltas 之后为 ULEB128 的元素数
+//   与递增下标之差（见 writeSet）。较大的域中每个集合通常只有少数元素，
+//   稀疏编码使文件与读取的时间都小得多
+bool loadCachedSets(StringRef path, unsigned num_blocks, unsigned domain_size,
+                    CachedSets &sets) {
+  ErrorOr<std::unique_ptr<MemoryBuffer>> buffer = MemoryBuffer::getFile(path);
+  if (!buffer || (*buffer)->getBufferSize() < 4 + 4 * 4 ||
+      !(*buffer)->getBuffer().startswith("DFAC")) {
+    ++NumCacheMisses;
+    return false;
+  }
+  const char *pos = (*buffer)->getBufferStart() + 4,
+             *end = (*buffer)->getBufferEnd();
+  uint32_t format = readU32(pos), set_kind = readU32(pos),
+           file_blocks = readU32(pos), file_domain = readU32(pos);
+  if (format != kCacheFormat || set_kind > uint32_t(SetKind::Chunked) ||
+      file_blocks != num_blocks || file_domain != domain_size) {
+    ++NumCacheMisses;
+    return false;
+  }
+
+  sets.set_kind = SetKind(set_kind);
+  sets.inputs.assign(num_blocks, BitVector(domain_size));
+  sets.outputs.assign(num_blocks, BitVector(domain_size));
+  for (unsigned block = 0; block < num_blocks; ++block) {
+    if (!readSet(pos, end, sets.inputs[block]) ||
+        !readSet(pos, end, sets.outputs[block])) {
+      ++NumCacheMisses;
+      return false;
+    }
+  }
+  if (pos != end) {
+    ++NumCacheMisses;
+    return false;
+  }
+  ++NumCacheHits;
+  return true;
+}
+
+void storeCachedSets(StringRef path, const CachedSets &sets) {
+  if (sys::fs::create_directories(sys::path::parent_path(path))) {
+    return;
+  }
+  unsigned num_blocks = sets.inputs.size();
+  unsigned domain_size = num_blocks == 0 ? 0 : sets.inputs.front().size();
+
+  int fd;
+  SmallString<128> tmp_path;
+  if (sys::fs::createUniqueFile(path + ".tmp-%%%%%%%%", fd, tmp_path)) {
+    return;
+  }
+  {
+    raw_fd_ostream OS(fd, /*shouldClose=*/true);
+    OS << "DFAC";
+    for (uint32_t value :
+         {kCacheFormat, uint32_t(sets.set_kind), num_blocks, domain_size}) {
+      writeLE(OS, value, 4);
+    }
+    for (unsigned block = 0; block < num_blocks; ++block) {
+      writeSet(OS, sets.inputs[block]);
+      writeSet(OS, sets.outputs[block]);
+    }
+    if (OS.has_error()) {
+      OS.clear_error();
+      sys::fs::remove(tmp_path);
+      return;
+    }
+  }
+  if (sys::fs::rename(tmp_path, path)) {
+    sys::fs::remove(tmp_path);
+    return;
+  }
+  ++NumCacheStores;
+}
+
+} // namespace dfa
@@ -0,0 +1,262 @@
+// 稀疏条件常量传播（SCCP），建立在 dfa::LatticeFramework 之上
+#include "ConstProp.h"
+#include "FunctionSummary.h"
+
+#include <llvm/ADT/Statistic.h>
+#include <llvm/Analysis/ConstantFolding.h>
+#include <llvm/IR/CFG.h>
+#include <llvm/Transforms/Utils/BasicBlockUtils.h>
+#include <llvm/Transforms/Utils/Local.h>
+
+#define DEBUG_TYPE "dfa-sccp"
+
+STATISTIC(NumInstsFolded, "Number of instructions replaced by constants");
+STATISTIC(NumBranchesFolded, "Number of branches and switches whose "
+                             "infeasible successors were removed");
+STATISTIC(NumBlocksDeleted, "Number of unreachable blocks deleted");
+
+ConstantPropagation::value_t
+ConstantPropagation::ExternalValue(const solver_t &,
+                                   const Value &val) const {
+  // 形参、内联汇编等不是常量
+  if (const auto *constant = dyn_cast<Constant>(&val)) {
+    return ConstantLattice::constant(const_cast<Constant *>(constant));
+  }
+  return ConstantLattice::overdefined();
+}
+
+ConstantPropagation::value_t
+ConstantPropagation::Transfer(const solver_t &solver,
+                              const Instruction &inst) const {
+  // 条件已知时 select 只取一个操作数，另一个操作数不是常量也没有关系
+  if (const auto *select = dyn_cast<SelectInst>(&inst)) {
+    value_t cond = solver.getValue(select->getCondition());
+    if (cond.kind == ConstantLattice::Bottom) {
+      return cond;
+    }
+    if (auto *cond_int = dyn_cast_or_null<ConstantInt>(cond.constant)) {
+      return solver.getValue(cond_int->isZero() ? select->getFalseValue()
+                                                : select->getTrueValue());
+    }
+    value_t value = solver.getValue(select->getTrueValue());
+    ConstantLattice::join(value, solver.getValue(select->getFalseValue()));
+    return value;
+  }
+  // 被调用者总是返回常量或原样返回实参时，调用的值由摘要得出。
+  // 从不返回的被调用者（returned 为 Bottom）按不透明的调用处理
+  if (const auto *call = dyn_cast<CallBase>(&inst); call && _summaries) {
+    const FunctionSummary *callee = lookupCallee(*call, *_summaries);
+    if (callee && (callee->returned.kind != ConstantLattice::Bottom ||
+                   callee->returned_args.any())) {
+      value_t value = callee->returned;
+      for (unsigned arg : callee->returned_args.set_bits()) {
+        ConstantLattice::join(value, solver.getValue(call->getArgOperand(arg)));
+      }
+      return value;
+    }
+  }
+  // 内存中的值不在格中；带 operand bundle 的调用的操作数与实参不一一对应
+  if (isa<LoadInst>(&inst) || isa<AllocaInst>(&inst) ||
+      (isa<CallBase>(&inst) && cast<CallBase>(&inst)->hasOperandBundles())) {
+    return ConstantLattice::overdefined();
+  }
+
+  SmallVector<Constant *, 4> operands;
+  bool pending = false;
+  for (const Value *operand : inst.operand_values()) {
+    value_t value = solver.getValue(operand);
+    if (value.kind == ConstantLattice::Overdefined) {
+      return value;
+    }
+    // 有操作数尚未求得时先保持 Bottom，它变化时会重新求值
+    pending |= value.kind == ConstantLattice::Bottom;
+    operands.push_back(value.constant);
+  }
+  if (pending) {
+    return ConstantLattice::bottom();
+  }
+  Constant *folded = nullptr;
+  if (const auto *cmp = dyn_cast<CmpInst>(&inst)) {
+    folded = ConstantFoldCompareInstOperands(cmp->getPredicate(), operands[0],
+                                             operands[1], _dl, _tli);
+  } else {
+    folded = ConstantFoldInstOperands(const_cast<Instruction *>(&inst),
+                                      operands, _dl, _tli);
+  }
+  return folded ? ConstantLattice::constant(folded)
+                : ConstantLattice::overdefined();
+}
+
+void ConstantPropagation::FeasibleSuccessors(
+    const solver_t &solver, const Instruction &term,
+    SmallVectorImpl<const BasicBlock *> &succs) const {
+  const Value *cond = nullptr;
+  if (const auto *br = dyn_cast<BranchInst>(&term)) {
+    cond = br->isConditional() ? br->getCondition() : nullptr;
+  } else if (const auto *sw = dyn_cast<SwitchInst>(&term)) {
+    cond = sw->getCondition();
+  }
+  if (cond) {
+    value_t value = solver.getValue(cond);
+    // 条件尚未求得时暂时没有可行的后继
+    if (value.kind == ConstantLattice::Bottom) {
+      return;
+    }
+    // undef 等不是 ConstantInt 的常量按未知处理
+    if (const auto *cond_int = dyn_cast_or_null<ConstantInt>(value.constant)) {
+      if (const auto *br = dyn_cast<BranchInst>(&term)) {
+        succs.push_back(br->getSuccessor(cond_int->isZero() ? 1 : 0));
+      } else {
+        const auto *sw = cast<SwitchInst>(&term);
+        succs.push_back(sw->findCaseValue(cond_int)->getCaseSuccessor());
+      }
+      return;
+    }
+  }
+  LatticeFramework::FeasibleSuccessors(solver, term, succs);
+}
+
+//-----------------------------------------------------------------------------
+// New PM implementation
+//-----------------------------------------------------------------------------
+PreservedAnalyses ConstPropPass::run(Function &F,
+                                     FunctionAnalysisManager &FAM) {
+  const TargetLibraryInfo &TLI = FAM.getResult<TargetLibraryAnalysis>(F);
+  return transform(
+      F, ConstantPropagation(F.getParent()->getDataLayout(), &TLI), TLI);
+}
+
+PreservedAnalyses ModuleConstPropPass::run(Module &M,
+                                           ModuleAnalysisManager &MAM) {
+  const FunctionSummaries &summaries =
+      MAM.getResult<FunctionSummaryAnalysis>(M);
+  FunctionAnalysisManager &FAM =
+      MAM.getResult<FunctionAnalysisManagerModuleProxy>(M).getManager();
+  // 变换保持语义，因此其他函数的摘要依然成立，所有函数共用一份摘要。
+  // 变换会创建常量，不是线程安全的，函数依次处理
+  bool changed = false;
+  for (Function &F : M) {
+    if (F.isDeclaration()) {
+      continue;
+    }
+    const TargetLibraryInfo &TLI = FAM.getResult<TargetLibraryAnalysis>(F);
+    PreservedAnalyses PA = ConstPropPass::transform(
+        F, ConstantPropagation(M.getDataLayout(), &TLI, &summaries), TLI);
+    if (!PA.areAllPreserved()) {
+      FAM.invalidate(F, PA);
+      changed = true;
+    }
+  }
+  if (!changed) {
+    return PreservedAnalyses::all();
+  }
+  // 函数上的分析已经逐个失效
+  PreservedAnalyses PA;
+  PA.preserve<FunctionAnalysisManagerModuleProxy>();
+  return PA;
+}
+
+PreservedAnalyses ConstPropPass::transform(Function &F,
+                                           const ConstantPropagation &analysis,
+                                           const TargetLibraryInfo &TLI) {
+  std::unique_ptr<ConstantPropagation::solver_t> solver = analysis.solve(F);
+
+  // 1. 用常量替换可执行的基本块中求得常量的指令
+  bool changed = false;
+  for (BasicBlock &bb : F) {
+    if (!solver->isExecutable(&bb)) {
+      continue;
+    }
+    for (Instruction &inst : make_early_inc_range(bb)) {
+      if (inst.getType()->isVoidTy()) {
+        continue;
+      }
+      ConstantLattice::value_t value = solver->getValue(&inst);
+      if (value.kind != ConstantLattice::Const) {
+        continue;
+      }
+      inst.replaceAllUsesWith(value.constant);
+      // 有副作用的指令（例如结果为常量的调用）只替换它的使用者
+      if (isInstructionTriviallyDead(&inst, &TLI)) {
+        inst.eraseFromParent();
+      }
+      ++NumInstsFolded;
+      changed = true;
+    }
+  }
+
+  // 2. 去掉可执行的基本块中不可执行的出边
+  bool cfg_changed = false;
+  for (BasicBlock &bb : F) {
+    Instruction *term = bb.getTerminator();
+    if (!solver->isExecutable(&bb) ||
+        !(isa<BranchInst>(term) || isa<SwitchInst>(term))) {
+      continue;
+    }
+    SmallVector<BasicBlock *, 2> feasible;
+    bool pruned = false;
+    for (BasicBlock *succ : successors(&bb)) {
+      if (!solver->isEdgeExecutable(&bb, succ)) {
+        pruned = true;
+      } else if (!is_contained(feasible, succ)) {
+        feasible.push_back(succ);
+      }
+    }
+    if (!pruned) {
+      continue;
+    }
+    if (feasible.empty()) {
+      // 条件在不动点处仍未求得，只可能来自未定义的值
+      changeToUnreachable(term);
+    } else if (feasible.size() == 1) {
+      // 保留到可行后继的一条边，其余的边（包括指向它的重复边）从后继的 phi
+      // 中删去
+      bool kept = false;
+      for (BasicBlock *succ : successors(&bb)) {
+        if (succ == feasible.front() && !kept) {
+          kept = true;
+          continue;
+        }
+        succ->removePredecessor(&bb);
+      }
+      BranchInst::Create(feasible.front(), term);
+      term->eraseFromParent();
+    } else {
+      // switch 有多个可行后继时只能删去不可行的分支，默认分支保留
+      auto *sw = cast<SwitchInst>(term);
+      for (auto iter = sw->case_begin(); iter != sw->case_end();) {
+        BasicBlock *succ = iter->getCaseSuccessor();
+        if (solver->isEdgeExecutable(&bb, succ)) {
+          ++iter;
+          continue;
+        }
+        succ->removePredecessor(&bb);
+        iter = sw->removeCase(iter);
+      }
+    }
+    ++NumBranchesFolded;
+    cfg_changed = true;
+  }
+
+  // 3. 删除不可执行的基本块
+  SmallVector<BasicBlock *, 8> dead;
+  for (BasicBlock &bb : F) {
+    if (!solver->isExecutable(&bb)) {
+      dead.push_back(&bb);
+    }
+  }
+  if (!dead.empty()) {
+    NumBlocksDeleted += dead.size();
+    DeleteDeadBlocks(dead);
+    cfg_changed = true;
+  }
+
+  if (!changed && !cfg_changed) {
+    return PreservedAnalyses::all();
+  }
+  PreservedAnalyses PA;
+  if (!cfg_changed) {
+    PA.preserveSet<CFGAnalyses>();
+  }
+  return PA;
+}
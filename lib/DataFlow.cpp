@@ -0,0 +1,158 @@
+//=============================================================================
+// FILE:
+//    DataFlow.cpp
+//
+// DESCRIPTION:
+//    New PM registration of the dataflow analyses built on dfa::Framework
+//    (include/cscd70/framework.h):
+//      opt -load-pass-plugin=libDataFlow.so -passes="print<liveness>" ...
+//      opt -load-pass-plugin=libDataFlow.so -passes="print<avail-expr>" ...
+//    and of the global common subexpression elimination driven by the
+//    available expressions (include/AvailExpr.h):
+//      opt -load-pass-plugin=libDataFlow.so -passes="dfa-gcse" ...
+//    and of the SSA-based sparse liveness (include/SparseLiveness.h), which
+//    gives the same per-block sets as print<liveness>:
+//      opt -load-pass-plugin=libDataFlow.so -passes="print<sparse-liveness>" ...
+//    and of the liveness checking queries (include/LivenessQuery.h), which
+//    stay valid across instruction edits that keep the CFG:
+//      opt -load-pass-plugin=libDataFlow.so -passes="print<liveness-query>" ...
+//    and of the transforms built on dfa::LatticeFramework
+//    (include/cscd70/lattice.h):
+//      opt -load-pass-plugin=libDataFlow.so -passes="dfa-sccp" ...
+//    and of the stack slot coloring built on two slot-level analyses
+//    (include/StackColoring.h); -pass-remarks=dfa-stack-coloring reports the
+//    frame bytes saved per function:
+//      opt -load-pass-plugin=libDataFlow.so -passes="dfa-stack-coloring" ...
+//    and of the register pressure estimate built on the liveness results
+//    (include/RegPressure.h), printed per block and per loop, or reported for
+//    loops over the target's register count with
+//    -pass-remarks-analysis=dfa-reg-pressure:
+//      opt -load-pass-plugin=libDataFlow.so -passes="print<reg-pressure>" ...
+//      opt -load-pass-plugin=libDataFlow.so -passes="dfa-reg-pressure" ...
+//    The interprocedural mode computes bottom-up function summaries over the
+//    call graph SCCs (include/cscd70/interproc.h) and applies them at calls:
+//      opt -load-pass-plugin=libDataFlow.so -passes="print<dfa-summaries>" ...
+//      opt -load-pass-plugin=libDataFlow.so -passes="dfa-ipsccp" ...
+//    The analyses themselves can be requested from other passes through
+//    FAM.getResult<LivenessAnalysis>(F) / FAM.getResult<AvailExprAnalysis>(F).
+//    Results are printed as text unless -dfa-print selects another format
+//    (summary, jsonl, binary); add -load=libDataFlow.so so that opt knows the
+//    option. The legacy passes (-liveness, -avail_expr) print nothing unless
+//    -dfa-print is given, and write to -dfa-output (default: stdout).
+//
+// License: MIT
+//=============================================================================
+#include "AvailExpr.h"
+#include "ConstProp.h"
+#include "FunctionSummary.h"
+#include "Liveness.h"
+#include "LivenessQuery.h"
+#include "RegPressure.h"
+#include "SparseLiveness.h"
+#include "StackColoring.h"
+
+#include "llvm/Passes/PassBuilder.h"
+#include "llvm/Passes/PassPlugin.h"
+
+using namespace llvm;
+
+//-----------------------------------------------------------------------------
+// New PM Registration
+//-----------------------------------------------------------------------------
+llvm::PassPluginLibraryInfo getDataFlowPluginInfo() {
+  return {
+      LLVM_PLUGIN_API_VERSION, "DataFlow", LLVM_VERSION_STRING,
+      [](PassBuilder &PB) {
+        // "opt -passes=print<liveness>" 以及 require<>/invalidate<>
+        PB.registerPipelineParsingCallback(
+            [&](StringRef Name, FunctionPassManager &FPM,
+                ArrayRef<PassBuilder::PipelineElement>) {
+              if (Name == "print<liveness>") {
+                FPM.addPass(LivenessPrinter(llvm::errs()));
+                return true;
+              }
+              if (Name == "print<avail-expr>") {
+                FPM.addPass(AvailExprPrinter(llvm::errs()));
+                return true;
+              }
+              if (Name == "print<sparse-liveness>") {
+                FPM.addPass(SparseLivenessPrinter(llvm::errs()));
+                return true;
+              }
+              if (Name == "print<liveness-query>") {
+                FPM.addPass(LivenessQueryPrinter(llvm::errs()));
+                return true;
+              }
+              if (Name == "print<reg-pressure>") {
+                FPM.addPass(RegisterPressurePrinter(llvm::errs()));
+                return true;
+              }
+              if (Name == "dfa-gcse") {
+                FPM.addPass(GCSEPass());
+                return true;
+              }
+              if (Name == "dfa-sccp") {
+                FPM.addPass(ConstPropPass());
+                return true;
+              }
+              if (Name == "dfa-stack-coloring") {
+                FPM.addPass(StackColoringPass());
+                return true;
+              }
+              if (Name == "dfa-reg-pressure") {
+                FPM.addPass(RegisterPressureRemarks());
+                return true;
+              }
+              if (Name == "require<liveness>") {
+                FPM.addPass(RequireAnalysisPass<LivenessAnalysis, Function>());
+                return true;
+              }
+              if (Name == "require<avail-expr>") {
+                FPM.addPass(
+                    RequireAnalysisPass<AvailExprAnalysis, Function>());
+                return true;
+              }
+              if (Name == "invalidate<liveness>") {
+                FPM.addPass(InvalidateAnalysisPass<LivenessAnalysis>());
+                return true;
+              }
+              if (Name == "invalidate<avail-expr>") {
+                FPM.addPass(InvalidateAnalysisPass<AvailExprAnalysis>());
+                return true;
+              }
+              return false;
+            });
+
+        PB.registerPipelineParsingCallback(
+            [&](StringRef Name, ModulePassManager &MPM,
+                ArrayRef<PassBuilder::PipelineElement>) {
+              if (Name == "print<dfa-summaries>") {
+                MPM.addPass(FunctionSummaryPrinter(llvm::errs()));
+                return true;
+              }
+              if (Name == "dfa-ipsccp") {
+                MPM.addPass(ModuleConstPropPass());
+                return true;
+              }
+              return false;
+            });
+
+        PB.registerAnalysisRegistrationCallback(
+            [](FunctionAnalysisManager &FAM) {
+              FAM.registerPass([&] { return LivenessAnalysis(); });
+              FAM.registerPass([&] { return AvailExprAnalysis(); });
+              FAM.registerPass([&] { return SparseLivenessAnalysis(); });
+              FAM.registerPass([&] { return LivenessQueryAnalysis(); });
+              FAM.registerPass([&] { return RegisterPressureAnalysis(); });
+            });
+        PB.registerAnalysisRegistrationCallback(
+            [](ModuleAnalysisManager &MAM) {
+              MAM.registerPass([&] { return FunctionSummaryAnalysis(); });
+            });
+      }};
+}
+
+extern "C" LLVM_ATTRIBUTE_WEAK ::llvm::PassPluginLibraryInfo
+llvmGetPassPluginInfo() {
+  return getDataFlowPluginInfo();
+}
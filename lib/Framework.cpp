@@ -0,0 +1,390 @@
+// dfa::Framework 的非模板部分：命令行选项、控制流图的编号与结果输出的辅助函数
+#include "cscd70/framework.h"
+
+#include <llvm/Support/ErrorHandling.h>
+#include <llvm/Support/FileSystem.h>
+
+namespace dfa {
+
+cl::opt<SolverKind> DFASolver(
+    "dfa-solver", cl::desc("Fixpoint solver used by dfa::Framework"),
+    cl::init(SolverKind::Worklist),
+    cl::values(clEnumValN(SolverKind::RoundRobin, "round-robin",
+                          "Re-traverse every block in layout order until "
+                          "nothing changes"),
+               clEnumValN(SolverKind::Worklist, "worklist",
+                          "Visit blocks in (reverse) post-order and only "
+                          "re-queue the dependents of changed blocks"),
+               clEnumValN(SolverKind::SCC, "scc",
+                          "Iterate every (nested) strongly connected "
+                          "component of the CFG to a local fixpoint before "
+                          "leaving it")));
+
+const char *getSolverKindName(SolverKind kind) {
+  switch (kind) {
+  case SolverKind::RoundRobin:
+    return "round-robin";
+  case SolverKind::Worklist:
+    return "worklist";
+  case SolverKind::SCC:
+    return "scc";
+  }
+  return "unknown";
+}
+
+cl::opt<bool> DFALoopStats(
+    "dfa-loop-stats",
+    cl::desc("Print the loops (strongly connected components) of every "
+             "solved function with their block visits and iterations"),
+    cl::init(false));
+
+cl::opt<unsigned> DFADomainSlices(
+    "dfa-domain-slices",
+    cl::desc("Split the domain of dense-set problems into this many "
+             "word-aligned slices solved on separate threads (1 = off, "
+             "0 = one per hardware thread); functions solved in parallel "
+             "by a module driver are never sliced"),
+    cl::init(1));
+
+cl::opt<unsigned> DFAThreads(
+    "dfa-threads",
+    cl::desc("Number of threads used to solve the functions of a module in "
+             "parallel (0 = all hardware threads)"),
+    cl::init(0));
+
+cl::opt<SetKind> DFASet(
+    "dfa-set", cl::desc("Set representation used by dfa::Framework"),
+    cl::init(SetKind::Auto),
+    cl::values(clEnumValN(SetKind::Auto, "auto",
+                          "Choose per function from the domain size and "
+                          "estimated density"),
+               clEnumValN(SetKind::Dense, "dense", "llvm::BitVector"),
+               clEnumValN(SetKind::Sparse, "sparse", "llvm::SparseBitVector"),
+               clEnumValN(SetKind::Chunked, "chunked",
+                          "Roaring-style chunked compressed bitmap")));
+
+cl::opt<bool> DFASetStats(
+    "dfa-set-stats",
+    cl::desc("Print the estimated and peak memory of the block sets for "
+             "every solved function"),
+    cl::init(false));
+
+cl::opt<PrintFormat> DFAPrint(
+    "dfa-print",
+    cl::desc("Output format of dfa::Framework results (default: none; the "
+             "new PM print<> passes fall back to text)"),
+    cl::init(PrintFormat::None),
+    cl::values(
+        clEnumValN(PrintFormat::None, "none", "Solve only, print nothing"),
+        clEnumValN(PrintFormat::Text, "text",
+                   "Every instruction with its set, as readable text"),
+        clEnumValN(PrintFormat::Summary, "summary",
+                   "Only the IN/OUT set sizes of every block"),
+        clEnumValN(PrintFormat::JSONLines, "jsonl",
+                   "One JSON object per block/instruction with the set as "
+                   "an array of words"),
+        clEnumValN(PrintFormat::Binary, "binary",
+                   "Little-endian binary records with the set as words")));
+
+cl::opt<std::string>
+    DFAOutput("dfa-output",
+              cl::desc("File that receives the -dfa-print output of the "
+                       "legacy passes (default: stdout)"),
+              cl::value_desc("filename"), cl::init("-"));
+
+namespace {
+// 工作表求解时基本块的处理顺序：前向分析为逆后序，后向分析为后序。
+// 后序在后继邻接数组上用显式栈做深度优先搜索得到，后继的访问顺序与
+// post_order 相同；从入口不可达的基本块追加在末尾（按布局顺序），
+// 保证它们也有结果
+std::vector<unsigned> traversalOrder(ArrayRef<unsigned> succ_begin,
+                                     ArrayRef<unsigned> succs,
+                                     Direction direction) {
+  unsigned num_blocks = succ_begin.size() - 1;
+  std::vector<unsigned> order;
+  order.reserve(num_blocks);
+  if (num_blocks == 0) {
+    return order;
+  }
+  BitVector visited(num_blocks);
+  // 栈中保存基本块及其下一个待访问的后继在 succs 中的位置
+  std::vector<std::pair<unsigned, unsigned>> stack;
+  visited.set(0);
+  stack.emplace_back(0, succ_begin[0]);
+  while (!stack.empty()) {
+    auto &[block, slot] = stack.back();
+    if (slot == succ_begin[block + 1]) {
+      order.push_back(block);
+      stack.pop_back();
+      continue;
+    }
+    unsigned succ = succs[slot++];
+    if (!visited.test(succ)) {
+      visited.set(succ);
+      stack.emplace_back(succ, succ_begin[succ]);
+    }
+  }
+  if (direction == Direction::Forward) {
+    std::reverse(order.begin(), order.end());
+  }
+  for (unsigned block = 0; block < num_blocks; ++block) {
+    if (!visited.test(block)) {
+      order.push_back(block);
+    }
+  }
+  return order;
+}
+
+// 建立 ComponentOrder：在依赖图上递归地分解强连通分量（Bourdoncle 的弱拓扑
+// 序）。每一层用 Tarjan 算法求出成员间的强连通分量，按拓扑序排列；非平凡的
+// 分量以 order 中最靠前的成员为头，去掉头后在其余成员上继续分解。不依赖
+// 支配关系，因此不可归约的控制流图同样适用
+class ComponentBuilder {
+public:
+  ComponentBuilder(const CFGIndex &cfg, ComponentOrder &result)
+      : _cfg(cfg), _result(result), _stamp(cfg.blocks.size(), 0),
+        _index(cfg.blocks.size(), 0), _low(cfg.blocks.size(), 0) {
+    _result.block_component.assign(cfg.blocks.size(), -1);
+  }
+
+  // members 按 order_pos 排列；结果追加到 items
+  void decompose(ArrayRef<unsigned> members, int parent, unsigned depth,
+                 std::vector<int> &items) {
+    std::vector<std::vector<unsigned>> sccs = findSCCs(members);
+    // Tarjan 算法按逆拓扑序给出强连通分量
+    for (auto it = sccs.rbegin(); it != sccs.rend(); ++it) {
+      std::vector<unsigned> &scc = *it;
+      if (scc.size() == 1 && !hasSelfEdge(scc.front())) {
+        items.push_back(scc.front());
+        continue;
+      }
+      llvm::sort(scc, [this](unsigned lhs, unsigned rhs) {
+        return _cfg.order_pos[lhs] < _cfg.order_pos[rhs];
+      });
+      // components 在递归中会增长，只能按下标访问
+      unsigned comp = _result.components.size();
+      _result.components.push_back({scc.front(), parent, depth + 1, {}});
+      for (unsigned block : scc) {
+        _result.block_component[block] = comp;
+      }
+      items.push_back(~int(comp));
+      std::vector<int> body;
+      decompose(ArrayRef<unsigned>(scc).drop_front(), comp, depth + 1, body);
+      _result.components[comp].body = std::move(body);
+    }
+  }
+
+private:
+  bool hasSelfEdge(unsigned block) const {
+    for (unsigned slot = _cfg.dependent_begin[block];
+         slot < _cfg.dependent_begin[block + 1]; ++slot) {
+      if (_cfg.dependents[slot] == block) {
+        return true;
+      }
+    }
+    return false;
+  }
+
+  // 只沿两端都在 members 中的边搜索。_stamp 标记本次调用的成员，
+  // _index 为 0 表示尚未访问
+  std::vector<std::vector<unsigned>> findSCCs(ArrayRef<unsigned> members) {
+    ++_generation;
+    for (unsigned block : members) {
+      _stamp[block] = _generation;
+      _index[block] = 0;
+    }
+    std::vector<std::vector<unsigned>> sccs;
+    std::vector<unsigned> scc_stack;
+    BitVector on_stack(_cfg.blocks.size());
+    // 深度优先搜索的栈：基本块及其下一个待访问的依赖者在 dependents 中的位置
+    std::vector<std::pair<unsigned, unsigned>> stack;
+    unsigned next_index = 0;
+    auto enter = [&](unsigned block) {
+      _index[block] = _low[block] = ++next_index;
+      scc_stack.push_back(block);
+      on_stack.set(block);
+      stack.emplace_back(block, _cfg.dependent_begin[block]);
+    };
+    for (unsigned root : members) {
+      if (_index[root] != 0) {
+        continue;
+      }
+      enter(root);
+      while (!stack.empty()) {
+        auto &[block, slot] = stack.back();
+        if (slot < _cfg.dependent_begin[block + 1]) {
+          unsigned succ = _cfg.dependents[slot++];
+          if (_stamp[succ] != _generation) {
+            continue;
+          }
+          if (_index[succ] == 0) {
+            enter(succ);
+          } else if (on_stack.test(succ)) {
+            _low[block] = std::min(_low[block], _index[succ]);
+          }
+          continue;
+        }
+        unsigned done = block;
+        stack.pop_back();
+        if (!stack.empty()) {
+          unsigned caller = stack.back().first;
+          _low[caller] = std::min(_low[caller], _low[done]);
+        }
+        if (_low[done] != _index[done]) {
+          continue;
+        }
+        std::vector<unsigned> scc;
+        unsigned member;
+        do {
+          member = scc_stack.back();
+          scc_stack.pop_back();
+          on_stack.reset(member);
+          scc.push_back(member);
+        } while (member != done);
+        sccs.push_back(std::move(scc));
+      }
+    }
+    return sccs;
+  }
+
+  const CFGIndex &_cfg;
+  ComponentOrder &_result;
+  std::vector<unsigned> _stamp, _index, _low;
+  unsigned _generation = 0;
+};
+} // namespace
+
+std::shared_ptr<const CFGIndex>
+CFGIndex::build(const Function &func, Direction direction,
+                bool with_components) {
+  auto cfg = std::make_shared<CFGIndex>();
+  unsigned num_blocks = func.size(), num_edges = 0;
+  for (const BasicBlock &bb : func) {
+    if (const Instruction *term = bb.getTerminator()) {
+      num_edges += term->getNumSuccessors();
+    }
+  }
+  cfg->blocks.reserve(num_blocks);
+  cfg->block_index.reserve(num_blocks);
+  cfg->inst_begin.reserve(num_blocks + 1);
+  cfg->inst_index.reserve(func.getInstructionCount());
+
+  for (const BasicBlock &bb : func) {
+    cfg->block_index[&bb] = cfg->blocks.size();
+    cfg->blocks.push_back(&bb);
+    cfg->inst_begin.push_back(cfg->inst_index.size());
+    for (const Instruction &inst : bb) {
+      unsigned inst_id = cfg->inst_index.size();
+      cfg->inst_index[&inst] = inst_id;
+    }
+  }
+  cfg->inst_begin.push_back(cfg->inst_index.size());
+
+  // 后继直接由终结指令给出；前驱由后继转置得到，不再遍历基本块的 use 链表。
+  // 同一后继在终结指令中出现多次时（例如 switch），边也计入多次，
+  // 与 predecessors/successors 的行为一致
+  std::vector<unsigned> succ_begin, succs, pred_begin(num_blocks + 1, 0),
+      preds(num_edges);
+  succ_begin.reserve(num_blocks + 1);
+  succs.reserve(num_edges);
+  for (const BasicBlock *bb : cfg->blocks) {
+    succ_begin.push_back(succs.size());
+    for (const BasicBlock *succ : successors(bb)) {
+      unsigned succ_id = cfg->block_index.lookup(succ);
+      succs.push_back(succ_id);
+      ++pred_begin[succ_id + 1];
+    }
+  }
+  succ_begin.push_back(succs.size());
+  for (unsigned block = 0; block < num_blocks; ++block) {
+    pred_begin[block + 1] += pred_begin[block];
+  }
+  std::vector<unsigned> cursor(pred_begin.begin(), pred_begin.end() - 1);
+  for (unsigned block = 0; block < num_blocks; ++block) {
+    for (unsigned slot = succ_begin[block]; slot < succ_begin[block + 1];
+         ++slot) {
+      preds[cursor[succs[slot]]++] = block;
+    }
+  }
+
+  cfg->order = traversalOrder(succ_begin, succs, direction);
+  cfg->order_pos.resize(num_blocks);
+  for (unsigned pos = 0; pos < num_blocks; ++pos) {
+    cfg->order_pos[cfg->order[pos]] = pos;
+  }
+
+  if (direction == Direction::Forward) {
+    cfg->operand_begin = std::move(pred_begin);
+    cfg->operands = std::move(preds);
+    cfg->dependent_begin = std::move(succ_begin);
+    cfg->dependents = std::move(succs);
+  } else {
+    cfg->operand_begin = std::move(succ_begin);
+    cfg->operands = std::move(succs);
+    cfg->dependent_begin = std::move(pred_begin);
+    cfg->dependents = std::move(preds);
+  }
+
+  if (with_components) {
+    ComponentBuilder(*cfg, cfg->components)
+        .decompose(cfg->order, -1, 0, cfg->components.top);
+  }
+  return cfg;
+}
+
+Output::Output() {
+  if (DFAOutput != "-") {
+    std::error_code EC;
+    _file = std::make_unique<raw_fd_ostream>(
+        DFAOutput, EC,
+        DFAPrint == PrintFormat::Binary ? sys::fs::OF_None
+                                        : sys::fs::OF_TextWithCRLF);
+    if (EC) {
+      report_fatal_error("dfa: cannot open '" + Twine(DFAOutput) +
+                         "': " + EC.message());
+    }
+    _file->SetBufferSize(1 << 16);
+  }
+  if (DFAPrint == PrintFormat::Binary) {
+    os().write("DFA1", 4);
+  }
+}
+
+Output::~Output() { os().flush(); }
+
+void writeJSONString(raw_ostream &OS, StringRef str) {
+  OS << '"';
+  for (unsigned char c : str) {
+    switch (c) {
+    case '"':
+      OS << "\\\"";
+      break;
+    case '\\':
+      OS << "\\\\";
+      break;
+    case '\n':
+      OS << "\\n";
+      break;
+    case '\t':
+      OS << "\\t";
+      break;
+    default:
+      if (c < 0x20) {
+        OS << format("\\u%04x", c);
+      } else {
+        OS << c;
+      }
+    }
+  }
+  OS << '"';
+}
+
+void writeLE(raw_ostream &OS, uint64_t value, unsigned bytes) {
+  char buf[8];
+  for (unsigned idx = 0; idx < bytes; ++idx) {
+    buf[idx] = static_cast<char>(value >> (8 * idx));
+  }
+  OS.write(buf, bytes);
+}
+
+} // namespace dfa
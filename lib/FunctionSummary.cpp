@@ -0,0 +1,228 @@
+// 过程间的函数摘要
+#include "FunctionSummary.h"
+
+#include <algorithm>
+
+#include <llvm/ADT/SmallPtrSet.h>
+#include <llvm/Analysis/ValueTracking.h>
+#include <llvm/IR/InstIterator.h>
+
+const FunctionSummary *lookupCallee(const CallBase &call,
+                                    const FunctionSummaries &summaries) {
+  const Function *callee = call.getCalledFunction();
+  if (!callee || callee->getFunctionType() != call.getFunctionType()) {
+    return nullptr;
+  }
+  return summaries.lookup(callee);
+}
+
+namespace {
+// 记录一次内存访问：局部变量对调用者不可见，全局变量记入集合，
+// 其余的指针可能指向任何地址被取过的全局变量
+void addAccess(FunctionSummary &summary, const Value *ptr, bool read,
+               bool write) {
+  const Value *object = getUnderlyingObject(ptr);
+  if (isa<AllocaInst>(object)) {
+    return;
+  }
+  if (const auto *global = dyn_cast<GlobalVariable>(object)) {
+    if (read) {
+      summary.read_globals.insert(global);
+    }
+    if (write) {
+      summary.written_globals.insert(global);
+    }
+    return;
+  }
+  summary.reads_unknown |= read;
+  summary.writes_unknown |= write;
+}
+
+void addCall(FunctionSummary &summary, const CallBase &call,
+             const FunctionSummaries &summaries) {
+  if (const FunctionSummary *callee = lookupCallee(call, summaries)) {
+    summary.read_globals.insert(callee->read_globals.begin(),
+                                callee->read_globals.end());
+    summary.written_globals.insert(callee->written_globals.begin(),
+                                   callee->written_globals.end());
+    summary.reads_unknown |= callee->reads_unknown;
+    summary.writes_unknown |= callee->writes_unknown;
+    return;
+  }
+  // 声明与间接调用只能依据函数与调用点的属性
+  if (call.doesNotAccessMemory()) {
+    return;
+  }
+  bool write = !call.onlyReadsMemory();
+  if (call.onlyAccessesArgMemory()) {
+    for (const Value *arg : call.args()) {
+      if (arg->getType()->isPointerTy()) {
+        addAccess(summary, arg, true, write);
+      }
+    }
+    return;
+  }
+  summary.reads_unknown = true;
+  summary.writes_unknown |= write;
+}
+
+// 返回值 val 可能是哪些形参与常量：沿 phi、select 以及被调用者返回的实参回溯
+void addReturned(FunctionSummary &summary, const Value *val,
+                 const FunctionSummaries &summaries) {
+  SmallVector<const Value *, 8> worklist{val};
+  SmallPtrSet<const Value *, 8> visited;
+  while (!worklist.empty()) {
+    const Value *cur = worklist.pop_back_val();
+    if (!visited.insert(cur).second) {
+      continue;
+    }
+    if (const auto *constant = dyn_cast<Constant>(cur)) {
+      ConstantLattice::join(
+          summary.returned,
+          ConstantLattice::constant(const_cast<Constant *>(constant)));
+    } else if (const auto *arg = dyn_cast<Argument>(cur)) {
+      summary.returned_args.set(arg->getArgNo());
+    } else if (const auto *phi = dyn_cast<PHINode>(cur)) {
+      worklist.append(phi->incoming_values().begin(),
+                      phi->incoming_values().end());
+    } else if (const auto *select = dyn_cast<SelectInst>(cur)) {
+      worklist.push_back(select->getTrueValue());
+      worklist.push_back(select->getFalseValue());
+    } else if (const auto *call = dyn_cast<CallBase>(cur);
+               call && lookupCallee(*call, summaries)) {
+      const FunctionSummary *callee = lookupCallee(*call, summaries);
+      ConstantLattice::join(summary.returned, callee->returned);
+      for (unsigned arg : callee->returned_args.set_bits()) {
+        worklist.push_back(call->getArgOperand(arg));
+      }
+    } else {
+      ConstantLattice::join(summary.returned, ConstantLattice::overdefined());
+    }
+  }
+}
+} // namespace
+
+FunctionSummary summarizeFunction(const Function &F,
+                                  const FunctionSummaries &summaries) {
+  FunctionSummary summary;
+  summary.used_args.resize(F.arg_size());
+  summary.returned_args.resize(F.arg_size());
+
+  for (const Argument &arg : F.args()) {
+    for (const Use &use : arg.uses()) {
+      // 只被传给被调用者不使用的形参
+      const auto *call = dyn_cast<CallBase>(use.getUser());
+      if (call && call->isArgOperand(&use)) {
+        const FunctionSummary *callee = lookupCallee(*call, summaries);
+        if (callee && !callee->isArgUsed(call->getArgOperandNo(&use))) {
+          continue;
+        }
+      }
+      summary.used_args.set(arg.getArgNo());
+      break;
+    }
+  }
+
+  for (const Instruction &inst : instructions(F)) {
+    if (const auto *load = dyn_cast<LoadInst>(&inst)) {
+      addAccess(summary, load->getPointerOperand(), true, false);
+    } else if (const auto *store = dyn_cast<StoreInst>(&inst)) {
+      addAccess(summary, store->getPointerOperand(), false, true);
+    } else if (const auto *rmw = dyn_cast<AtomicRMWInst>(&inst)) {
+      addAccess(summary, rmw->getPointerOperand(), true, true);
+    } else if (const auto *cmpxchg = dyn_cast<AtomicCmpXchgInst>(&inst)) {
+      addAccess(summary, cmpxchg->getPointerOperand(), true, true);
+    } else if (const auto *call = dyn_cast<CallBase>(&inst)) {
+      addCall(summary, *call, summaries);
+    } else {
+      summary.reads_unknown |= inst.mayReadFromMemory();
+      summary.writes_unknown |= inst.mayWriteToMemory();
+    }
+    if (const auto *ret = dyn_cast<ReturnInst>(&inst)) {
+      if (const Value *val = ret->getReturnValue()) {
+        addReturned(summary, val, summaries);
+      }
+    }
+  }
+  return summary;
+}
+
+void FunctionSummary::print(raw_ostream &OS, const Function &F) const {
+  auto printArgs = [&OS](const BitVector &args) {
+    OS << "{";
+    bool first = true;
+    for (unsigned arg : args.set_bits()) {
+      OS << (first ? "" : ", ") << arg;
+      first = false;
+    }
+    OS << "}";
+  };
+  // 按名字排序，输出与 DenseSet 的遍历顺序无关
+  auto printGlobals = [&OS](const DenseSet<const GlobalVariable *> &globals,
+                            bool unknown) {
+    std::vector<const GlobalVariable *> sorted(globals.begin(), globals.end());
+    std::sort(sorted.begin(), sorted.end(),
+              [](const GlobalVariable *lhs, const GlobalVariable *rhs) {
+                return lhs->getName() < rhs->getName();
+              });
+    OS << "{";
+    bool first = true;
+    for (const GlobalVariable *global : sorted) {
+      OS << (first ? "" : ", ");
+      global->printAsOperand(OS, false);
+      first = false;
+    }
+    if (unknown) {
+      OS << (first ? "" : ", ") << "<unknown>";
+    }
+    OS << "}";
+  };
+
+  OS << "Function summary for '" << F.getName() << "':\n";
+  OS << "  used args: ";
+  printArgs(used_args);
+  OS << "\n  returned args: ";
+  printArgs(returned_args);
+  OS << "\n  returned value: ";
+  switch (returned.kind) {
+  case ConstantLattice::Bottom:
+    OS << "<none>";
+    break;
+  case ConstantLattice::Const:
+    returned.constant->printAsOperand(OS, true);
+    break;
+  case ConstantLattice::Overdefined:
+    OS << "<overdefined>";
+    break;
+  }
+  OS << "\n  reads: ";
+  printGlobals(read_globals, reads_unknown);
+  OS << "\n  writes: ";
+  printGlobals(written_globals, writes_unknown);
+  OS << "\n";
+}
+
+//-----------------------------------------------------------------------------
+// New PM implementation
+//-----------------------------------------------------------------------------
+AnalysisKey FunctionSummaryAnalysis::Key;
+
+FunctionSummaryAnalysis::Result
+FunctionSummaryAnalysis::run(Module &M, ModuleAnalysisManager &) {
+  return Result(M, summarizeFunction);
+}
+
+PreservedAnalyses FunctionSummaryPrinter::run(Module &M,
+                                              ModuleAnalysisManager &MAM) {
+  const FunctionSummaries &summaries = MAM.getResult<FunctionSummaryAnalysis>(M);
+  const dfa::CallGraphLevels &levels = summaries.getLevels();
+  OS << "Printing function summaries for module '" << M.getModuleIdentifier()
+     << "': " << levels.sccs.size() << " SCCs in " << levels.levels.size()
+     << " levels, " << summaries.getNumVisits() << " visits\n";
+  for (const Function &F : M) {
+    if (const FunctionSummary *summary = summaries.lookup(&F)) {
+      summary->print(OS, F);
+    }
+  }
+  return PreservedAnalyses::all();
+}
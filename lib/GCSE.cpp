@@ -0,0 +1,146 @@
+// 基于可用表达式的全局公共子表达式消除
+#include "AvailExpr.h"
+
+#include <llvm/ADT/Statistic.h>
+#include <llvm/IR/Dominators.h>
+#include <llvm/IR/ValueHandle.h>
+#include <llvm/Transforms/Utils/SSAUpdater.h>
+
+#define DEBUG_TYPE "dfa-gcse"
+
+STATISTIC(NumInstsEliminated, "Number of redundant binary operations "
+                              "eliminated");
+STATISTIC(NumPhisInserted, "Number of phis inserted to merge computations "
+                           "from different paths");
+
+PreservedAnalyses GCSEPass::run(Function &F, FunctionAnalysisManager &FAM) {
+  auto &AvailExprResult = FAM.getResult<AvailExprAnalysis>(F);
+  const auto &solver = AvailExprResult.getSolver();
+  DominatorTree &DT = FAM.getResult<DominatorTreeAnalysis>(F);
+
+  // 1. 在修改 IR 之前找出所有冗余的计算。按表达式记录全部计算、每个基本块
+  // 中的第一个与最后一个计算，以及基本块中没有更早的计算、需要从前驱得到
+  // 值的冗余计算。不可达的基本块不处理
+  unsigned domain_size = solver.getDomainSize();
+  std::vector<SmallVector<BinaryOperator *, 2>> members(domain_size);
+  std::vector<SmallVector<BinaryOperator *, 2>> block_ends(domain_size);
+  std::vector<SmallVector<BinaryOperator *, 2>> nonlocal(domain_size);
+  std::vector<BinaryOperator *> block_first(domain_size, nullptr);
+  SmallVector<std::pair<BinaryOperator *, BinaryOperator *>, 16> local;
+  for (BasicBlock &bb : F) {
+    if (!DT.isReachableFromEntry(&bb)) {
+      continue;
+    }
+    BitVector bv = AvailExprResult.getInputBV(bb);
+    for (Instruction &inst : bb) {
+      auto *binop = dyn_cast<BinaryOperator>(&inst);
+      int idx = binop ? solver.getDomainIndex(Expression(inst)) : -1;
+      if (idx != -1) {
+        // SSA 中操作数的定值都在第一个计算之前，基本块中其后的计算都冗余
+        if (block_first[idx] && block_first[idx]->getParent() == &bb) {
+          local.emplace_back(binop, block_first[idx]);
+          block_ends[idx].back() = binop;
+        } else {
+          if (bv.test(idx)) {
+            nonlocal[idx].push_back(binop);
+          }
+          block_first[idx] = binop;
+          block_ends[idx].push_back(binop);
+        }
+        members[idx].push_back(binop);
+      }
+      solver.TransferFunc(inst, bv);
+    }
+  }
+
+  // 2. 计算替换值。替换链上的值之后还会被替换，用 WeakTrackingVH 跟踪
+  SmallVector<std::pair<BinaryOperator *, WeakTrackingVH>, 16> replacements;
+  for (const auto &pair : local) {
+    replacements.emplace_back(pair.first, pair.second);
+  }
+  SmallVector<PHINode *, 8> inserted_phis;
+  for (unsigned idx = 0; idx < domain_size; ++idx) {
+    if (nonlocal[idx].empty()) {
+      continue;
+    }
+    // 可用保证从入口到这些计算的每条路径上，最后一次 kill 之后都有计算；
+    // SSA 中基本块里最后一个计算总在该块的 kill 之后，因此它就是基本块
+    // 出口处的值
+    BinaryOperator *proto = members[idx].front();
+    SSAUpdater updater(&inserted_phis);
+    updater.Initialize(proto->getType(), proto->getName());
+    for (BinaryOperator *end : block_ends[idx]) {
+      updater.AddAvailableValue(end->getParent(), end);
+    }
+    for (BinaryOperator *binop : nonlocal[idx]) {
+      replacements.emplace_back(
+          binop, updater.GetValueInMiddleOfBlock(binop->getParent()));
+    }
+  }
+  if (replacements.empty()) {
+    return PreservedAnalyses::all();
+  }
+
+  // 3. 同一表达式的计算可能互相替换，先让它们共用标志的交集，避免用带
+  // nsw 等标志的计算替换不带标志的计算而引入 poison
+  std::vector<bool> has_redundancy(domain_size, false);
+  for (const auto &replacement : replacements) {
+    has_redundancy[solver.getDomainIndex(Expression(*replacement.first))] =
+        true;
+  }
+  for (unsigned idx = 0; idx < domain_size; ++idx) {
+    if (!has_redundancy[idx]) {
+      continue;
+    }
+    BinaryOperator *proto = members[idx].front();
+    for (BinaryOperator *binop : members[idx]) {
+      proto->andIRFlags(binop);
+    }
+    for (BinaryOperator *binop : members[idx]) {
+      binop->copyIRFlags(proto);
+    }
+  }
+
+  // 4. 替换并删除冗余的计算
+  for (auto &replacement : replacements) {
+    BinaryOperator *binop = replacement.first;
+    Value *repl = replacement.second;
+    if (repl == binop) {
+      continue;
+    }
+    binop->replaceAllUsesWith(repl);
+    binop->eraseFromParent();
+    ++NumInstsEliminated;
+  }
+
+  // 5. 删除只有一个取值（不计自身）的 phi：例如循环头的 phi 在回边上的
+  // 取值被替换为它自己
+  bool changed = true;
+  while (changed) {
+    changed = false;
+    for (PHINode *&phi : inserted_phis) {
+      if (!phi) {
+        continue;
+      }
+      Value *val = phi->hasConstantValue();
+      if (!val) {
+        continue;
+      }
+      if (auto *inst = dyn_cast<Instruction>(val)) {
+        if (!DT.dominates(inst, phi)) {
+          continue;
+        }
+      }
+      phi->replaceAllUsesWith(val);
+      phi->eraseFromParent();
+      phi = nullptr;
+      changed = true;
+    }
+  }
+  NumPhisInserted += llvm::count_if(
+      inserted_phis, [](const PHINode *phi) { return phi != nullptr; });
+
+  PreservedAnalyses PA;
+  PA.preserveSet<CFGAnalyses>();
+  return PA;
+}
@@ -0,0 +1,129 @@
+// dfa::ModuleSummaries 的非模板部分：调用图的强连通分量与分层
+#include "cscd70/interproc.h"
+
+#include <llvm/IR/InstIterator.h>
+
+namespace dfa {
+
+namespace {
+// 被调用者：只考虑直接调用有精确定义的函数
+const Function *getExactCallee(const Instruction &inst) {
+  const auto *call = dyn_cast<CallBase>(&inst);
+  if (!call) {
+    return nullptr;
+  }
+  const Function *callee = call->getCalledFunction();
+  return callee && callee->hasExactDefinition() ? callee : nullptr;
+}
+} // namespace
+
+// 在函数之间的直接调用图上做 Tarjan 算法（显式的栈，调用链很深时也不会
+// 栈溢出）。Tarjan 算法按逆拓扑序输出 SCC，即被调用者所在的 SCC 先于调用者，
+// 因此输出一个 SCC 时它调用的其他 SCC 的层都已确定。
+// 不使用 llvm::CallGraph 的 scc_iterator：它只遍历从外部调用节点可达的函数，
+// 没有被调用的内部函数不会得到摘要
+CallGraphLevels CallGraphLevels::build(const Module &M) {
+  std::vector<const Function *> funcs;
+  DenseMap<const Function *, unsigned> func_index;
+  for (const Function &func : M) {
+    if (func.hasExactDefinition()) {
+      func_index[&func] = funcs.size();
+      funcs.push_back(&func);
+    }
+  }
+  unsigned num_funcs = funcs.size();
+  // 调用边按 CSR 格式存放，同一被调用者只记一次
+  std::vector<unsigned> callee_begin, callees;
+  std::vector<bool> self_call(num_funcs, false);
+  callee_begin.reserve(num_funcs + 1);
+  for (unsigned func = 0; func < num_funcs; ++func) {
+    callee_begin.push_back(callees.size());
+    for (const Instruction &inst : instructions(*funcs[func])) {
+      if (const Function *callee = getExactCallee(inst)) {
+        unsigned callee_id = func_index.lookup(callee);
+        self_call[func] = self_call[func] || callee_id == func;
+        if (std::find(callees.begin() + callee_begin[func], callees.end(),
+                      callee_id) == callees.end()) {
+          callees.push_back(callee_id);
+        }
+      }
+    }
+  }
+  callee_begin.push_back(callees.size());
+
+  CallGraphLevels result;
+  const unsigned kUnvisited = ~0U;
+  std::vector<unsigned> dfs_num(num_funcs, kUnvisited), low(num_funcs),
+      scc_of(num_funcs, kUnvisited), scc_level, stack;
+  // DFS 的路径：函数与下一条要访问的调用边
+  std::vector<std::pair<unsigned, unsigned>> path;
+  unsigned next_num = 0;
+  auto enter = [&](unsigned func) {
+    dfs_num[func] = low[func] = next_num++;
+    stack.push_back(func);
+    path.emplace_back(func, callee_begin[func]);
+  };
+
+  for (unsigned root = 0; root < num_funcs; ++root) {
+    if (dfs_num[root] != kUnvisited) {
+      continue;
+    }
+    enter(root);
+    while (!path.empty()) {
+      unsigned func = path.back().first;
+      unsigned &slot = path.back().second;
+      if (slot < callee_begin[func + 1]) {
+        unsigned callee = callees[slot++];
+        if (dfs_num[callee] == kUnvisited) {
+          enter(callee);
+        } else if (scc_of[callee] == kUnvisited) {
+          low[func] = std::min(low[func], dfs_num[callee]);
+        }
+        continue;
+      }
+      path.pop_back();
+      if (!path.empty()) {
+        unsigned parent = path.back().first;
+        low[parent] = std::min(low[parent], low[func]);
+      }
+      if (low[func] != dfs_num[func]) {
+        continue;
+      }
+
+      // func 是一个 SCC 的根：弹出它的成员，层为被调用者所在 SCC 的层加一
+      unsigned scc = result.sccs.size();
+      std::vector<unsigned> members;
+      unsigned member;
+      do {
+        member = stack.back();
+        stack.pop_back();
+        scc_of[member] = scc;
+        members.push_back(member);
+      } while (member != func);
+      // 函数号就是在模块中的顺序
+      std::sort(members.begin(), members.end());
+      unsigned level = 0;
+      std::vector<const Function *> scc_funcs;
+      for (unsigned member : members) {
+        scc_funcs.push_back(funcs[member]);
+        for (unsigned edge = callee_begin[member];
+             edge < callee_begin[member + 1]; ++edge) {
+          unsigned callee_scc = scc_of[callees[edge]];
+          if (callee_scc != scc) {
+            level = std::max(level, scc_level[callee_scc] + 1);
+          }
+        }
+      }
+      result.sccs.push_back(std::move(scc_funcs));
+      result.recursive.push_back(members.size() > 1 || self_call[func]);
+      scc_level.push_back(level);
+      if (result.levels.size() <= level) {
+        result.levels.resize(level + 1);
+      }
+      result.levels[level].push_back(scc);
+    }
+  }
+  return result;
+}
+
+} // namespace dfa
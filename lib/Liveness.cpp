@@ -1,25 +1,4 @@
-#include "cscd70/framework.h"
-
-
-//定义一个表示变量的类 Variable
-namespace {
-
-class Variable {
-private:
-  const Value *_val; // LLVM值的指针，表示变量
-
-public:
-  Variable(const Value *val) : _val(val) {} // 构造函数
-
-  // 比较操作符，用于判断两个变量是否相同
-  bool operator==(const Variable &val) const { return _val == val.getValue(); }
-
-  // 获取变量值的函数
-  const Value *getValue() const { return _val; }
-
-  // 友元函数，用于输出变量
-  friend raw_ostream &operator<<(raw_ostream &outs, const Variable &val);
-};
+#include "Liveness.h"
 
 // 重载输出操作符，用于打印变量
 raw_ostream &operator<<(raw_ostream &outs, const Variable &var) {
@@ -29,134 +8,100 @@ raw_ostream &operator<<(raw_ostream &outs, const Variable &var) {
   return outs;
 }
 
-} // namespace
-
-
-//为 Variable 类定义哈希函数
-namespace std {
-template <> struct hash<Variable> {
-  std::size_t operator()(const Variable &var) const {
-    std::hash<const Value *> value_ptr_hasher; // 值指针的哈希器
-
-    std::size_t value_hash = value_ptr_hasher((var.getValue()));
-    return value_hash; // 返回变量值的哈希
-  }
-};
-}; // namespace std
-
-
-namespace {
-class Liveness final
-    : public dfa::Framework<Variable, dfa::Direction::Backward> {
-
-protected:
-// 定义初始条件函数
-  virtual BitVector IC() const override {
-    // OUT[B] = \Phi (空集)
-    // 初始条件OUT[B]为假集合
-    return BitVector(_domain.size(), false);
-  }
-
-  // 定义边界条件函数
-  virtual BitVector BC() const override {
-    // OUT[ENTRY] = \Phi(空集)
-    // 边界条件OUT[ENTRY]为假集合
-    return BitVector(_domain.size(), false);
-  }
-// 定义meet操作函数  
-  virtual BitVector MeetOp(const BasicBlock &bb) const override {
-
-    // 此处应该是集合并运算后的结果
-    BitVector result(_domain.size(), false);
-
-     // 遍历所有后继基本块
-    for (const BasicBlock *block : successors(&bb)) {
-        // 获取后继基本块的第一条指令的IN集
-      // 通常来讲，所有后驱基础块的第一条指令的IN集合就是当前基础块的OUT集
-      const Instruction &first_inst_in_block = block->front();
-      BitVector curr_bv = _inst_bv_map.at(&first_inst_in_block);
-
-       // 处理PHI指令
-      // 但这里要对含phi指令的基础块作特殊处理
-      for (auto phi_iter = block->phis().begin();
-           phi_iter != block->phis().end(); phi_iter++) {
-
-        const PHINode &phi_inst = *phi_iter;
-
-        // 遍历PHI指令的前驱基本块
-        for (auto phi_inst_iter = phi_inst.block_begin();
-             phi_inst_iter != phi_inst.block_end(); phi_inst_iter++) {
-          // 获取PHI指令中的各个前驱基础块
-          BasicBlock *const &curr_bb = *phi_inst_iter;
-
-          // 处理不是当前基本块的前驱基本块
-          // 如果当前前驱基础块不是现在的基础块
-          if (curr_bb != &bb) {
-            const Value *curr_val = phi_inst.getIncomingValueForBlock(curr_bb);
-            // 如果当前值在domain中存在
-            int idx = getDomainIndex(Variable(curr_val));
-            if (idx != -1) {
-              // 将临时变量中对应变量的bit设置为false
-              assert(curr_bv[idx] = true);
-              curr_bv[idx] = false;
-            }
-          }
+// 处理PHI指令
+// 但这里要对含phi指令的基础块作特殊处理：后继基础块 block 的 IN 集
+// 在参与 bb 的 meet 之前，删掉 phi 中来自其他前驱基础块的取值
+void Liveness::EdgeGenKill(const solver_t &solver, const BasicBlock &block,
+                           const BasicBlock &bb,
+                           SmallVectorImpl<unsigned> &gen,
+                           SmallVectorImpl<unsigned> &kill) const {
+  for (auto phi_iter = block.phis().begin(); phi_iter != block.phis().end();
+       phi_iter++) {
+
+    const PHINode &phi_inst = *phi_iter;
+
+    // 遍历PHI指令的前驱基本块
+    for (auto phi_inst_iter = phi_inst.block_begin();
+         phi_inst_iter != phi_inst.block_end(); phi_inst_iter++) {
+      // 获取PHI指令中的各个前驱基础块
+      BasicBlock *const &curr_bb = *phi_inst_iter;
+
+      // 处理不是当前基本块的前驱基本块
+      // 如果当前前驱基础块不是现在的基础块
+      if (curr_bb != &bb) {
+        const Value *curr_val = phi_inst.getIncomingValueForBlock(curr_bb);
+        // 如果当前值在domain中存在，在这条边上将其删除
+        int idx = solver.getDomainIndex(Variable(curr_val));
+        if (idx != -1) {
+          kill.push_back(idx);
         }
       }
-      // 与临时变量做集合并操作
-      result |= curr_bv;
     }
-    return result;
   }
+}
 
+// 定义 GEN/KILL：传递函数为 IN = use ∪ (OUT - def)
+void Liveness::GenKill(const solver_t &solver, const Instruction &inst,
+                       SmallVectorImpl<unsigned> &gen,
+                       SmallVectorImpl<unsigned> &kill) const {
+  // use 操作
+  for (auto iter = inst.op_begin(); iter != inst.op_end(); iter++) {
+    const Value *val = dyn_cast<Value>(*iter);
+    assert(val != NULL);
+    // 引用自身只会出现在 phi 中，def 会把它删掉，所以不算作 use
+    if (val == &inst)
+      continue;
+    // 如果当前Variable存在domain
+    int idx = solver.getDomainIndex(val);
+    if (idx != -1)
+      gen.push_back(idx);
+  }
 
-  // 定义传递函数
-  virtual bool TransferFunc(const Instruction &inst,
-                            const BitVector &ibv,
-                            BitVector &obv) override {
-
-    // ibv 传入 out集合，obv传入 in集合
-    BitVector new_obv = ibv;
-
-    // use 操作
-    for (auto iter = inst.op_begin(); iter != inst.op_end(); iter++) {
-      const Value *val = dyn_cast<Value>(*iter);
-      assert(val != NULL);
-      // 如果当前Variable存在domain
-      if (_domain.find(val) != _domain.end())
-        new_obv[getDomainIndex(val)] = true;
-    }
+  // def 操作，不是所有的指令都会定值，例如ret,所以设置条件判断
+  int def_idx = solver.getDomainIndex(&inst);
+  if (def_idx != -1) {
+    kill.push_back(def_idx);
+  }
+}
 
-    // def 操作，不是所有的指令都会定值，例如ret,所以设置条件判断
-    if (getDomainIndex(&inst) != -1) {
-      new_obv[getDomainIndex(&inst)] = false;
+// 从指令初始化域
+void Liveness::InitializeDomainFromInstruction(solver_t &solver,
+                                               const Instruction &inst) const {
+  for (auto iter = inst.op_begin(); iter != inst.op_end(); iter++) {
+    if (isa<Instruction>(*iter) || isa<Argument>(*iter)) {
+      solver.addDomainElement(Variable(*iter));
     }
+  }
+}
 
+//-----------------------------------------------------------------------------
+// New PM implementation
+//-----------------------------------------------------------------------------
+AnalysisKey LivenessAnalysis::Key;
 
-    // 判断是否发生变化
-    bool hasChanged = new_obv != obv;
+LivenessAnalysis::Result LivenessAnalysis::run(Function &F,
+                                               FunctionAnalysisManager &) {
+  return Result(F);
+}
 
-    obv = new_obv;
-    return hasChanged;
-  }
+PreservedAnalyses LivenessPrinter::run(Function &F,
+                                       FunctionAnalysisManager &FAM) {
+  auto &LivenessResult = FAM.getResult<LivenessAnalysis>(F);
 
-   // 从指令初始化域
-  virtual void
-  InitializeDomainFromInstruction(const Instruction &inst) override {
-    for (auto iter = inst.op_begin(); iter != inst.op_end(); iter++) {
-      if (isa<Instruction>(*iter) || isa<Argument>(*iter)) {
-        _domain.emplace(Variable(*iter));
-      }
-    }
+  // 其他格式自带函数信息，或者是机器可读的，不输出标题行
+  if (LivenessResult.getPrintFormat() == dfa::PrintFormat::Text) {
+    OS << "Printing analysis 'Liveness' for function '" << F.getName()
+       << "':\n";
   }
+  LivenessResult.print(OS);
+  return PreservedAnalyses::all();
+}
 
-public:
-  static char ID;
-  Liveness() : dfa::Framework<domain_element_t, direction_c>(ID) {}
-  virtual ~Liveness() override {}
-};
-
-char Liveness::ID = 1;
-RegisterPass<Liveness> Y("liveness", "Liveness");
-
-} // namespace
\ No newline at end of file
+//-----------------------------------------------------------------------------
+// Legacy PM registration
+//-----------------------------------------------------------------------------
+namespace {
+RegisterPass<dfa::LegacyPass<Liveness>> Y("liveness", "Liveness");
+RegisterPass<dfa::ModuleDriver<Liveness>>
+    Z("liveness-parallel", "Liveness (functions solved in parallel)");
+} // namespace
@@ -0,0 +1,379 @@
+// 基于循环嵌套森林的活跃性查询
+#include "LivenessQuery.h"
+
+#include <algorithm>
+#include <cassert>
+#include <limits>
+#include <utility>
+
+#include <llvm/ADT/SmallVector.h>
+#include <llvm/IR/CFG.h>
+#include <llvm/IR/Instructions.h>
+#include <llvm/Support/raw_ostream.h>
+
+using namespace llvm;
+
+namespace {
+constexpr unsigned kUnreached = std::numeric_limits<unsigned>::max();
+// 变量作为某个基本块中 phi 的取值时来自多个不同的前驱
+constexpr int kManyPreds = -1;
+} // namespace
+
+// 一次查询从 def-use 链得到的信息，基本块都用编号表示
+struct LivenessQuery::UseInfo {
+  // 定值所在的基本块，形参为 -1
+  int def_block = -1;
+  // 变量向上暴露的基本块（第一次出现是使用），即属于 live-in 的基本块；升序
+  SmallVector<unsigned, 8> exposed;
+  // (含有以变量为取值的 phi 的基本块, 取值来自的前驱或 kManyPreds)，
+  // 按基本块升序
+  SmallVector<std::pair<unsigned, int>, 4> phi_blocks;
+  // 快速判定的目标：普通使用所在的基本块，以及 phi 的取值只来自一个前驱时
+  // 的该前驱（变量在其出口处活跃）
+  SmallVector<unsigned, 8> targets;
+  // 存在需要逐块确认的 phi 基本块，见 LivenessQuery.h
+  bool has_cuts = false;
+
+  bool isExposed(unsigned block) const {
+    return std::binary_search(exposed.begin(), exposed.end(), block);
+  }
+  const std::pair<unsigned, int> *findPhiBlock(unsigned block) const {
+    auto iter = std::lower_bound(
+        phi_blocks.begin(), phi_blocks.end(), block,
+        [](const std::pair<unsigned, int> &entry, unsigned block) {
+          return entry.first < block;
+        });
+    return iter != phi_blocks.end() && iter->first == block ? iter : nullptr;
+  }
+};
+
+LivenessQuery::LivenessQuery(const Function &F) : _func(&F) {
+  // 1. 基本块编号与后继
+  _blocks.reserve(F.size());
+  _block_index.reserve(F.size());
+  for (const BasicBlock &bb : F) {
+    _block_index[&bb] = _blocks.size();
+    _blocks.push_back(&bb);
+  }
+  unsigned num_blocks = _blocks.size();
+  _succ_begin.reserve(num_blocks + 1);
+  for (const BasicBlock *bb : _blocks) {
+    _succ_begin.push_back(_succs.size());
+    for (const BasicBlock *succ : successors(bb)) {
+      _succs.push_back(_block_index.lookup(succ));
+    }
+  }
+  _succ_begin.push_back(_succs.size());
+  if (num_blocks == 0) {
+    return;
+  }
+
+  // 2. 从入口深度优先编号。栈中保存 (基本块, 下一个要访问的后继的位置)
+  _preorder.assign(num_blocks, kUnreached);
+  std::vector<unsigned> postorder(num_blocks, kUnreached), post_seq;
+  post_seq.reserve(num_blocks);
+  SmallVector<std::pair<unsigned, unsigned>, 32> stack;
+  unsigned num_visited = 0;
+  _preorder[0] = num_visited++;
+  stack.emplace_back(0, _succ_begin[0]);
+  while (!stack.empty()) {
+    unsigned block = stack.back().first;
+    unsigned slot = stack.back().second;
+    if (slot == _succ_begin[block + 1]) {
+      postorder[block] = post_seq.size();
+      post_seq.push_back(block);
+      stack.pop_back();
+      continue;
+    }
+    ++stack.back().second;
+    unsigned succ = _succs[slot];
+    if (_preorder[succ] == kUnreached) {
+      _preorder[succ] = num_visited++;
+      stack.emplace_back(succ, _succ_begin[succ]);
+    }
+  }
+  // succ 是 block 在 DFS 树上的祖先（或自身）时 block -> succ 为回边
+  auto isBackEdge = [&](unsigned block, unsigned succ) {
+    return _preorder[succ] <= _preorder[block] &&
+           postorder[block] <= postorder[succ];
+  };
+
+  // 3. 简化图上的可达集合。按后序处理，非回边的后继都已处理过
+  _reach.resize(num_blocks);
+  for (unsigned block : post_seq) {
+    BitVector &reach = _reach[block];
+    reach.resize(num_blocks);
+    reach.set(block);
+    for (unsigned slot = _succ_begin[block]; slot < _succ_begin[block + 1];
+         ++slot) {
+      unsigned succ = _succs[slot];
+      if (!isBackEdge(block, succ)) {
+        reach |= _reach[succ];
+      }
+    }
+  }
+
+  // 4. 支配树与循环嵌套森林。回边的目标都支配其源时控制流图可归约，
+  // 这时回边的目标恰好是 LoopInfo 中各个循环的头
+  _dt.recalculate(const_cast<Function &>(F));
+  _loops.analyze(_dt);
+  for (unsigned block : post_seq) {
+    for (unsigned slot = _succ_begin[block]; slot < _succ_begin[block + 1];
+         ++slot) {
+      unsigned succ = _succs[slot];
+      if (isBackEdge(block, succ) &&
+          !_dt.dominates(_blocks[succ], _blocks[block])) {
+        _reducible = false;
+      }
+    }
+  }
+}
+
+unsigned LivenessQuery::getBlockIndex(const BasicBlock &bb) const {
+  auto iter = _block_index.find(&bb);
+  assert(iter != _block_index.end() && "基本块不在函数中");
+  return iter->second;
+}
+
+bool LivenessQuery::collectUses(const Value *val, UseInfo &uses) const {
+  const auto *def = dyn_cast<Instruction>(val);
+  if (def) {
+    if (def->getFunction() != _func) {
+      return false;
+    }
+    uses.def_block = getBlockIndex(*def->getParent());
+  } else if (const auto *arg = dyn_cast<Argument>(val)) {
+    if (arg->getParent() != _func) {
+      return false;
+    }
+  } else {
+    return false;
+  }
+
+  // 与 Liveness 相同：引用自身不算作使用；定值所在的基本块中只有位于定值
+  // 之前的使用（phi）向上暴露
+  for (const Use &use : val->uses()) {
+    const auto *user = dyn_cast<Instruction>(use.getUser());
+    if (!user || user == val || !user->getParent()) {
+      continue;
+    }
+    unsigned block = getBlockIndex(*user->getParent());
+    if (const auto *phi = dyn_cast<PHINode>(user)) {
+      int pred = getBlockIndex(*phi->getIncomingBlock(use));
+      uses.phi_blocks.emplace_back(block, pred);
+    }
+    if (static_cast<int>(block) != uses.def_block || user->comesBefore(def)) {
+      uses.exposed.push_back(block);
+    }
+  }
+  llvm::sort(uses.exposed);
+  uses.exposed.erase(std::unique(uses.exposed.begin(), uses.exposed.end()),
+                     uses.exposed.end());
+  // 同一个基本块的多个取值合并：前驱不同时为 kManyPreds
+  llvm::sort(uses.phi_blocks);
+  unsigned num_phi_blocks = 0;
+  for (const auto &entry : uses.phi_blocks) {
+    if (num_phi_blocks != 0 &&
+        uses.phi_blocks[num_phi_blocks - 1].first == entry.first) {
+      if (uses.phi_blocks[num_phi_blocks - 1].second != entry.second) {
+        uses.phi_blocks[num_phi_blocks - 1].second = kManyPreds;
+      }
+      continue;
+    }
+    uses.phi_blocks[num_phi_blocks++] = entry;
+  }
+  uses.phi_blocks.resize(num_phi_blocks);
+
+  // 快速判定的目标。含有 phi 的基本块只能从取值来自的前驱进入，因此以该
+  // 前驱为目标；该前驱自身也含有这样的 phi 时由它自己的规则处理
+  const BasicBlock *def_bb = def ? def->getParent() : nullptr;
+  for (unsigned block : uses.exposed) {
+    const auto *phi_block = uses.findPhiBlock(block);
+    if (!phi_block) {
+      uses.targets.push_back(block);
+      continue;
+    }
+    int pred = phi_block->second;
+    if (pred != kManyPreds && pred != uses.def_block &&
+        !uses.findPhiBlock(pred)) {
+      uses.targets.push_back(pred);
+    }
+    const BasicBlock *bb = _blocks[block];
+    bool dominated = def_bb ? _dt.properlyDominates(def_bb, bb)
+                            : _dt.isReachableFromEntry(bb);
+    if (dominated && (pred == kManyPreds ||
+                      bb->getUniquePredecessor() != _blocks[pred])) {
+      uses.has_cuts = true;
+    }
+  }
+  return true;
+}
+
+bool LivenessQuery::isKilledOnEdge(const UseInfo &uses, unsigned pred,
+                                   unsigned block) const {
+  const auto *phi_block = uses.findPhiBlock(block);
+  return phi_block && phi_block->second != static_cast<int>(pred);
+}
+
+bool LivenessQuery::isLiveInAt(const UseInfo &uses, unsigned block) const {
+  if (uses.isExposed(block)) {
+    return true;
+  }
+  if (static_cast<int>(block) == uses.def_block) {
+    return false;
+  }
+  if (!_reducible || _preorder[block] == kUnreached) {
+    return searchLiveIn(uses, block);
+  }
+  const BasicBlock *bb = _blocks[block];
+  const BasicBlock *def_bb =
+      uses.def_block == -1 ? nullptr : _blocks[uses.def_block];
+  if (def_bb && !_dt.properlyDominates(def_bb, bb)) {
+    return false;
+  }
+  // 包含 bb、头被定值严格支配的最外层循环的头。外层循环的头支配内层循环的
+  // 头，满足条件的循环是从 bb 所在的循环向外连续的若干层
+  unsigned top = block;
+  for (const Loop *loop = _loops.getLoopFor(bb); loop;
+       loop = loop->getParentLoop()) {
+    if (def_bb && !_dt.properlyDominates(def_bb, loop->getHeader())) {
+      break;
+    }
+    top = getBlockIndex(*loop->getHeader());
+  }
+  const BitVector &reach = _reach[top];
+  bool reached = llvm::any_of(uses.targets,
+                              [&reach](unsigned target) {
+                                return reach.test(target);
+                              });
+  if (reached && uses.has_cuts) {
+    return searchLiveIn(uses, block);
+  }
+  return reached;
+}
+
+// 按 Liveness 的定义逐块搜索：从 block 出发沿没有被删掉变量的边前进，
+// 遇到定值所在的基本块停止，遇到变量向上暴露的基本块即为活跃
+bool LivenessQuery::searchLiveIn(const UseInfo &uses, unsigned block) const {
+  if (uses.isExposed(block)) {
+    return true;
+  }
+  if (static_cast<int>(block) == uses.def_block) {
+    return false;
+  }
+  BitVector visited(getNumBlocks());
+  SmallVector<unsigned, 32> worklist{block};
+  visited.set(block);
+  while (!worklist.empty()) {
+    unsigned curr = worklist.pop_back_val();
+    for (unsigned slot = _succ_begin[curr]; slot < _succ_begin[curr + 1];
+         ++slot) {
+      unsigned succ = _succs[slot];
+      if (isKilledOnEdge(uses, curr, succ)) {
+        continue;
+      }
+      if (uses.isExposed(succ)) {
+        return true;
+      }
+      if (static_cast<int>(succ) == uses.def_block || visited.test(succ)) {
+        continue;
+      }
+      visited.set(succ);
+      worklist.push_back(succ);
+    }
+  }
+  return false;
+}
+
+// 出口处活跃当且仅当沿某条没有删掉变量的出边在后继的入口处活跃
+bool LivenessQuery::isLiveOutAt(const UseInfo &uses, unsigned block) const {
+  for (unsigned slot = _succ_begin[block]; slot < _succ_begin[block + 1];
+       ++slot) {
+    unsigned succ = _succs[slot];
+    if (!isKilledOnEdge(uses, block, succ) && isLiveInAt(uses, succ)) {
+      return true;
+    }
+  }
+  return false;
+}
+
+bool LivenessQuery::isLiveIn(const Value *val, const BasicBlock &bb) const {
+  UseInfo uses;
+  return collectUses(val, uses) && isLiveInAt(uses, getBlockIndex(bb));
+}
+
+bool LivenessQuery::isLiveOut(const Value *val, const BasicBlock &bb) const {
+  UseInfo uses;
+  return collectUses(val, uses) && isLiveOutAt(uses, getBlockIndex(bb));
+}
+
+void LivenessQuery::print(raw_ostream &OS) const {
+  // 变量的顺序与 Liveness 的域相同
+  std::vector<const Value *> values;
+  DenseMap<const Value *, unsigned> seen;
+  for (const BasicBlock *bb : _blocks) {
+    for (const Instruction &inst : *bb) {
+      for (const Value *op : inst.operands()) {
+        if ((isa<Instruction>(op) || isa<Argument>(op)) &&
+            seen.try_emplace(op, values.size()).second) {
+          values.push_back(op);
+        }
+      }
+    }
+  }
+  std::vector<UseInfo> uses(values.size());
+  for (unsigned var = 0; var < values.size(); ++var) {
+    collectUses(values[var], uses[var]);
+  }
+  auto printSet = [&](unsigned block, bool live_out) {
+    OS << "{";
+    bool first = true;
+    for (unsigned var = 0; var < values.size(); ++var) {
+      if (live_out ? isLiveOutAt(uses[var], block)
+                   : isLiveInAt(uses[var], block)) {
+        OS << (first ? "" : ", ");
+        values[var]->printAsOperand(OS, false);
+        first = false;
+      }
+    }
+    OS << "}";
+  };
+  for (unsigned block = 0; block < getNumBlocks(); ++block) {
+    const BasicBlock &bb = getBlock(block);
+    OS << "bb" << block;
+    if (bb.hasName()) {
+      OS << " (" << bb.getName() << ")";
+    }
+    OS << ":\n  live-in:  ";
+    printSet(block, false);
+    OS << "\n  live-out: ";
+    printSet(block, true);
+    OS << "\n";
+  }
+}
+
+//-----------------------------------------------------------------------------
+// New PM implementation
+//-----------------------------------------------------------------------------
+AnalysisKey LivenessQueryAnalysis::Key;
+
+bool LivenessQuery::invalidate(Function &, const PreservedAnalyses &PA,
+                               FunctionAnalysisManager::Invalidator &) {
+  auto checker = PA.getChecker<LivenessQueryAnalysis>();
+  return !checker.preserved() &&
+         !checker.preservedSet<AllAnalysesOn<Function>>() &&
+         !checker.preservedSet<CFGAnalyses>();
+}
+
+LivenessQueryAnalysis::Result
+LivenessQueryAnalysis::run(Function &F, FunctionAnalysisManager &) {
+  return LivenessQuery(F);
+}
+
+PreservedAnalyses LivenessQueryPrinter::run(Function &F,
+                                            FunctionAnalysisManager &FAM) {
+  OS << "Printing analysis 'Liveness query' for function '" << F.getName()
+     << "':\n";
+  FAM.getResult<LivenessQueryAnalysis>(F).print(OS);
+  return PreservedAnalyses::all();
+}
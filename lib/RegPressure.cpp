@@ -0,0 +1,289 @@
+// 基于活跃变量分析的寄存器压力估计
+#include "RegPressure.h"
+
+#include <algorithm>
+#include <cassert>
+
+#include <llvm/Analysis/OptimizationRemarkEmitter.h>
+#include <llvm/IR/Instructions.h>
+#include <llvm/Support/raw_ostream.h>
+
+#define DEBUG_TYPE "dfa-reg-pressure"
+
+using namespace llvm;
+
+namespace {
+// 一个值占用的寄存器：cls 为 _classes 中的下标，regs 为 0 表示不计入
+struct ValueCost {
+  unsigned cls = 0;
+  RegisterPressure::ValueKind kind = RegisterPressure::Int;
+  unsigned regs = 0;
+};
+
+unsigned sum(ArrayRef<unsigned> counts) {
+  unsigned total = 0;
+  for (unsigned count : counts) {
+    total += count;
+  }
+  return total;
+}
+} // namespace
+
+RegisterPressure::RegisterPressure(const Function &F,
+                                   const LivenessAnalysis::Result &liveness,
+                                   const TargetTransformInfo &TTI,
+                                   const LoopInfo &LI)
+    : _func(&F) {
+  // 1. 寄存器类：先放整数、浮点、向量对应的类，其余在遇到时加入
+  DenseMap<unsigned, unsigned> class_index;
+  auto getClass = [&](bool vector, Type *ty) {
+    unsigned id = TTI.getRegisterClassForType(vector, ty);
+    auto result = class_index.try_emplace(id, _classes.size());
+    if (result.second) {
+      _classes.push_back(
+          {id, TTI.getRegisterClassName(id), TTI.getNumberOfRegisters(id)});
+    }
+    return result.first->second;
+  };
+  getClass(false, nullptr);
+  getClass(false, Type::getDoubleTy(F.getContext()));
+  getClass(true, nullptr);
+
+  auto getCost = [&](const Value *val) {
+    ValueCost cost;
+    Type *ty = val->getType();
+    const auto *alloca = dyn_cast<AllocaInst>(val);
+    if ((alloca && alloca->isStaticAlloca()) ||
+        !(ty->isIntOrIntVectorTy() || ty->isPtrOrPtrVectorTy() ||
+          ty->isFPOrFPVectorTy())) {
+      return cost;
+    }
+    bool vector = ty->isVectorTy();
+    cost.kind = vector ? Vector : ty->isFloatingPointTy() ? FP : Int;
+    cost.cls = getClass(vector, ty);
+    InstructionCost regs = TTI.getRegUsageForType(ty);
+    cost.regs = regs.isValid() ? std::max<unsigned>(*regs.getValue(), 1) : 1;
+    return cost;
+  };
+
+  const auto &solver = liveness.getSolver();
+  unsigned domain_size = solver.getDomainSize();
+  std::vector<ValueCost> costs(domain_size);
+  for (unsigned idx = 0; idx < domain_size; ++idx) {
+    costs[idx] = getCost(solver.getDomainElement(idx).getValue());
+  }
+
+  // 2. 逐个基本块从 OUT[B] 逆序重放传递函数，维护当前活跃值按种类与
+  // 寄存器类的计数
+  Pressure curr;
+  auto apply = [&curr](const ValueCost &cost, int sign) {
+    curr.kinds[cost.kind] += sign * cost.regs;
+    curr.classes[cost.cls] += sign * cost.regs;
+  };
+  BitVector prev;
+  for (const BasicBlock &bb : F) {
+    _block_index[&bb] = _blocks.size();
+    _blocks.emplace_back();
+    // 遍历中可能加入新的寄存器类，先统计完再补齐长度
+    std::vector<unsigned> &max_classes = _blocks.back().classes;
+    unsigned *max_kinds = _blocks.back().kinds;
+    auto updateMax = [&]() {
+      for (unsigned kind = 0; kind < NumValueKinds; ++kind) {
+        max_kinds[kind] = std::max(max_kinds[kind], curr.kinds[kind]);
+      }
+      max_classes.resize(curr.classes.size(), 0);
+      for (unsigned cls = 0; cls < curr.classes.size(); ++cls) {
+        max_classes[cls] = std::max(max_classes[cls], curr.classes[cls]);
+      }
+    };
+
+    std::fill(std::begin(curr.kinds), std::end(curr.kinds), 0);
+    curr.classes.assign(_classes.size(), 0);
+    BitVector live = liveness.getInputBV(bb);
+    for (unsigned idx : live.set_bits()) {
+      apply(costs[idx], 1);
+    }
+    for (const Instruction &inst : make_range(bb.rbegin(), bb.rend())) {
+      bool is_phi = isa<PHINode>(inst);
+      if (!is_phi) {
+        // 指令之后：活跃值加上尚未计入的定值
+        int def_idx = solver.getDomainIndex(Variable(&inst));
+        ValueCost def;
+        if (def_idx == -1) {
+          def = getCost(&inst);
+          curr.classes.resize(_classes.size(), 0);
+        } else if (!live.test(def_idx)) {
+          def = costs[def_idx];
+        }
+        apply(def, 1);
+        updateMax();
+        apply(def, -1);
+      }
+      prev = live;
+      solver.TransferFunc(inst, live);
+      prev ^= live;
+      for (unsigned idx : prev.set_bits()) {
+        apply(costs[idx], live.test(idx) ? 1 : -1);
+      }
+      if (!is_phi) {
+        updateMax();
+      }
+    }
+  }
+  for (Pressure &pressure : _blocks) {
+    pressure.classes.resize(_classes.size(), 0);
+  }
+
+  // 3. 循环：所含基本块（包括内层循环的）的最大值
+  for (const Loop *loop : LI.getLoopsInPreorder()) {
+    LoopPressure entry{loop->getHeader(), loop->getLoopDepth(),
+                       loop->getNumBlocks(), Pressure(), 0};
+    entry.max.classes.assign(_classes.size(), 0);
+    for (const BasicBlock *bb : loop->blocks()) {
+      const Pressure &pressure = getBlockPressure(*bb);
+      for (unsigned kind = 0; kind < NumValueKinds; ++kind) {
+        entry.max.kinds[kind] =
+            std::max(entry.max.kinds[kind], pressure.kinds[kind]);
+      }
+      for (unsigned cls = 0; cls < _classes.size(); ++cls) {
+        entry.max.classes[cls] =
+            std::max(entry.max.classes[cls], pressure.classes[cls]);
+      }
+    }
+    for (unsigned cls = 0; cls < _classes.size(); ++cls) {
+      if (entry.max.classes[cls] > _classes[cls].num_regs) {
+        entry.excess = std::max(entry.excess, entry.max.classes[cls] -
+                                                  _classes[cls].num_regs);
+      }
+    }
+    _loops.push_back(std::move(entry));
+  }
+  std::stable_sort(_loops.begin(), _loops.end(),
+                   [](const LoopPressure &lhs, const LoopPressure &rhs) {
+                     if (lhs.excess != rhs.excess) {
+                       return lhs.excess > rhs.excess;
+                     }
+                     return sum(lhs.max.classes) > sum(rhs.max.classes);
+                   });
+}
+
+const RegisterPressure::Pressure &
+RegisterPressure::getBlockPressure(const BasicBlock &bb) const {
+  auto iter = _block_index.find(&bb);
+  assert(iter != _block_index.end() && "基本块不在函数中");
+  return _blocks[iter->second];
+}
+
+const char *RegisterPressure::getKindName(ValueKind kind) {
+  switch (kind) {
+  case Int:
+    return "int";
+  case FP:
+    return "fp";
+  case Vector:
+    return "vector";
+  default:
+    return "?";
+  }
+}
+
+void RegisterPressure::printPressure(raw_ostream &OS,
+                                     const Pressure &pressure) const {
+  for (unsigned kind = 0; kind < NumValueKinds; ++kind) {
+    OS << (kind ? ", " : "") << getKindName(static_cast<ValueKind>(kind)) << " "
+       << pressure.kinds[kind];
+  }
+  OS << ";";
+  for (unsigned cls = 0; cls < _classes.size(); ++cls) {
+    OS << " " << _classes[cls].name << " " << pressure.classes[cls] << "/"
+       << _classes[cls].num_regs;
+  }
+}
+
+void RegisterPressure::print(raw_ostream &OS) const {
+  unsigned block = 0;
+  for (const BasicBlock &bb : *_func) {
+    OS << "bb" << block;
+    if (bb.hasName()) {
+      OS << " (" << bb.getName() << ")";
+    }
+    OS << ": ";
+    printPressure(OS, _blocks[block++]);
+    OS << "\n";
+  }
+  if (_loops.empty()) {
+    return;
+  }
+  OS << "Loops ranked by register excess:\n";
+  unsigned rank = 0;
+  for (const LoopPressure &loop : _loops) {
+    OS << "  #" << ++rank << " loop ";
+    loop.header->printAsOperand(OS, false);
+    OS << " (depth " << loop.depth << ", " << loop.num_blocks
+       << " blocks): ";
+    printPressure(OS, loop.max);
+    if (loop.excess) {
+      OS << "  exceeds by " << loop.excess;
+    }
+    OS << "\n";
+  }
+}
+
+//-----------------------------------------------------------------------------
+// New PM implementation
+//-----------------------------------------------------------------------------
+AnalysisKey RegisterPressureAnalysis::Key;
+
+RegisterPressureAnalysis::Result
+RegisterPressureAnalysis::run(Function &F, FunctionAnalysisManager &FAM) {
+  return RegisterPressure(F, FAM.getResult<LivenessAnalysis>(F),
+                          FAM.getResult<TargetIRAnalysis>(F),
+                          FAM.getResult<LoopAnalysis>(F));
+}
+
+PreservedAnalyses RegisterPressurePrinter::run(Function &F,
+                                               FunctionAnalysisManager &FAM) {
+  OS << "Printing analysis 'Register pressure' for function '" << F.getName()
+     << "':\n";
+  FAM.getResult<RegisterPressureAnalysis>(F).print(OS);
+  return PreservedAnalyses::all();
+}
+
+PreservedAnalyses RegisterPressureRemarks::run(Function &F,
+                                               FunctionAnalysisManager &FAM) {
+  OptimizationRemarkEmitter &ORE =
+      FAM.getResult<OptimizationRemarkEmitterAnalysis>(F);
+  if (!ORE.allowExtraAnalysis(DEBUG_TYPE)) {
+    return PreservedAnalyses::all();
+  }
+  const RegisterPressure &pressure =
+      FAM.getResult<RegisterPressureAnalysis>(F);
+  const LoopInfo &LI = FAM.getResult<LoopAnalysis>(F);
+  ArrayRef<RegisterPressure::RegClass> classes = pressure.getRegClasses();
+  for (const RegisterPressure::LoopPressure &loop : pressure.getLoops()) {
+    // 已按超出量排序
+    if (!loop.excess) {
+      break;
+    }
+    const Loop *L = LI.getLoopFor(loop.header);
+    for (unsigned cls = 0; cls < classes.size(); ++cls) {
+      if (loop.max.classes[cls] <= classes[cls].num_regs) {
+        continue;
+      }
+      ORE.emit(OptimizationRemarkAnalysis(DEBUG_TYPE, "LoopRegisterPressure",
+                                          L->getStartLoc(), loop.header)
+               << "loop at depth " << ore::NV("Depth", loop.depth)
+               << " needs " << ore::NV("Registers", loop.max.classes[cls])
+               << " " << ore::NV("RegClass", classes[cls].name)
+               << " registers, target has "
+               << ore::NV("Available", classes[cls].num_regs)
+               << " (peak live: int "
+               << ore::NV("Int", loop.max.kinds[RegisterPressure::Int])
+               << ", fp " << ore::NV("FP", loop.max.kinds[RegisterPressure::FP])
+               << ", vector "
+               << ore::NV("Vector", loop.max.kinds[RegisterPressure::Vector])
+               << ")");
+    }
+  }
+  return PreservedAnalyses::all();
+}
@@ -0,0 +1,408 @@
+// dfa::Framework 的集合表示：ChunkedSet 的实现与集合表示的启发式选择
+#include "cscd70/sets.h"
+
+#include <algorithm>
+#include <cmath>
+#include <iterator>
+
+#include <llvm/Config/llvm-config.h>
+#include <llvm/Support/MathExtras.h>
+
+namespace dfa {
+
+namespace {
+// LLVM 16 起 countPopulation/countTrailingZeros 被 llvm/ADT/bit.h 中的
+// popcount/countr_zero 取代
+#if LLVM_VERSION_MAJOR >= 16
+unsigned popCount(uint64_t word) { return llvm::popcount(word); }
+unsigned lowestBit(uint64_t word) { return llvm::countr_zero(word); }
+#else
+unsigned popCount(uint64_t word) { return llvm::countPopulation(word); }
+unsigned lowestBit(uint64_t word) { return llvm::countTrailingZeros(word); }
+#endif
+} // namespace
+
+const char *getSetKindName(SetKind kind) {
+  switch (kind) {
+  case SetKind::Auto:
+    return "auto";
+  case SetKind::Dense:
+    return "dense";
+  case SetKind::Sparse:
+    return "sparse";
+  case SetKind::Chunked:
+    return "chunked";
+  }
+  return "unknown";
+}
+
+size_t SparseSet::estimateMemory(double num_elems, double elems_per_segment) {
+  elems_per_segment = std::min(std::max(elems_per_segment, 1.0),
+                               static_cast<double>(kElementBits));
+  return sizeof(SparseSet) +
+         static_cast<size_t>(std::ceil(num_elems / elems_per_segment)) *
+             kNodeBytes;
+}
+
+//-----------------------------------------------------------------------------
+// ChunkedSet
+//-----------------------------------------------------------------------------
+std::vector<ChunkedSet::Chunk>::iterator ChunkedSet::lowerBound(unsigned key) {
+  return std::lower_bound(
+      _chunks.begin(), _chunks.end(), key,
+      [](const Chunk &chunk, unsigned key) { return chunk.key < key; });
+}
+
+std::vector<ChunkedSet::Chunk>::const_iterator
+ChunkedSet::lowerBound(unsigned key) const {
+  return std::lower_bound(
+      _chunks.begin(), _chunks.end(), key,
+      [](const Chunk &chunk, unsigned key) { return chunk.key < key; });
+}
+
+void ChunkedSet::toWords(const Chunk &chunk, uint64_t *words) {
+  if (chunk.isBitmap()) {
+    std::copy(chunk.bitmap.begin(), chunk.bitmap.end(), words);
+    return;
+  }
+  std::fill(words, words + kBitmapWords, 0);
+  for (uint16_t low : chunk.array) {
+    words[low / 64] |= uint64_t(1) << (low % 64);
+  }
+}
+
+bool ChunkedSet::fromWords(Chunk &chunk, const uint64_t *words) {
+  unsigned card = 0;
+  for (unsigned idx = 0; idx < kBitmapWords; ++idx) {
+    card += popCount(words[idx]);
+  }
+  chunk.card = card;
+  chunk.array.clear();
+  chunk.bitmap.clear();
+  if (card > kArrayMax) {
+    chunk.bitmap.assign(words, words + kBitmapWords);
+  } else {
+    chunk.array.reserve(card);
+    for (unsigned idx = 0; idx < kBitmapWords; ++idx) {
+      for (uint64_t word = words[idx]; word != 0; word &= word - 1) {
+        chunk.array.push_back(idx * 64 + lowestBit(word));
+      }
+    }
+  }
+  return card != 0;
+}
+
+void ChunkedSet::normalize(Chunk &chunk) {
+  if (chunk.isBitmap() == (chunk.card > kArrayMax)) {
+    return;
+  }
+  uint64_t words[kBitmapWords];
+  toWords(chunk, words);
+  fromWords(chunk, words);
+}
+
+ChunkedSet ChunkedSet::fromBitVector(const llvm::BitVector &bv) {
+  ChunkedSet set;
+  // 下标递增，每次都追加到最后一块
+  for (unsigned idx : bv.set_bits()) {
+    set.set(idx);
+  }
+  return set;
+}
+
+llvm::BitVector ChunkedSet::toBitVector(unsigned domain_size) const {
+  llvm::BitVector bv(domain_size, false);
+  for (const Chunk &chunk : _chunks) {
+    unsigned base = chunk.key << kChunkBits;
+    if (chunk.isBitmap()) {
+      for (unsigned idx = 0; idx < kBitmapWords; ++idx) {
+        for (uint64_t word = chunk.bitmap[idx]; word != 0; word &= word - 1) {
+          bv.set(base + idx * 64 + lowestBit(word));
+        }
+      }
+    } else {
+      for (uint16_t low : chunk.array) {
+        bv.set(base + low);
+      }
+    }
+  }
+  return bv;
+}
+
+bool ChunkedSet::test(unsigned idx) const {
+  unsigned key = idx >> kChunkBits;
+  uint16_t low = idx & (kChunkSize - 1);
+  auto iter = lowerBound(key);
+  if (iter == _chunks.end() || iter->key != key) {
+    return false;
+  }
+  if (iter->isBitmap()) {
+    return (iter->bitmap[low / 64] >> (low % 64)) & 1;
+  }
+  return std::binary_search(iter->array.begin(), iter->array.end(), low);
+}
+
+void ChunkedSet::set(unsigned idx) {
+  unsigned key = idx >> kChunkBits;
+  uint16_t low = idx & (kChunkSize - 1);
+  auto iter = lowerBound(key);
+  if (iter == _chunks.end() || iter->key != key) {
+    Chunk chunk;
+    chunk.key = key;
+    chunk.card = 1;
+    chunk.array.push_back(low);
+    _chunks.insert(iter, std::move(chunk));
+    return;
+  }
+  if (iter->isBitmap()) {
+    uint64_t &word = iter->bitmap[low / 64];
+    uint64_t mask = uint64_t(1) << (low % 64);
+    if (!(word & mask)) {
+      word |= mask;
+      ++iter->card;
+    }
+    return;
+  }
+  auto pos = std::lower_bound(iter->array.begin(), iter->array.end(), low);
+  if (pos != iter->array.end() && *pos == low) {
+    return;
+  }
+  iter->array.insert(pos, low);
+  ++iter->card;
+  normalize(*iter);
+}
+
+void ChunkedSet::reset(unsigned idx) {
+  unsigned key = idx >> kChunkBits;
+  uint16_t low = idx & (kChunkSize - 1);
+  auto iter = lowerBound(key);
+  if (iter == _chunks.end() || iter->key != key) {
+    return;
+  }
+  if (iter->isBitmap()) {
+    uint64_t &word = iter->bitmap[low / 64];
+    uint64_t mask = uint64_t(1) << (low % 64);
+    if (!(word & mask)) {
+      return;
+    }
+    word &= ~mask;
+    --iter->card;
+  } else {
+    auto pos = std::lower_bound(iter->array.begin(), iter->array.end(), low);
+    if (pos == iter->array.end() || *pos != low) {
+      return;
+    }
+    iter->array.erase(pos);
+    --iter->card;
+  }
+  if (iter->card == 0) {
+    _chunks.erase(iter);
+  } else {
+    normalize(*iter);
+  }
+}
+
+ChunkedSet &ChunkedSet::operator|=(const ChunkedSet &rhs) {
+  std::vector<Chunk> result;
+  result.reserve(_chunks.size() + rhs._chunks.size());
+  auto lhs_iter = _chunks.begin();
+  auto rhs_iter = rhs._chunks.begin();
+  while (lhs_iter != _chunks.end() || rhs_iter != rhs._chunks.end()) {
+    if (rhs_iter == rhs._chunks.end() ||
+        (lhs_iter != _chunks.end() && lhs_iter->key < rhs_iter->key)) {
+      result.push_back(std::move(*lhs_iter++));
+    } else if (lhs_iter == _chunks.end() || rhs_iter->key < lhs_iter->key) {
+      result.push_back(*rhs_iter++);
+    } else {
+      Chunk chunk;
+      chunk.key = lhs_iter->key;
+      if (!lhs_iter->isBitmap() && !rhs_iter->isBitmap()) {
+        std::set_union(lhs_iter->array.begin(), lhs_iter->array.end(),
+                       rhs_iter->array.begin(), rhs_iter->array.end(),
+                       std::back_inserter(chunk.array));
+        chunk.card = chunk.array.size();
+        normalize(chunk);
+      } else {
+        uint64_t lhs_words[kBitmapWords], rhs_words[kBitmapWords];
+        toWords(*lhs_iter, lhs_words);
+        toWords(*rhs_iter, rhs_words);
+        for (unsigned idx = 0; idx < kBitmapWords; ++idx) {
+          lhs_words[idx] |= rhs_words[idx];
+        }
+        fromWords(chunk, lhs_words);
+      }
+      result.push_back(std::move(chunk));
+      ++lhs_iter;
+      ++rhs_iter;
+    }
+  }
+  _chunks = std::move(result);
+  return *this;
+}
+
+ChunkedSet &ChunkedSet::operator&=(const ChunkedSet &rhs) {
+  std::vector<Chunk> result;
+  auto rhs_iter = rhs._chunks.begin();
+  for (Chunk &lhs_chunk : _chunks) {
+    while (rhs_iter != rhs._chunks.end() && rhs_iter->key < lhs_chunk.key) {
+      ++rhs_iter;
+    }
+    if (rhs_iter == rhs._chunks.end()) {
+      break;
+    }
+    if (rhs_iter->key != lhs_chunk.key) {
+      continue;
+    }
+    Chunk chunk;
+    chunk.key = lhs_chunk.key;
+    if (!lhs_chunk.isBitmap() || !rhs_iter->isBitmap()) {
+      // 至少一侧是数组，结果不会超过 kArrayMax 个元素
+      const Chunk &array_chunk = lhs_chunk.isBitmap() ? *rhs_iter : lhs_chunk;
+      const Chunk &other = lhs_chunk.isBitmap() ? lhs_chunk : *rhs_iter;
+      if (other.isBitmap()) {
+        for (uint16_t low : array_chunk.array) {
+          if ((other.bitmap[low / 64] >> (low % 64)) & 1) {
+            chunk.array.push_back(low);
+          }
+        }
+      } else {
+        std::set_intersection(array_chunk.array.begin(),
+                              array_chunk.array.end(), other.array.begin(),
+                              other.array.end(),
+                              std::back_inserter(chunk.array));
+      }
+      chunk.card = chunk.array.size();
+      if (chunk.card == 0) {
+        continue;
+      }
+    } else {
+      uint64_t words[kBitmapWords];
+      for (unsigned idx = 0; idx < kBitmapWords; ++idx) {
+        words[idx] = lhs_chunk.bitmap[idx] & rhs_iter->bitmap[idx];
+      }
+      if (!fromWords(chunk, words)) {
+        continue;
+      }
+    }
+    result.push_back(std::move(chunk));
+  }
+  _chunks = std::move(result);
+  return *this;
+}
+
+ChunkedSet &ChunkedSet::subtract(const ChunkedSet &rhs) {
+  std::vector<Chunk> result;
+  result.reserve(_chunks.size());
+  auto rhs_iter = rhs._chunks.begin();
+  for (Chunk &lhs_chunk : _chunks) {
+    while (rhs_iter != rhs._chunks.end() && rhs_iter->key < lhs_chunk.key) {
+      ++rhs_iter;
+    }
+    if (rhs_iter == rhs._chunks.end() || rhs_iter->key != lhs_chunk.key) {
+      result.push_back(std::move(lhs_chunk));
+      continue;
+    }
+    Chunk chunk;
+    chunk.key = lhs_chunk.key;
+    if (!lhs_chunk.isBitmap()) {
+      // 左侧是数组，结果不会超过 kArrayMax 个元素
+      if (rhs_iter->isBitmap()) {
+        for (uint16_t low : lhs_chunk.array) {
+          if (!((rhs_iter->bitmap[low / 64] >> (low % 64)) & 1)) {
+            chunk.array.push_back(low);
+          }
+        }
+      } else {
+        std::set_difference(lhs_chunk.array.begin(), lhs_chunk.array.end(),
+                            rhs_iter->array.begin(), rhs_iter->array.end(),
+                            std::back_inserter(chunk.array));
+      }
+      chunk.card = chunk.array.size();
+      if (chunk.card == 0) {
+        continue;
+      }
+    } else {
+      uint64_t words[kBitmapWords];
+      toWords(*rhs_iter, words);
+      for (unsigned idx = 0; idx < kBitmapWords; ++idx) {
+        words[idx] = lhs_chunk.bitmap[idx] & ~words[idx];
+      }
+      if (!fromWords(chunk, words)) {
+        continue;
+      }
+    }
+    result.push_back(std::move(chunk));
+  }
+  _chunks = std::move(result);
+  return *this;
+}
+
+bool ChunkedSet::operator==(const ChunkedSet &rhs) const {
+  return _chunks == rhs._chunks;
+}
+
+bool ChunkedSet::transfer(ChunkedSet &out, const ChunkedSet &in,
+                          const ChunkedSet &gen, const ChunkedSet &kill) {
+  ChunkedSet result = in;
+  result.subtract(kill);
+  result |= gen;
+  if (result == out) {
+    return false;
+  }
+  out = std::move(result);
+  return true;
+}
+
+size_t ChunkedSet::getMemoryUsage() const {
+  size_t bytes = sizeof(*this) + _chunks.capacity() * sizeof(Chunk);
+  for (const Chunk &chunk : _chunks) {
+    bytes += chunk.array.capacity() * sizeof(uint16_t) +
+             chunk.bitmap.capacity() * sizeof(uint64_t);
+  }
+  return bytes;
+}
+
+size_t ChunkedSet::estimateMemory(double num_elems, double elems_per_chunk) {
+  elems_per_chunk = std::min(std::max(elems_per_chunk, 1.0),
+                             static_cast<double>(kChunkSize));
+  double num_chunks = std::ceil(num_elems / elems_per_chunk);
+  double container = elems_per_chunk > kArrayMax
+                         ? kBitmapWords * sizeof(uint64_t)
+                         : elems_per_chunk * sizeof(uint16_t);
+  return sizeof(ChunkedSet) +
+         static_cast<size_t>(num_chunks * (sizeof(Chunk) + container));
+}
+
+//-----------------------------------------------------------------------------
+// 启发式选择
+//-----------------------------------------------------------------------------
+size_t estimateSetMemory(SetKind kind, const SetProfile &profile) {
+  switch (kind) {
+  case SetKind::Sparse:
+    return SparseSet::estimateMemory(profile.elems_per_set,
+                                     profile.elems_per_segment);
+  case SetKind::Chunked:
+    return ChunkedSet::estimateMemory(profile.elems_per_set,
+                                      profile.elems_per_chunk);
+  case SetKind::Auto:
+  case SetKind::Dense:
+    break;
+  }
+  return DenseSet::estimateMemory(profile.domain_size);
+}
+
+SetKind chooseSetKind(const SetProfile &profile) {
+  size_t dense = estimateSetMemory(SetKind::Dense, profile);
+  SetKind best = SetKind::Dense;
+  size_t best_bytes = dense;
+  for (SetKind kind : {SetKind::Sparse, SetKind::Chunked}) {
+    size_t bytes = estimateSetMemory(kind, profile);
+    if (bytes * 2 < dense && bytes < best_bytes) {
+      best = kind;
+      best_bytes = bytes;
+    }
+  }
+  return best;
+}
+
+} // namespace dfa
@@ -0,0 +1,237 @@
+// 基于 SSA 的稀疏活跃变量分析
+#include "SparseLiveness.h"
+
+#include <algorithm>
+#include <cassert>
+
+#include <llvm/ADT/SmallVector.h>
+#include <llvm/IR/CFG.h>
+#include <llvm/IR/Instructions.h>
+#include <llvm/Support/raw_ostream.h>
+
+using namespace llvm;
+
+namespace {
+// 变量作为某个基本块中 phi 的取值时，来自哪个前驱：kManyPreds 表示来自多个
+// 不同的前驱，此时在该基本块的所有入边上都不活跃（见 Liveness::EdgeGenKill）
+constexpr int kManyPreds = -1;
+
+struct PhiBlock {
+  unsigned block;
+  int pred;
+};
+} // namespace
+
+SparseLiveness::SparseLiveness(const Function &F) {
+  // 1. 基本块编号；前驱由后继转置得到，与 CFGIndex 相同
+  _blocks.reserve(F.size());
+  _block_index.reserve(F.size());
+  for (const BasicBlock &bb : F) {
+    _block_index[&bb] = _blocks.size();
+    _blocks.push_back(&bb);
+  }
+  unsigned num_blocks = _blocks.size();
+  std::vector<unsigned> pred_begin(num_blocks + 1, 0), preds;
+  for (const BasicBlock *bb : _blocks) {
+    for (const BasicBlock *succ : successors(bb)) {
+      ++pred_begin[_block_index.lookup(succ) + 1];
+    }
+  }
+  for (unsigned block = 0; block < num_blocks; ++block) {
+    pred_begin[block + 1] += pred_begin[block];
+  }
+  preds.resize(pred_begin[num_blocks]);
+  std::vector<unsigned> cursor(pred_begin.begin(), pred_begin.end() - 1);
+  for (unsigned block = 0; block < num_blocks; ++block) {
+    for (const BasicBlock *succ : successors(_blocks[block])) {
+      preds[cursor[_block_index.lookup(succ)]++] = block;
+    }
+  }
+
+  // 2. 变量编号，与 Liveness::InitializeDomainFromInstruction 的顺序相同
+  for (const BasicBlock &bb : F) {
+    for (const Instruction &inst : bb) {
+      for (const Value *op : inst.operands()) {
+        if ((isa<Instruction>(op) || isa<Argument>(op)) &&
+            _value_index.try_emplace(op, _values.size()).second) {
+          _values.push_back(op);
+        }
+      }
+    }
+  }
+
+  // 3. 逐个变量回溯。变量按编号处理，每个基本块的列表因此自然有序。
+  // 标记数组以“变量编号 + 1”作为本轮的标记，不需要逐个变量清空
+  std::vector<unsigned> in_stamp(num_blocks, 0), out_stamp(num_blocks, 0);
+  std::vector<std::pair<unsigned, unsigned>> live_in, live_out;
+  SmallVector<unsigned, 32> worklist;
+  SmallVector<PhiBlock, 4> phi_blocks;
+  for (unsigned var = 0; var < _values.size(); ++var) {
+    const Value *val = _values[var];
+    unsigned stamp = var + 1;
+    const auto *def = dyn_cast<Instruction>(val);
+    int def_block = def ? static_cast<int>(_block_index.lookup(def->getParent()))
+                        : -1;
+
+    // 向上暴露的使用所在的基本块即为 live-in 的种子：定值所在的基本块中
+    // 只有位于定值之前的使用（phi）才算
+    phi_blocks.clear();
+    for (const Use &use : val->uses()) {
+      const auto *user = dyn_cast<Instruction>(use.getUser());
+      if (!user || user == val) {
+        continue;
+      }
+      unsigned block = _block_index.lookup(user->getParent());
+      if (const auto *phi = dyn_cast<PHINode>(user)) {
+        int pred = _block_index.lookup(phi->getIncomingBlock(use));
+        auto iter = std::find_if(
+            phi_blocks.begin(), phi_blocks.end(),
+            [block](const PhiBlock &entry) { return entry.block == block; });
+        if (iter == phi_blocks.end()) {
+          phi_blocks.push_back({block, pred});
+        } else if (iter->pred != pred) {
+          iter->pred = kManyPreds;
+        }
+      }
+      if (static_cast<int>(block) == def_block && !user->comesBefore(def)) {
+        continue;
+      }
+      if (in_stamp[block] != stamp) {
+        in_stamp[block] = stamp;
+        live_in.emplace_back(block, var);
+        worklist.push_back(block);
+      }
+    }
+
+    // 沿边 pred -> block 回溯，除非变量是 block 中 phi 来自其他前驱的取值
+    auto killedOnEdge = [&phi_blocks](unsigned pred, unsigned block) {
+      if (phi_blocks.empty()) {
+        return false;
+      }
+      for (const PhiBlock &entry : phi_blocks) {
+        if (entry.block == block) {
+          return entry.pred != static_cast<int>(pred);
+        }
+      }
+      return false;
+    };
+    while (!worklist.empty()) {
+      unsigned block = worklist.pop_back_val();
+      ++_num_visits;
+      for (unsigned slot = pred_begin[block]; slot < pred_begin[block + 1];
+           ++slot) {
+        unsigned pred = preds[slot];
+        if (killedOnEdge(pred, block)) {
+          continue;
+        }
+        if (out_stamp[pred] != stamp) {
+          out_stamp[pred] = stamp;
+          live_out.emplace_back(pred, var);
+        }
+        if (static_cast<int>(pred) != def_block && in_stamp[pred] != stamp) {
+          in_stamp[pred] = stamp;
+          live_in.emplace_back(pred, var);
+          worklist.push_back(pred);
+        }
+      }
+    }
+  }
+  _live_in = buildLists(num_blocks, live_in);
+  _live_out = buildLists(num_blocks, live_out);
+}
+
+SparseLiveness::BlockLists SparseLiveness::buildLists(
+    unsigned num_blocks,
+    const std::vector<std::pair<unsigned, unsigned>> &pairs) {
+  BlockLists lists;
+  lists.begin.assign(num_blocks + 1, 0);
+  for (const auto &pair : pairs) {
+    ++lists.begin[pair.first + 1];
+  }
+  for (unsigned block = 0; block < num_blocks; ++block) {
+    lists.begin[block + 1] += lists.begin[block];
+  }
+  lists.values.resize(pairs.size());
+  std::vector<unsigned> cursor(lists.begin.begin(), lists.begin.end() - 1);
+  for (const auto &pair : pairs) {
+    lists.values[cursor[pair.first]++] = pair.second;
+  }
+  return lists;
+}
+
+unsigned SparseLiveness::getBlockIndex(const BasicBlock &bb) const {
+  auto iter = _block_index.find(&bb);
+  assert(iter != _block_index.end() && "基本块不在函数中");
+  return iter->second;
+}
+
+BitVector SparseLiveness::toBitVector(ArrayRef<unsigned> list) const {
+  BitVector bv(getNumValues());
+  for (unsigned var : list) {
+    bv.set(var);
+  }
+  return bv;
+}
+
+BitVector SparseLiveness::getLiveInBV(const BasicBlock &bb) const {
+  return toBitVector(getLiveIn(bb));
+}
+
+BitVector SparseLiveness::getLiveOutBV(const BasicBlock &bb) const {
+  return toBitVector(getLiveOut(bb));
+}
+
+bool SparseLiveness::isLiveIn(const Value *val, const BasicBlock &bb) const {
+  int var = getValueIndex(val);
+  ArrayRef<unsigned> list = getLiveIn(bb);
+  return var != -1 && std::binary_search(list.begin(), list.end(), var);
+}
+
+bool SparseLiveness::isLiveOut(const Value *val, const BasicBlock &bb) const {
+  int var = getValueIndex(val);
+  ArrayRef<unsigned> list = getLiveOut(bb);
+  return var != -1 && std::binary_search(list.begin(), list.end(), var);
+}
+
+void SparseLiveness::print(raw_ostream &OS) const {
+  auto printList = [this, &OS](ArrayRef<unsigned> list) {
+    OS << "{";
+    bool first = true;
+    for (unsigned var : list) {
+      OS << (first ? "" : ", ");
+      _values[var]->printAsOperand(OS, false);
+      first = false;
+    }
+    OS << "}";
+  };
+  for (unsigned block = 0; block < getNumBlocks(); ++block) {
+    const BasicBlock &bb = getBlock(block);
+    OS << "bb" << block;
+    if (bb.hasName()) {
+      OS << " (" << bb.getName() << ")";
+    }
+    OS << ":\n  live-in:  ";
+    printList(getList(_live_in, block));
+    OS << "\n  live-out: ";
+    printList(getList(_live_out, block));
+    OS << "\n";
+  }
+}
+
+//-----------------------------------------------------------------------------
+// New PM implementation
+//-----------------------------------------------------------------------------
+AnalysisKey SparseLivenessAnalysis::Key;
+
+SparseLivenessAnalysis::Result
+SparseLivenessAnalysis::run(Function &F, FunctionAnalysisManager &) {
+  return SparseLiveness(F);
+}
+
+PreservedAnalyses SparseLivenessPrinter::run(Function &F,
+                                             FunctionAnalysisManager &FAM) {
+  OS << "Printing analysis 'Sparse liveness' for function '" << F.getName()
+     << "':\n";
+  FAM.getResult<SparseLivenessAnalysis>(F).print(OS);
+  return PreservedAnalyses::all();
+}
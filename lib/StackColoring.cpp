@@ -0,0 +1,372 @@
+// 基于活跃性的栈槽着色
+#include "StackColoring.h"
+
+#include <algorithm>
+#include <cassert>
+#include <numeric>
+
+#include <llvm/ADT/Statistic.h>
+#include <llvm/Analysis/OptimizationRemarkEmitter.h>
+#include <llvm/IR/Constants.h>
+#include <llvm/Support/raw_ostream.h>
+
+#define DEBUG_TYPE "dfa-stack-coloring"
+
+STATISTIC(NumSlotsMerged, "Number of allocas merged into another stack slot");
+STATISTIC(NumFrameBytesSaved,
+          "Bytes of static stack frame saved by merging allocas");
+
+using namespace llvm;
+
+raw_ostream &operator<<(raw_ostream &outs, const StackSlot &slot) {
+  outs << "[";
+  slot._alloca->printAsOperand(outs, false);
+  outs << "]";
+  return outs;
+}
+
+namespace {
+// alloca 的大小（字节），动态大小或可伸缩类型时返回 0
+uint64_t getAllocaSize(const AllocaInst &alloca, const DataLayout &DL) {
+  auto bits = alloca.getAllocationSizeInBits(DL);
+  if (!bits || bits->isScalable()) {
+    return 0;
+  }
+  return (bits->getFixedValue() + 7) / 8;
+}
+
+// 入口块中静态 alloca 按顺序布局得到的栈帧大小（字节）
+uint64_t getFrameSize(const Function &F, const DataLayout &DL) {
+  uint64_t offset = 0;
+  for (const Instruction &inst : F.getEntryBlock()) {
+    const auto *alloca = dyn_cast<AllocaInst>(&inst);
+    if (alloca && alloca->isStaticAlloca()) {
+      offset = alignTo(offset, alloca->getAlign()) + getAllocaSize(*alloca, DL);
+    }
+  }
+  return offset;
+}
+
+// 长度为常量且不小于 size
+bool coversSize(const Value *len, uint64_t size) {
+  const auto *constant = dyn_cast<ConstantInt>(len);
+  return constant && constant->getValue().uge(size);
+}
+
+// 删除生命期标记，以及只被它使用的 bitcast/GEP
+void eraseMarker(IntrinsicInst *marker) {
+  Value *ptr = marker->getArgOperand(1);
+  marker->eraseFromParent();
+  while (auto *inst = dyn_cast<Instruction>(ptr)) {
+    if (isa<AllocaInst>(inst) || !inst->use_empty()) {
+      break;
+    }
+    ptr = inst->getOperand(0);
+    inst->eraseFromParent();
+  }
+}
+} // namespace
+
+StackSlotInfo::StackSlotInfo(Function &F, const DataLayout &DL) {
+  if (F.isDeclaration()) {
+    return;
+  }
+  for (Instruction &inst : F.getEntryBlock()) {
+    auto *alloca = dyn_cast<AllocaInst>(&inst);
+    if (!alloca || !alloca->isStaticAlloca() || alloca->isSwiftError() ||
+        alloca->isUsedWithInAlloca()) {
+      continue;
+    }
+    uint64_t size = getAllocaSize(*alloca, DL);
+    if (size == 0) {
+      continue;
+    }
+
+    // 沿 bitcast/GEP 得到的派生地址收集访问。at_base 表示派生地址与
+    // alloca 的偏移为 0
+    SmallVector<std::pair<Instruction *, SlotAccess::Kind>, 8> accesses;
+    SmallVector<IntrinsicInst *, 2> markers;
+    SmallVector<std::pair<Value *, bool>, 8> worklist{{alloca, true}};
+    bool escaped = false, has_start = false, partial_marker = false;
+    while (!worklist.empty()) {
+      Value *ptr = worklist.back().first;
+      bool at_base = worklist.back().second;
+      worklist.pop_back();
+      for (Use &use : ptr->uses()) {
+        auto *user = dyn_cast<Instruction>(use.getUser());
+        if (!user) {
+          escaped = true;
+        } else if (isa<LoadInst>(user)) {
+          accesses.emplace_back(user, SlotAccess::Read);
+        } else if (auto *store = dyn_cast<StoreInst>(user)) {
+          if (use.getOperandNo() != StoreInst::getPointerOperandIndex()) {
+            escaped = true;
+            continue;
+          }
+          TypeSize store_size =
+              DL.getTypeStoreSize(store->getValueOperand()->getType());
+          bool whole = at_base && !store_size.isScalable() &&
+                       store_size.getFixedValue() >= size;
+          accesses.emplace_back(user, whole ? SlotAccess::Overwrite
+                                            : SlotAccess::Write);
+        } else if (isa<BitCastInst>(user) || isa<AddrSpaceCastInst>(user)) {
+          worklist.emplace_back(user, at_base);
+        } else if (auto *gep = dyn_cast<GetElementPtrInst>(user)) {
+          worklist.emplace_back(user, at_base && gep->hasAllZeroIndices());
+        } else if (auto *intrinsic = dyn_cast<IntrinsicInst>(user)) {
+          if (intrinsic->isLifetimeStartOrEnd()) {
+            // 只接受覆盖整个栈槽的标记
+            const Value *len = intrinsic->getArgOperand(0);
+            if (!at_base || !(cast<ConstantInt>(len)->isMinusOne() ||
+                              coversSize(len, size))) {
+              partial_marker = true;
+            }
+            bool start =
+                intrinsic->getIntrinsicID() == Intrinsic::lifetime_start;
+            has_start |= start;
+            markers.push_back(intrinsic);
+            accesses.emplace_back(user, start ? SlotAccess::LifetimeStart
+                                              : SlotAccess::LifetimeEnd);
+          } else if (isa<DbgInfoIntrinsic>(intrinsic)) {
+            continue;
+          } else if (auto *mem = dyn_cast<MemIntrinsic>(intrinsic)) {
+            if (use.getOperandNo() == 0) {
+              bool whole = at_base && coversSize(mem->getLength(), size);
+              accesses.emplace_back(user, whole ? SlotAccess::Overwrite
+                                                : SlotAccess::Write);
+            } else if (isa<MemTransferInst>(mem) && use.getOperandNo() == 1) {
+              accesses.emplace_back(user, SlotAccess::Read);
+            } else {
+              escaped = true;
+            }
+          } else {
+            escaped = true;
+          }
+        } else {
+          escaped = true;
+        }
+      }
+    }
+    if (partial_marker || (escaped && !has_start)) {
+      continue;
+    }
+
+    unsigned slot = _slots.size();
+    _slot_index[alloca] = slot;
+    _slots.push_back({alloca, size, alloca->getAlign(), !escaped, markers});
+    for (const auto &access : accesses) {
+      // 逃逸的栈槽只有生命期标记有意义
+      if (escaped && access.second != SlotAccess::LifetimeStart &&
+          access.second != SlotAccess::LifetimeEnd) {
+        continue;
+      }
+      _accesses[access.first].push_back({slot, access.second});
+    }
+  }
+}
+
+//-----------------------------------------------------------------------------
+// 数据流分析：两个分析的域都是全部栈槽，按入口块中的顺序编号
+//-----------------------------------------------------------------------------
+void StackSlotLiveness::GenKill(const solver_t &solver, const Instruction &inst,
+                                SmallVectorImpl<unsigned> &gen,
+                                SmallVectorImpl<unsigned> &kill) const {
+  for (const SlotAccess &access : _info.getAccesses(inst)) {
+    if (!_info.getSlots()[access.slot].tracked) {
+      continue;
+    }
+    switch (access.kind) {
+    case SlotAccess::Read:
+      gen.push_back(access.slot);
+      break;
+    case SlotAccess::Overwrite:
+    case SlotAccess::LifetimeStart:
+    case SlotAccess::LifetimeEnd:
+      kill.push_back(access.slot);
+      break;
+    case SlotAccess::Write:
+      break;
+    }
+  }
+}
+
+void StackSlotLiveness::InitializeDomainFromInstruction(
+    solver_t &solver, const Instruction &inst) const {
+  const auto *alloca = dyn_cast<AllocaInst>(&inst);
+  if (alloca && _info.getSlotIndex(alloca) != -1) {
+    solver.addDomainElement(StackSlot(alloca));
+  }
+}
+
+void StackSlotLifetime::GenKill(const solver_t &solver, const Instruction &inst,
+                                SmallVectorImpl<unsigned> &gen,
+                                SmallVectorImpl<unsigned> &kill) const {
+  for (const SlotAccess &access : _info.getAccesses(inst)) {
+    if (_info.getSlots()[access.slot].tracked) {
+      continue;
+    }
+    if (access.kind == SlotAccess::LifetimeStart) {
+      gen.push_back(access.slot);
+    } else if (access.kind == SlotAccess::LifetimeEnd) {
+      kill.push_back(access.slot);
+    }
+  }
+}
+
+void StackSlotLifetime::InitializeDomainFromInstruction(
+    solver_t &solver, const Instruction &inst) const {
+  const auto *alloca = dyn_cast<AllocaInst>(&inst);
+  if (alloca && _info.getSlotIndex(alloca) != -1) {
+    solver.addDomainElement(StackSlot(alloca));
+  }
+}
+
+//-----------------------------------------------------------------------------
+// New PM implementation
+//-----------------------------------------------------------------------------
+PreservedAnalyses StackColoringPass::run(Function &F,
+                                         FunctionAnalysisManager &FAM) {
+  const DataLayout &DL = F.getParent()->getDataLayout();
+  StackSlotInfo info(F, DL);
+  ArrayRef<StackSlotInfo::Slot> slots = info.getSlots();
+  unsigned num_slots = slots.size();
+  if (num_slots < 2) {
+    return PreservedAnalyses::all();
+  }
+
+  // 1. 冲突图。每条指令处被占用的栈槽两两冲突：指令之后活跃的、被指令
+  // 读写的不逃逸栈槽，以及指令之前或之后处于生命期内的逃逸栈槽
+  StackSlotLiveness liveness(info);
+  StackSlotLifetime lifetime(info);
+  auto live = liveness.solve(F);
+  auto alive = lifetime.solve(F);
+  assert(live->getDomainSize() == num_slots &&
+         alive->getDomainSize() == num_slots);
+  std::vector<BitVector> interference(num_slots, BitVector(num_slots));
+  BitVector last_clique;
+  auto addClique = [&](const BitVector &occupied) {
+    if (occupied.count() < 2 || occupied == last_clique) {
+      return;
+    }
+    for (unsigned slot : occupied.set_bits()) {
+      interference[slot] |= occupied;
+    }
+    last_clique = occupied;
+  };
+  std::vector<BitVector> alive_before;
+  for (const BasicBlock &bb : F) {
+    alive_before.clear();
+    BitVector alive_bv = alive->getInputBV(bb);
+    for (const Instruction &inst : bb) {
+      alive_before.push_back(alive_bv);
+      alive->TransferFunc(inst, alive_bv);
+    }
+    // 后向分析的输入集合为 OUT[B]
+    BitVector live_bv = live->getInputBV(bb);
+    unsigned pos = alive_before.size();
+    for (const Instruction &inst : make_range(bb.rbegin(), bb.rend())) {
+      --pos;
+      BitVector occupied = live_bv;
+      occupied |= alive_bv;
+      occupied |= alive_before[pos];
+      for (const SlotAccess &access : info.getAccesses(inst)) {
+        if (slots[access.slot].tracked &&
+            (access.kind == SlotAccess::Read ||
+             access.kind == SlotAccess::Write ||
+             access.kind == SlotAccess::Overwrite)) {
+          occupied.set(access.slot);
+        }
+      }
+      addClique(occupied);
+      live->TransferFunc(inst, live_bv);
+      alive_bv = alive_before[pos];
+    }
+  }
+
+  // 2. 按大小、对齐从大到小贪心着色。栈槽加入第一个与所有成员都不冲突、
+  // 代表（最先加入的栈槽）的大小与对齐都不小于它的颜色
+  std::vector<unsigned> order(num_slots);
+  std::iota(order.begin(), order.end(), 0);
+  std::stable_sort(order.begin(), order.end(), [&](unsigned lhs, unsigned rhs) {
+    if (slots[lhs].size != slots[rhs].size) {
+      return slots[lhs].size > slots[rhs].size;
+    }
+    return slots[lhs].align > slots[rhs].align;
+  });
+  struct Color {
+    unsigned rep;
+    BitVector members;
+  };
+  std::vector<Color> colors;
+  for (unsigned slot : order) {
+    const StackSlotInfo::Slot &curr = slots[slot];
+    auto iter = llvm::find_if(colors, [&](const Color &color) {
+      const StackSlotInfo::Slot &rep = slots[color.rep];
+      return rep.alloca->getType()->getPointerAddressSpace() ==
+                 curr.alloca->getType()->getPointerAddressSpace() &&
+             curr.size <= rep.size && curr.align <= rep.align &&
+             !interference[slot].anyCommon(color.members);
+    });
+    if (iter == colors.end()) {
+      colors.push_back({slot, BitVector(num_slots)});
+      iter = colors.end() - 1;
+    }
+    iter->members.set(slot);
+  }
+  if (colors.size() == num_slots) {
+    return PreservedAnalyses::all();
+  }
+
+  // 3. 合并：成员替换为代表（类型不同时经过 bitcast），代表移到所有成员
+  // 之前。合并后的栈槽不再有单一的生命期，删去所有成员的生命期标记
+  uint64_t frame_before = getFrameSize(F, DL);
+  unsigned num_merged = 0;
+  for (const Color &color : colors) {
+    if (color.members.count() < 2) {
+      continue;
+    }
+    AllocaInst *rep = slots[color.rep].alloca;
+    for (unsigned slot : color.members.set_bits()) {
+      AllocaInst *alloca = slots[slot].alloca;
+      if (slot == color.rep) {
+        continue;
+      }
+      if (alloca->comesBefore(rep)) {
+        rep->moveBefore(alloca);
+      }
+      Value *repl = rep;
+      if (rep->getType() != alloca->getType()) {
+        repl = new BitCastInst(rep, alloca->getType(), "", alloca);
+        repl->takeName(alloca);
+      }
+      alloca->replaceAllUsesWith(repl);
+      alloca->eraseFromParent();
+      ++num_merged;
+    }
+    for (unsigned slot : color.members.set_bits()) {
+      for (IntrinsicInst *marker : slots[slot].markers) {
+        eraseMarker(marker);
+      }
+    }
+  }
+  uint64_t frame_after = getFrameSize(F, DL);
+  int64_t saved = static_cast<int64_t>(frame_before) -
+                  static_cast<int64_t>(frame_after);
+  NumSlotsMerged += num_merged;
+  NumFrameBytesSaved += std::max<int64_t>(saved, 0);
+
+  OptimizationRemarkEmitter &ORE =
+      FAM.getResult<OptimizationRemarkEmitterAnalysis>(F);
+  ORE.emit([&] {
+    return OptimizationRemark(DEBUG_TYPE, "StackSlotsMerged", &F)
+           << "merged " << ore::NV("MergedAllocas", num_merged) << " of "
+           << ore::NV("Candidates", num_slots) << " allocas; frame "
+           << ore::NV("FrameBytesBefore", frame_before) << " -> "
+           << ore::NV("FrameBytesAfter", frame_after) << " bytes, "
+           << ore::NV("FrameBytesSaved", saved) << " saved";
+  });
+
+  PreservedAnalyses PA;
+  PA.preserveSet<CFGAnalyses>();
+  return PA;
+}
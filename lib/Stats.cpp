@@ -0,0 +1,153 @@
+// dfa::Framework 的求解代价统计：STATISTIC、-time-passes 计时、
+// 逐函数的 CSV 与遍数过多的警告
+#include "cscd70/stats.h"
+
+#include <algorithm>
+#include <limits>
+#include <memory>
+#include <mutex>
+
+#include <llvm/ADT/Statistic.h>
+#include <llvm/ADT/StringMap.h>
+#include <llvm/Pass.h>
+#include <llvm/Support/ErrorHandling.h>
+#include <llvm/Support/FileSystem.h>
+#include <llvm/Support/Format.h>
+#include <llvm/Support/ManagedStatic.h>
+#include <llvm/Support/raw_ostream.h>
+
+#include "cscd70/framework.h"
+
+#define DEBUG_TYPE "dfa"
+
+STATISTIC(NumFunctionsSolved, "Number of function solves by dfa::Framework");
+STATISTIC(NumBlockVisits, "Number of basic block visits (meet + transfer)");
+STATISTIC(NumTransfers, "Number of transfer function invocations");
+STATISTIC(NumSweeps, "Number of sweeps over the blocks of solved functions");
+STATISTIC(MaxSweeps, "Largest number of sweeps in a single function");
+STATISTIC(MaxPeakSetBytes, "Largest peak block-set memory of a single "
+                           "function, in bytes");
+STATISTIC(NumSweepWarnings, "Number of functions over -dfa-sweep-warning");
+
+using namespace llvm;
+
+namespace dfa {
+
+cl::opt<std::string>
+    DFAStatsCSV("dfa-stats-csv",
+                cl::desc("Write one CSV row of solver cost (visits, "
+                         "transfers, sweeps, peak set memory, wall time) per "
+                         "solved function to this file"),
+                cl::value_desc("filename"), cl::init(""));
+
+cl::opt<unsigned> DFASweepWarning(
+    "dfa-sweep-warning",
+    cl::desc("Warn about functions whose dataflow solve takes more than "
+             "this many sweeps over their blocks (0 = never); what counts "
+             "as a sweep depends on -dfa-solver"),
+    cl::init(0));
+
+namespace {
+// 多个线程共享的输出状态。-time-passes 的计时在 llvm_shutdown 销毁本对象时
+// 作为一个计时器组输出：Timer 不能在多个线程上同时计时，因此各线程测得的
+// 时间在这里按分析名累加，最后交给 TimerGroup 输出
+struct StatsState {
+  std::mutex lock;
+  std::unique_ptr<raw_fd_ostream> csv;
+  StringMap<TimeRecord> times;
+
+  ~StatsState() {
+    if (times.empty()) {
+      return;
+    }
+    TimerGroup group("dfa", "Data-flow analysis solving", times);
+    group.print(*CreateInfoOutputFile());
+  }
+
+  raw_ostream &getCSV() {
+    if (!csv) {
+      std::error_code EC;
+      csv = std::make_unique<raw_fd_ostream>(DFAStatsCSV, EC,
+                                             sys::fs::OF_Text);
+      if (EC) {
+        report_fatal_error("dfa: cannot open '" + Twine(DFAStatsCSV) +
+                           "': " + EC.message());
+      }
+      *csv << "function,analysis,blocks,insts,domain,set,solver,cached,"
+              "visits,transfers,sweeps,peak_bytes,wall_ms\n";
+    }
+    return *csv;
+  }
+};
+
+ManagedStatic<StatsState> State;
+
+// 函数名可能含有逗号或引号，按 RFC 4180 加引号
+void writeCSVField(raw_ostream &OS, StringRef field) {
+  if (field.find_first_of(",\"\n") == StringRef::npos) {
+    OS << field;
+    return;
+  }
+  OS << '"';
+  for (char c : field) {
+    if (c == '"') {
+      OS << '"';
+    }
+    OS << c;
+  }
+  OS << '"';
+}
+
+unsigned saturate(uint64_t value) {
+  return static_cast<unsigned>(
+      std::min<uint64_t>(value, std::numeric_limits<unsigned>::max()));
+}
+} // namespace
+
+bool isSetMemoryTracked() {
+  return DFASetStats || !DFAStatsCSV.empty() || AreStatisticsEnabled();
+}
+
+bool isSolveTimed() { return TimePassesIsEnabled || !DFAStatsCSV.empty(); }
+
+void recordSolveStats(const Function &F, StringRef analysis,
+                      const SolveStats &stats) {
+  ++NumFunctionsSolved;
+  NumBlockVisits += stats.visits;
+  NumTransfers += stats.transfers;
+  NumSweeps += stats.sweeps;
+  MaxSweeps.updateMax(stats.sweeps);
+  MaxPeakSetBytes.updateMax(saturate(stats.peak_memory));
+
+  bool warn = DFASweepWarning != 0 && stats.sweeps > DFASweepWarning;
+  bool timed = isSolveTimed();
+  if (!warn && !timed) {
+    return;
+  }
+  std::lock_guard<std::mutex> guard(State->lock);
+  if (warn) {
+    ++NumSweepWarnings;
+    errs() << "dfa: warning: function '" << F.getName() << "': " << analysis
+           << " took " << stats.sweeps << " sweeps over " << stats.num_blocks
+           << " blocks (" << stats.visits << " visits, -dfa-solver="
+           << getSolverKindName(stats.solver_kind)
+           << ", -dfa-sweep-warning=" << DFASweepWarning << ")\n";
+  }
+  if (TimePassesIsEnabled) {
+    State->times[analysis] += stats.time;
+  }
+  if (!DFAStatsCSV.empty()) {
+    raw_ostream &OS = State->getCSV();
+    writeCSVField(OS, F.getName());
+    OS << ",";
+    writeCSVField(OS, analysis);
+    OS << "," << stats.num_blocks << "," << stats.num_insts << ","
+       << stats.domain_size << "," << getSetKindName(stats.set_kind) << ","
+       << getSolverKindName(stats.solver_kind) << ","
+       << (stats.cached ? 1 : 0) << "," << stats.visits << ","
+       << stats.transfers << "," << stats.sweeps << "," << stats.peak_memory
+       << "," << format("%.3f", stats.time.getWallTime() * 1000) << "\n";
+  }
+}
+
+} // namespace dfa
@@ -0,0 +1,398 @@
+//=============================================================================
+// FILE:
+//    FrameworkBench.cpp
+//
+// DESCRIPTION:
+//    dfa::Framework 求解器的基准测试。在内存中生成合成的函数，控制流图由
+//    以下参数决定：
+//      * blocks      : 基本块数
+//      * depth       : 循环的最大嵌套深度，每层有 -loop-fanout 个并列的循环
+//      * irreducible : 每个循环多一个入口（从循环之前跳入循环体中间）的概率，
+//                      这样的循环是不可归约的
+//      * domain      : 二元运算指令的总数，即活跃变量分析的域（另加形参与
+//                      比较指令）与可用表达式分析的域（去重之后）的规模
+//    对每种组合，用每种求解策略（-solvers）分别求解 Liveness 与 AvailExpr，
+//    重复 -reps 次，输出一行 CSV：生成参数、实际的域大小、访问次数、遍数
+//    以及求解时间的最小值与中位数。生成器只依赖参数与 -seed，因此不同提交
+//    的输出可以按前几列对齐比较，用来发现求解器随规模变化的退化。
+//    每种组合另有一行 SparseLiveness（solver 为 sparse），与稠密的 Liveness
+//    比较；它不迭代，visits 为回溯时处理基本块的次数，sweeps 为 0。
+//
+// USAGE:
+//    dfa-bench [-blocks=256,4096] [-depth=1,4] [-irreducible=0,0.25]
+//              [-domain=512,8192] [-solvers=worklist,scc] [-reps=5]
+//              [-dfa-set=...] > bench.csv
+//
+// License: MIT
+//=============================================================================
+#include "AvailExpr.h"
+#include "Liveness.h"
+#include "SparseLiveness.h"
+
+#include <llvm/IR/IRBuilder.h>
+#include <llvm/IR/LLVMContext.h>
+#include <llvm/IR/Module.h>
+#include <llvm/IR/Verifier.h>
+#include <llvm/Support/CommandLine.h>
+#include <llvm/Support/Format.h>
+#include <llvm/Support/raw_ostream.h>
+
+#include <algorithm>
+#include <chrono>
+#include <random>
+
+using namespace llvm;
+
+static cl::list<unsigned>
+    Blocks("blocks", cl::desc("Block counts of the generated functions "
+                              "(default: 256,4096)"),
+           cl::CommaSeparated);
+static cl::list<unsigned>
+    Depths("depth", cl::desc("Maximum loop nesting depths (default: 1,4)"),
+           cl::CommaSeparated);
+static cl::list<double> Irreducible(
+    "irreducible",
+    cl::desc("Probabilities that a loop gets a second entry into its body "
+             "(default: 0,0.25)"),
+    cl::CommaSeparated);
+static cl::list<unsigned>
+    Domains("domain",
+            cl::desc("Number of binary instructions, which sets the domain "
+                     "size of both analyses (default: 512,8192)"),
+            cl::CommaSeparated);
+static cl::list<dfa::SolverKind> Solvers(
+    "solvers",
+    cl::desc("Solvers to time (default: worklist,scc; round-robin needs "
+             "about as many sweeps as blocks for backward analyses)"),
+    cl::CommaSeparated,
+    cl::values(clEnumValN(dfa::SolverKind::RoundRobin, "round-robin", ""),
+               clEnumValN(dfa::SolverKind::Worklist, "worklist", ""),
+               clEnumValN(dfa::SolverKind::SCC, "scc", "")));
+static cl::opt<unsigned> LoopFanout("loop-fanout",
+                                    cl::desc("Sibling loops per nesting level"),
+                                    cl::init(2));
+static cl::opt<unsigned> Reps("reps", cl::desc("Timed solves per row"),
+                              cl::init(5));
+static cl::opt<unsigned> Seed("seed", cl::desc("Generator seed"),
+                              cl::init(70));
+static cl::opt<bool> Verify("verify",
+                            cl::desc("Run the IR verifier on every generated "
+                                     "function and check that SparseLiveness "
+                                     "agrees with Liveness"),
+                            cl::init(false));
+
+namespace {
+
+struct Shape {
+  unsigned blocks, depth, domain;
+  double irreducible;
+};
+
+// 抽象的控制流图：基本块按布局顺序编号，循环为区间 [head, latch]，
+// latch 跳回 head；区间互相嵌套或不相交
+class CFGShape {
+public:
+  CFGShape(const Shape &shape, std::mt19937 &rng)
+      : _num_blocks(std::max(shape.blocks, 2u)), _rng(rng),
+        _succs(_num_blocks), _loop_of(_num_blocks, -1) {
+    // 入口块不能有前驱，不放在循环中
+    nest(1, _num_blocks - 1, shape.depth, -1);
+    for (unsigned block = 0; block + 1 < _num_blocks; ++block) {
+      _succs[block].push_back(block + 1);
+    }
+    for (const Loop &loop : _loops) {
+      _succs[loop.latch].push_back(loop.head);
+    }
+    addForwardEdges();
+    addSecondEntries(shape.irreducible);
+  }
+
+  unsigned getNumBlocks() const { return _num_blocks; }
+  const std::vector<unsigned> &getSuccs(unsigned block) const {
+    return _succs[block];
+  }
+
+private:
+  struct Loop {
+    unsigned head, latch;
+    int parent;
+  };
+
+  // 把 [lo, hi) 分成 LoopFanout 段，每段成为一个循环，在循环体内递归
+  void nest(unsigned lo, unsigned hi, unsigned depth, int parent) {
+    if (depth == 0) {
+      return;
+    }
+    unsigned fanout = std::max(1u, unsigned(LoopFanout));
+    unsigned length = hi - lo;
+    for (unsigned idx = 0; idx < fanout; ++idx) {
+      unsigned begin = lo + length * idx / fanout,
+               end = lo + length * (idx + 1) / fanout;
+      // 循环至少要有头与回边所在的基本块，并且回边所在的基本块不能是
+      // 外层循环的回边
+      if (end < begin + 2) {
+        continue;
+      }
+      unsigned loop = _loops.size();
+      _loops.push_back({begin, end - 1, parent});
+      for (unsigned block = begin; block < end; ++block) {
+        _loop_of[block] = loop;
+      }
+      nest(begin + 1, end - 1, depth - 1, loop);
+    }
+  }
+
+  bool inLoop(unsigned block, int loop) const {
+    return loop == -1 || (_loops[loop].head <= block &&
+                          block <= _loops[loop].latch);
+  }
+
+  // 跳过若干基本块的前向边（if/else 的形状）。目标所在而源不在的循环都必须
+  // 以目标为头，否则会产生新的入口
+  void addForwardEdges() {
+    std::bernoulli_distribution branch(0.3);
+    for (unsigned block = 0; block + 2 < _num_blocks; ++block) {
+      if (_succs[block].size() != 1 || !branch(_rng)) {
+        continue;
+      }
+      unsigned target = std::uniform_int_distribution<unsigned>(
+          block + 2, std::min(block + 8, _num_blocks - 1))(_rng);
+      bool valid = true;
+      for (int loop = _loop_of[target]; loop != -1;
+           loop = _loops[loop].parent) {
+        if (!inLoop(block, loop) && _loops[loop].head != target) {
+          valid = false;
+          break;
+        }
+      }
+      if (valid) {
+        _succs[block].push_back(target);
+      }
+    }
+  }
+
+  // 以给定的概率从循环之前（同一个外层循环中）跳到循环体中的某个基本块
+  void addSecondEntries(double probability) {
+    std::bernoulli_distribution entry(probability);
+    for (const Loop &loop : _loops) {
+      if (!entry(_rng) || loop.latch == loop.head) {
+        continue;
+      }
+      unsigned lo = loop.parent == -1 ? 0 : _loops[loop.parent].head;
+      unsigned source = std::uniform_int_distribution<unsigned>(
+          lo, loop.head - 1)(_rng);
+      unsigned target = std::uniform_int_distribution<unsigned>(
+          loop.head + 1, loop.latch)(_rng);
+      // 源必须直接在外层循环中，而不在与它并列的循环中
+      if (_loop_of[source] != loop.parent) {
+        continue;
+      }
+      _succs[source].push_back(target);
+    }
+  }
+
+  unsigned _num_blocks;
+  std::mt19937 &_rng;
+  std::vector<std::vector<unsigned>> _succs;
+  // 每个基本块所在的最内层循环，-1 表示不在循环中
+  std::vector<int> _loop_of;
+  std::vector<Loop> _loops;
+};
+
+// 按 CFGShape 生成函数 i32 @bench(i32, i32, i32, i32)。入口块定义一组
+// 公共值，其余基本块中的运算一半使用公共值（活跃区间跨越整个函数，
+// 表达式在多个基本块中重复出现），一半使用本块中前面的结果
+Function *buildFunction(Module &M, const Shape &shape, std::mt19937 &rng) {
+  LLVMContext &ctx = M.getContext();
+  Type *i32 = Type::getInt32Ty(ctx);
+  auto *type = FunctionType::get(i32, {i32, i32, i32, i32}, false);
+  Function *F = Function::Create(type, Function::ExternalLinkage, "bench", M);
+  CFGShape cfg(shape, rng);
+  unsigned num_blocks = cfg.getNumBlocks();
+  std::vector<BasicBlock *> bbs;
+  for (unsigned block = 0; block < num_blocks; ++block) {
+    bbs.push_back(BasicBlock::Create(ctx, "", F));
+  }
+
+  const Instruction::BinaryOps opcodes[] = {
+      Instruction::Add, Instruction::Sub, Instruction::Mul,
+      Instruction::Xor, Instruction::And, Instruction::Or};
+  auto pick = [&rng](const std::vector<Value *> &values) {
+    return values[std::uniform_int_distribution<size_t>(
+        0, values.size() - 1)(rng)];
+  };
+  auto makeOp = [&](IRBuilder<> &builder, Value *lhs, Value *rhs) {
+    return builder.CreateBinOp(
+        opcodes[std::uniform_int_distribution<unsigned>(0, 5)(rng)], lhs, rhs);
+  };
+  // 实参的求值顺序没有规定，随机数按固定的顺序取出，输出才与编译器无关
+
+  IRBuilder<> builder(bbs[0]);
+  std::vector<Value *> pool;
+  for (Argument &arg : F->args()) {
+    pool.push_back(&arg);
+  }
+  unsigned pool_size = std::max(4u, shape.domain / 8);
+  for (unsigned idx = 0; idx < pool_size; ++idx) {
+    Value *lhs = pick(pool);
+    Value *rhs = pick(pool);
+    pool.push_back(makeOp(builder, lhs, rhs));
+  }
+  unsigned remaining = shape.domain > pool_size ? shape.domain - pool_size : 0;
+
+  std::bernoulli_distribution use_pool(0.5);
+  for (unsigned block = 0; block < num_blocks; ++block) {
+    builder.SetInsertPoint(bbs[block]);
+    unsigned count = remaining / (num_blocks - block);
+    remaining -= count;
+    std::vector<Value *> local{pick(pool)};
+    for (unsigned idx = 0; idx < count; ++idx) {
+      Value *lhs = use_pool(rng) ? pick(pool) : local.back();
+      Value *rhs = pick(pool);
+      local.push_back(makeOp(builder, lhs, rhs));
+    }
+
+    const std::vector<unsigned> &succs = cfg.getSuccs(block);
+    if (succs.empty()) {
+      builder.CreateRet(local.back());
+    } else if (succs.size() == 1) {
+      builder.CreateBr(bbs[succs[0]]);
+    } else if (succs.size() == 2) {
+      Value *cond = builder.CreateICmpSLT(local.back(), pick(pool));
+      builder.CreateCondBr(cond, bbs[succs[1]], bbs[succs[0]]);
+    } else {
+      SwitchInst *sw =
+          builder.CreateSwitch(local.back(), bbs[succs[0]], succs.size() - 1);
+      for (unsigned idx = 1; idx < succs.size(); ++idx) {
+        sw->addCase(builder.getInt32(idx), bbs[succs[idx]]);
+      }
+    }
+  }
+  return F;
+}
+
+template <typename TAnalysis>
+void benchAnalysis(StringRef name, const Shape &shape, const Function &F,
+                   dfa::SolverKind solver_kind, StringRef solver_name) {
+  TAnalysis analysis;
+  analysis.setSolverKind(solver_kind);
+  std::vector<double> times;
+  std::unique_ptr<typename TAnalysis::solver_t> solver;
+  for (unsigned rep = 0; rep < std::max(1u, unsigned(Reps)); ++rep) {
+    auto start = std::chrono::steady_clock::now();
+    solver = analysis.solve(F);
+    auto end = std::chrono::steady_clock::now();
+    times.push_back(
+        std::chrono::duration<double, std::milli>(end - start).count());
+  }
+  std::sort(times.begin(), times.end());
+  outs() << shape.blocks << "," << shape.depth << ","
+         << format("%g", shape.irreducible) << "," << shape.domain << ","
+         << Seed << "," << name << "," << solver_name << ","
+         << dfa::getSetKindName(solver->getSetKind()) << ","
+         << solver->getDomainSize() << "," << solver->getNumInsts() << ","
+         << solver->getNumVisits() << "," << solver->getNumSweeps() << ","
+         << format("%.3f", times.front()) << ","
+         << format("%.3f", times[times.size() / 2]) << "\n";
+}
+
+// SparseLiveness 的一行。-verify 时与 Liveness 的结果逐块比较，不一致时
+// 返回 false
+bool benchSparseLiveness(const Shape &shape, const Function &F) {
+  std::vector<double> times;
+  std::unique_ptr<SparseLiveness> sparse;
+  for (unsigned rep = 0; rep < std::max(1u, unsigned(Reps)); ++rep) {
+    auto start = std::chrono::steady_clock::now();
+    sparse = std::make_unique<SparseLiveness>(F);
+    auto end = std::chrono::steady_clock::now();
+    times.push_back(
+        std::chrono::duration<double, std::milli>(end - start).count());
+  }
+  std::sort(times.begin(), times.end());
+  outs() << shape.blocks << "," << shape.depth << ","
+         << format("%g", shape.irreducible) << "," << shape.domain << ","
+         << Seed << ",liveness,sparse,none," << sparse->getNumValues() << ","
+         << F.getInstructionCount() << "," << sparse->getNumVisits() << ",0,"
+         << format("%.3f", times.front()) << ","
+         << format("%.3f", times[times.size() / 2]) << "\n";
+  if (!Verify) {
+    return true;
+  }
+  auto dense = Liveness().solve(F);
+  bool same = dense->getDomainSize() == sparse->getNumValues();
+  for (unsigned idx = 0; same && idx < sparse->getNumValues(); ++idx) {
+    same = dense->getDomainElement(idx).getValue() == sparse->getValue(idx);
+  }
+  for (auto iter = F.begin(); same && iter != F.end(); ++iter) {
+    // Liveness 是后向分析：输入为 live-out，输出为 live-in
+    same = dense->getOutputBV(*iter) == sparse->getLiveInBV(*iter) &&
+           dense->getInputBV(*iter) == sparse->getLiveOutBV(*iter);
+  }
+  if (!same) {
+    errs() << "dfa-bench: SparseLiveness disagrees with Liveness on blocks="
+           << shape.blocks << " depth=" << shape.depth
+           << " irreducible=" << shape.irreducible
+           << " domain=" << shape.domain << "\n";
+  }
+  return same;
+}
+
+template <typename T>
+std::vector<T> valuesOr(const cl::list<T> &list, std::vector<T> defaults) {
+  return list.empty() ? defaults : std::vector<T>(list.begin(), list.end());
+}
+
+const char *getSolverName(dfa::SolverKind kind) {
+  switch (kind) {
+  case dfa::SolverKind::RoundRobin:
+    return "round-robin";
+  case dfa::SolverKind::Worklist:
+    return "worklist";
+  case dfa::SolverKind::SCC:
+    return "scc";
+  }
+  return "";
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+  cl::ParseCommandLineOptions(argc, argv,
+                              "dfa::Framework solver benchmark on synthetic "
+                              "CFGs\n");
+
+  std::vector<dfa::SolverKind> solvers =
+      valuesOr(Solvers, {dfa::SolverKind::Worklist, dfa::SolverKind::SCC});
+  outs() << "blocks,depth,irreducible,domain,seed,analysis,solver,set,"
+            "domain_size,insts,visits,sweeps,min_ms,median_ms\n";
+  for (unsigned blocks : valuesOr(Blocks, {256, 4096})) {
+    for (unsigned depth : valuesOr(Depths, {1, 4})) {
+      for (double irreducible : valuesOr(Irreducible, {0.0, 0.25})) {
+        for (unsigned domain : valuesOr(Domains, {512, 8192})) {
+          Shape shape{blocks, depth, domain, irreducible};
+          // 每个函数使用独立的 LLVMContext 与随机数序列，
+          // 输出与参数列表的组合方式无关
+          LLVMContext ctx;
+          Module M("bench", ctx);
+          std::mt19937 rng(Seed ^ (blocks * 7919u) ^ (depth * 104729u) ^
+                           (domain * 15485863u) ^
+                           unsigned(irreducible * 1000));
+          Function *F = buildFunction(M, shape, rng);
+          if (Verify && verifyFunction(*F, &errs())) {
+            return 1;
+          }
+          for (dfa::SolverKind kind : solvers) {
+            benchAnalysis<Liveness>("liveness", shape, *F, kind,
+                                    getSolverName(kind));
+            benchAnalysis<AvailExpr>("avail-expr", shape, *F, kind,
+                                     getSolverName(kind));
+          }
+          if (!benchSparseLiveness(shape, *F)) {
+            return 1;
+          }
+        }
+      }
+    }
+  }
+  return 0;
+}